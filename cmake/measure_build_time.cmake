@@ -0,0 +1,45 @@
+# Measures clean and incremental build times of the VulkanLearn library and entry target.
+#
+# Usage: cmake [-DBUILD_DIR=<dir>] [-DCONFIGURE_ARGS="-DVULKANLEARN_USE_PCH=ON;..."] -P
+# cmake/measure_build_time.cmake
+#
+# The build directory is wiped and configured from scratch, then built three times: once clean,
+# once after touching a source file and once after touching a header included by most sources.
+
+get_filename_component(SOURCE_DIR "${CMAKE_CURRENT_LIST_DIR}/.." ABSOLUTE)
+
+if(NOT BUILD_DIR)
+  set(BUILD_DIR "${SOURCE_DIR}/build_time")
+endif()
+
+cmake_host_system_information(RESULT JOBS QUERY NUMBER_OF_LOGICAL_CORES)
+
+function(run_step name)
+  string(TIMESTAMP start "%s" UTC)
+  execute_process(COMMAND ${ARGN} RESULT_VARIABLE result OUTPUT_QUIET)
+  string(TIMESTAMP end "%s" UTC)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${name} failed")
+  endif()
+  math(EXPR elapsed "${end} - ${start}")
+  message(STATUS "${name}: ${elapsed} s")
+endfunction()
+
+file(REMOVE_RECURSE "${BUILD_DIR}")
+execute_process(
+  COMMAND ${CMAKE_COMMAND} -S "${SOURCE_DIR}" -B "${BUILD_DIR}" ${CONFIGURE_ARGS}
+  RESULT_VARIABLE result OUTPUT_QUIET
+)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "configure failed")
+endif()
+
+set(build_command ${CMAKE_COMMAND} --build "${BUILD_DIR}" --parallel ${JOBS})
+
+run_step("clean build" ${build_command})
+
+file(TOUCH "${SOURCE_DIR}/source/SceneResources.cpp")
+run_step("incremental build after touching a source" ${build_command})
+
+file(TOUCH "${SOURCE_DIR}/include/VulkanDevice.h")
+run_step("incremental build after touching a header" ${build_command})
@@ -0,0 +1,36 @@
+# Measures cold and warm startup of the VulkanLearn entry target.
+#
+# Usage: cmake -DENTRY=<path to VulkanLearn_entry> [-DRUNS=<count>] -P
+# cmake/measure_startup_time.cmake
+#
+# Each cold run evicts the asset pack from the page cache first, so its pages are read from disk;
+# the warm runs that follow find them cached. The app reports its own startup time, split into
+# the whole startup and the part spent mapping and uploading the asset pack.
+
+get_filename_component(SOURCE_DIR "${CMAKE_CURRENT_LIST_DIR}/.." ABSOLUTE)
+
+if(NOT ENTRY)
+  message(FATAL_ERROR "set ENTRY to the VulkanLearn_entry executable")
+endif()
+if(NOT RUNS)
+  set(RUNS 3)
+endif()
+
+function(run_startup)
+  execute_process(
+    COMMAND "${ENTRY}" --startup-only ${ARGN}
+    WORKING_DIRECTORY "${SOURCE_DIR}"
+    RESULT_VARIABLE result
+    OUTPUT_VARIABLE output
+  )
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "startup failed")
+  endif()
+  string(REGEX MATCH "[a-z]+ startup: [^\n]*" timing "${output}")
+  message(STATUS "${timing}")
+endfunction()
+
+foreach(run RANGE 1 ${RUNS})
+  run_startup(--cold-start)
+  run_startup()
+endforeach()
@@ -1,11 +1,14 @@
 ####################################################################################################
-# This function converts any file into C/C++ source code.
+# This function converts a SPIR-V binary into C/C++ source code.
 # Example:
-# - input file: data.dat
+# - input file: data.spv
 # - output file: data.h
 # - variable name declared in output file: DATA
 # - data length: sizeof(DATA)
-# embed_resource("data.dat" "data.h" "DATA")
+# embed_resource("data.spv" "data.h" "DATA")
+# The words are emitted as an inline constexpr uint32_t array: it is correctly aligned for
+# VkShaderModuleCreateInfo::pCode, needs no dynamic initialization and has a single definition in
+# the program no matter how many translation units include the header.
 ####################################################################################################
 
 function(embed_resource resource_file_name source_file_name variable_name)
@@ -19,17 +22,26 @@ function(embed_resource resource_file_name source_file_name variable_name)
     if(EXISTS "${resource_file_name}")
         file(READ "${resource_file_name}" hex_content HEX)
 
-        string(REPEAT "[0-9a-f]" 32 pattern)
+        string(LENGTH "${hex_content}" hex_length)
+        math(EXPR remainder "${hex_length} % 8")
+        if(NOT remainder EQUAL 0)
+            message("ERROR: ${resource_file_name} is not a whole number of 32-bit words")
+            return()
+        endif()
+
+        string(REPEAT "[0-9a-f]" 64 pattern)
         string(REGEX REPLACE "(${pattern})" "\\1\n" content "${hex_content}")
 
-        string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1, " content "${content}")
+        # SPIR-V is stored little-endian, so each word's bytes are reversed.
+        set(byte "([0-9a-f][0-9a-f])")
+        string(REGEX REPLACE "${byte}${byte}${byte}${byte}" "0x\\4\\3\\2\\1, " content "${content}")
 
         string(REGEX REPLACE ", $" "" content "${content}")
 
-        set(array_definition "static const std::vector<unsigned char> ${variable_name} =\n{\n${content}\n};")
-        
+        set(array_definition "inline constexpr uint32_t ${variable_name}[] =\n{\n${content}\n};")
+
         get_filename_component(file_name ${source_file_name} NAME)
-        set(source "/**\n * @file ${file_name}\n * @brief Auto generated file.\n */\n#include <vector>\n${array_definition}\n")
+        set(source "/**\n * @file ${file_name}\n * @brief Auto generated file.\n */\n#pragma once\n#include <cstdint>\n${array_definition}\n")
 
         file(WRITE "${source_file_name}" "${source}")
     else()
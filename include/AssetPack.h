@@ -0,0 +1,162 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Pack files hold GPU ready payloads behind a table of contents:
+//
+//   AssetPackHeader | payloads, each aligned to ASSET_PACK_ALIGNMENT | AssetPackEntry[entryCount]
+//
+// Payloads are stored exactly as they are uploaded, so loading is a copy from the mapped file
+// into staging (or mappable device) memory.
+const uint32_t ASSET_PACK_MAGIC = 0x4b504c56; // "VLPK"
+const uint32_t ASSET_PACK_VERSION = 4;
+// Covers optimalBufferCopyOffsetAlignment and every vertex format alignment.
+const uint64_t ASSET_PACK_ALIGNMENT = 256;
+const size_t ASSET_NAME_SIZE = 32;
+const uint32_t MAX_MESH_LODS = 4;
+
+enum class AssetType : uint32_t {
+    Mesh = 1,
+    Texture = 2,
+    VirtualTexture = 3,
+};
+
+struct AssetPackHeader {
+    uint32_t magic = ASSET_PACK_MAGIC;
+    uint32_t version = ASSET_PACK_VERSION;
+    uint32_t entryCount = 0;
+    uint32_t reserved = 0;
+    uint64_t tocOffset = 0;
+};
+
+struct AssetPackEntry {
+    // Null terminated.
+    char name[ASSET_NAME_SIZE] = {};
+    AssetType type = AssetType::Mesh;
+
+    // Textures: one tightly packed mip level of a 4 byte per texel format.
+    uint32_t format = VK_FORMAT_UNDEFINED;
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    // Virtual textures: every mip level, down to the first that fits a single tile, cut into
+    // tiles of tileSize texels with a tileBorder wide border copied from the neighbouring texels
+    // (wrapping around the edges) on each side. Sizes are powers of two, so a tile covers exactly
+    // the tiles below it in the next finer level. Tiles are stored level by level, each level row
+    // by row, getVirtualTileStride() apart.
+    uint32_t tileSize = 0;
+    uint32_t tileBorder = 0;
+    uint32_t levelCount = 0;
+    uint32_t tileCount = 0;
+
+    // Meshes: vertices at the start of the payload, their positions as three floats each at
+    // positionOffset for depth-only passes, and 16-bit indices at indexOffset. The indices are
+    // lodCount levels of detail over the same vertices, finest first and back to back.
+    uint32_t vertexStride = 0;
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+    uint32_t lodCount = 0;
+    uint32_t lodIndexCounts[MAX_MESH_LODS] = {};
+    // Center and radius in mesh space.
+    float boundingSphere[4] = {};
+    uint64_t positionOffset = 0;
+    uint64_t indexOffset = 0;
+
+    // Payload position in the file.
+    uint64_t offset = 0;
+    uint64_t size = 0;
+};
+
+static_assert(sizeof(AssetPackHeader) == 24, "asset pack header layout changed");
+static_assert(sizeof(AssetPackEntry) == 144, "asset pack entry layout changed");
+
+// Tiles along one axis of a virtual texture level, for an axis of size texels at level 0.
+uint32_t getVirtualPageCount(uint32_t size, uint32_t tileSize, uint32_t level);
+// Bytes from one stored virtual texture tile to the next.
+uint64_t getVirtualTileStride(const AssetPackEntry& entry);
+
+// Read only view of a pack mapped into memory. Nothing is read up front except the header and
+// the table of contents; payload pages are faulted in when they are first copied. Pointers into
+// the pack stay valid until close().
+class AssetPack {
+  public:
+    AssetPack() = default;
+    AssetPack(const AssetPack&) = delete;
+    AssetPack& operator=(const AssetPack&) = delete;
+    ~AssetPack() { close(); }
+
+    // Throws when the file is missing or its table of contents does not fit the file.
+    void open(const std::string& path);
+    void close();
+
+    // Drops the file's pages from the OS page cache, so the next open() has to read it from
+    // disk. Used to measure cold startup; does nothing where the OS offers no way to do it.
+    static void evictFromPageCache(const std::string& path);
+    // Tells the OS the entry's payload is read in small pieces in no particular order, as
+    // virtual texture tiles are, instead of front to back.
+    void adviseRandomAccess(const AssetPackEntry& entry) const;
+
+    uint32_t getEntryCount() const { return entryCount; }
+    const AssetPackEntry& getEntry(uint32_t index) const { return entries[index]; }
+    // Null when there is no entry with this name and type.
+    const AssetPackEntry* find(const char* name, AssetType type) const;
+
+    const void* getPayload(const AssetPackEntry& entry) const {
+        return static_cast<const char*>(mapping) + entry.offset;
+    }
+    const float* getPositions(const AssetPackEntry& entry) const {
+        return reinterpret_cast<const float*>(static_cast<const char*>(getPayload(entry))
+                                              + entry.positionOffset);
+    }
+    const uint16_t* getIndices(const AssetPackEntry& entry) const {
+        return reinterpret_cast<const uint16_t*>(static_cast<const char*>(getPayload(entry))
+                                                 + entry.indexOffset);
+    }
+
+  private:
+    void validate() const;
+
+    void* mapping = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* file = nullptr;
+    void* fileMapping = nullptr;
+#endif
+
+    const AssetPackEntry* entries = nullptr;
+    uint32_t entryCount = 0;
+};
+
+// Builds a pack in memory and writes it out; used by the pack builder tool.
+class AssetPackWriter {
+  public:
+    // positions holds three floats per vertex; indices holds lodCount index lists, finest
+    // first, each lodIndexCounts[i] long.
+    void addMesh(const std::string& name, const void* vertices, uint32_t vertexStride,
+                 uint32_t vertexCount, const float* positions, const uint16_t* indices,
+                 const uint32_t* lodIndexCounts, uint32_t lodCount,
+                 const float boundingSphere[4]);
+    // pixels holds width * height texels of 4 bytes each.
+    void addTexture(const std::string& name, VkFormat format, uint32_t width, uint32_t height,
+                    const void* pixels);
+    // levels holds the mip chain of a 4 byte per texel format, each level half the size of the
+    // one before (rounded down, at least 1) and levelCount of them; see AssetPackEntry.
+    void addVirtualTexture(const std::string& name, VkFormat format, uint32_t width,
+                           uint32_t height, uint32_t tileSize, uint32_t tileBorder,
+                           const std::vector<const uint32_t*>& levels);
+
+    void write(const std::string& path) const;
+
+  private:
+    AssetPackEntry& addEntry(const std::string& name, AssetType type);
+    uint64_t appendPayload(const void* data, size_t dataSize);
+
+    std::vector<AssetPackEntry> entries;
+    // Everything between the header and the table of contents.
+    std::vector<unsigned char> payloads;
+};
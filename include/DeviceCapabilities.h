@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// findMemoryType result when no memory type qualifies.
+const uint32_t NO_MEMORY_TYPE = UINT32_MAX;
+
+// VK_KHR_dynamic_rendering and the extensions it depends on before Vulkan 1.2, in the order they
+// are enabled.
+std::vector<const char*> getDynamicRenderingExtensions();
+
+// Snapshot of what a physical device supports, queried once when devices are ranked, so memory
+// type and format lookups on allocation paths are table lookups instead of driver calls. Only
+// state that cannot change while the device exists is captured; memory budgets and surface
+// capabilities are still queried when they are needed.
+class DeviceCapabilities {
+  public:
+    void query(VkPhysicalDevice physicalDevice);
+
+    VkPhysicalDevice getPhysicalDevice() const { return physicalDevice; }
+    const VkPhysicalDeviceProperties& getProperties() const { return properties; }
+    const VkPhysicalDeviceLimits& getLimits() const { return properties.limits; }
+    const VkPhysicalDeviceFeatures& getFeatures() const { return features; }
+    // Zero when the device or driver predates Vulkan 1.1.
+    const std::array<uint8_t, VK_UUID_SIZE>& getUuid() const { return uuid; }
+    bool supportsMultiview() const { return multiview; }
+    // VK_KHR_dynamic_rendering and the extensions it depends on, with the feature enabled.
+    bool supportsDynamicRendering() const { return dynamicRendering; }
+    const VkPhysicalDeviceMemoryProperties& getMemoryProperties() const {
+        return memoryProperties;
+    }
+    const std::vector<VkQueueFamilyProperties>& getQueueFamilies() const { return queueFamilies; }
+
+    bool hasExtension(const std::string& name) const;
+    bool hasExtensions(const std::vector<const char*>& names) const;
+
+    // First memory type in typeFilter with every flag of properties, or NO_MEMORY_TYPE.
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+    // Features of a core format; other formats are queried from the driver.
+    VkFormatProperties getFormatProperties(VkFormat format) const;
+
+    // Everything captured, as one JSON object, for bug reports.
+    std::string toJson() const;
+    void writeJson(const std::string& path) const;
+
+  private:
+    uint32_t getMemoryTypeMask(VkMemoryPropertyFlags properties) const;
+
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties properties{};
+    VkPhysicalDeviceFeatures features{};
+    std::array<uint8_t, VK_UUID_SIZE> uuid{};
+    bool multiview = false;
+    bool dynamicRendering = false;
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+    std::vector<VkQueueFamilyProperties> queueFamilies;
+    std::vector<VkExtensionProperties> extensions;
+    std::unordered_set<std::string> extensionNames;
+
+    // Bit i of entry flags is set when memory type i has every flag in flags, for the flag
+    // combinations the table covers.
+    std::vector<uint32_t> memoryTypeMasks;
+    // Indexed by VkFormat.
+    std::vector<VkFormatProperties> formatProperties;
+};
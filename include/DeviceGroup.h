@@ -0,0 +1,59 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "VulkanDevice.h"
+
+class VulkanInstance;
+
+// Every suitable GPU opened headless, each served by its own worker thread. Jobs go into one
+// shared queue and are taken by whichever device is free, so faster GPUs end up running more of
+// them. A job only touches the device it is given, which keeps queue access single threaded.
+class DeviceGroup {
+  public:
+    using Job = std::function<void(const VulkanDevice& device, uint32_t deviceIndex)>;
+
+    DeviceGroup() = default;
+    ~DeviceGroup();
+
+    DeviceGroup(const DeviceGroup&) = delete;
+    DeviceGroup& operator=(const DeviceGroup&) = delete;
+
+    // Opens the suitable devices in ranking order and starts their workers.
+    void create(const VulkanInstance& instance);
+    // Waits for queued jobs, stops the workers and destroys the devices.
+    void destroy();
+
+    void submit(Job job);
+    // Blocks until every submitted job has run. Rethrows the first exception a job threw.
+    void wait();
+
+    uint32_t getDeviceCount() const { return static_cast<uint32_t>(devices.size()); }
+    // Per-device state such as scenes is created through this before jobs are submitted.
+    const VulkanDevice& getDevice(uint32_t deviceIndex) const { return *devices[deviceIndex]; }
+    // Jobs each device has completed since create.
+    std::vector<uint32_t> getCompletedJobs() const;
+
+  private:
+    void work(uint32_t deviceIndex);
+
+    std::vector<std::unique_ptr<VulkanDevice>> devices;
+    std::vector<std::thread> workers;
+
+    mutable std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable jobsFinished;
+    std::deque<Job> jobs;
+    uint32_t runningJobs = 0;
+    bool stopping = false;
+    std::exception_ptr firstError;
+    std::vector<uint32_t> completedJobs;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "DeviceCapabilities.h"
+
+class VulkanInstance;
+
+struct QueueFamilyIndices {
+    std::optional<uint32_t> graphicsFamily;
+    std::optional<uint32_t> presentFamily;
+    // Families for async compute and copies, only set when they are separate from graphics.
+    std::optional<uint32_t> computeFamily;
+    std::optional<uint32_t> transferFamily;
+
+    bool isComplete() const { return graphicsFamily.has_value() && presentFamily.has_value(); }
+};
+
+// With a null surface no present family is looked up.
+QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface);
+// Device extensions the renderer enables; the swapchain is only needed when presenting.
+std::vector<const char*> getRequiredDeviceExtensions(bool presentation);
+
+struct PhysicalDeviceCandidate {
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    // Position in vkEnumeratePhysicalDevices order, usable as an override.
+    uint32_t index = 0;
+    // Queried once while ranking and shared with the VulkanDevice created on this device.
+    std::shared_ptr<const DeviceCapabilities> capabilities;
+    VkPhysicalDeviceProperties properties{};
+    // Zero when the device or driver predates Vulkan 1.1.
+    std::array<uint8_t, VK_UUID_SIZE> uuid{};
+    // Size of the largest device local heap.
+    VkDeviceSize localMemory = 0;
+    bool dedicatedCompute = false;
+    bool dedicatedTransfer = false;
+    // Whether the queues, extensions and features the renderer needs are all present.
+    bool suitable = false;
+    uint64_t score = 0;
+};
+
+// Every physical device, suitable ones first and best first. With a null surface suitability is
+// judged for headless rendering. Devices rank by type (discrete, integrated, virtual, CPU), then
+// by the size of their device local heap, then by dedicated compute and transfer queues.
+std::vector<PhysicalDeviceCandidate> rankPhysicalDevices(const VulkanInstance& instance,
+                                                         VkSurfaceKHR surface);
+
+// Picks the best suitable device and logs the ranking. selection overrides the choice with an
+// enumeration index or a device UUID in hex, with or without dashes; when it is empty the
+// VULKANLEARN_GPU environment variable is used instead. A selection that matches no suitable
+// device is an error rather than a silent fallback.
+PhysicalDeviceCandidate selectPhysicalDevice(const VulkanInstance& instance, VkSurfaceKHR surface,
+                                             const std::string& selection = {});
+
+void printDeviceRanking(const std::vector<PhysicalDeviceCandidate>& candidates);
+std::string formatDeviceUuid(const std::array<uint8_t, VK_UUID_SIZE>& uuid);
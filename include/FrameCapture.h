@@ -0,0 +1,137 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "RenderTarget.h"
+
+// Capture files hold what the app fed the renderer, frame by frame, so a session can be replayed
+// headlessly on another machine:
+//
+//   FrameCaptureHeader | records, each a FrameCaptureRecord followed by size bytes of payload
+//
+// The session record comes first. The scene's resources are recreated on replay from the same
+// asset pack, identified by its size and a hash of its table of contents, and its uploads are
+// driven by the texture feedback each frame recorded.
+const uint32_t FRAME_CAPTURE_MAGIC = 0x50434c56; // "VLCP"
+const uint32_t FRAME_CAPTURE_VERSION = 1;
+
+enum class CaptureRecordType : uint32_t {
+    // CaptureSession.
+    Session = 1,
+    // CaptureOptions now used by the captured view.
+    Options = 2,
+    // VkExtent2D the captured view was resized to.
+    Resize = 3,
+    // CaptureFrame followed by its feedbackCount texture feedback tiles.
+    Frame = 4,
+};
+
+struct FrameCaptureHeader {
+    uint32_t magic = FRAME_CAPTURE_MAGIC;
+    uint32_t version = FRAME_CAPTURE_VERSION;
+};
+
+struct FrameCaptureRecord {
+    CaptureRecordType type = CaptureRecordType::Frame;
+    uint32_t size = 0;
+};
+
+struct CaptureOptions {
+    uint32_t msaaSamples = 1;
+    uint32_t presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+    // 0 in captures made before it was recorded, which rendered with render pass objects.
+    uint32_t dynamicRendering = 0;
+};
+
+struct CaptureSession {
+    // Of the device the capture was made on, for the replay's report.
+    char deviceName[VK_MAX_PHYSICAL_DEVICE_NAME_SIZE] = {};
+    uint32_t vendorId = 0;
+    uint32_t deviceId = 0;
+    uint32_t driverVersion = 0;
+    uint32_t apiVersion = 0;
+
+    uint64_t assetPackSize = 0;
+    uint64_t assetPackHash = 0;
+    uint64_t textureBudget = 0;
+
+    VkExtent2D extent{};
+    CaptureOptions options;
+};
+
+struct CaptureFrame {
+    // Local transform of the scene graph's root, column major.
+    float rootTransform[16] = {};
+    // Main loop CPU time, and GPU time of the latest frame that had finished, in milliseconds
+    // as measured while capturing; the GPU time is 0 when the device has no timestamps.
+    float cpuTime = 0.0f;
+    float gpuTime = 0.0f;
+    uint32_t feedbackCount = 0;
+    uint32_t reserved = 0;
+};
+
+static_assert(sizeof(FrameCaptureHeader) == 8, "frame capture header layout changed");
+static_assert(sizeof(CaptureSession) == 320, "capture session layout changed");
+static_assert(sizeof(CaptureFrame) == 80, "capture frame layout changed");
+
+// Size and FNV-1a hash of an asset pack's header and table of contents, which change whenever
+// any payload does. Throws when the pack cannot be read.
+void hashAssetPack(const std::string& path, uint64_t& size, uint64_t& hash);
+
+CaptureOptions toCaptureOptions(const RenderTargetOptions& options);
+RenderTargetOptions fromCaptureOptions(const CaptureOptions& options);
+
+// Appends records to a capture file through a buffered stream, so capturing costs a copy of each
+// frame's few dozen bytes and its texture feedback.
+class FrameCaptureWriter {
+  public:
+    // Throws when path cannot be created.
+    void open(const std::string& path, const CaptureSession& session);
+    // Throws when a record could not be written.
+    void close();
+    bool isOpen() const { return file.is_open(); }
+
+    void writeOptions(const RenderTargetOptions& options);
+    void writeResize(VkExtent2D extent);
+    // The frame's feedbackCount is taken from feedback.
+    void writeFrame(const CaptureFrame& frame, const std::vector<uint32_t>& feedback);
+
+  private:
+    void writeRecordHeader(CaptureRecordType type, size_t size);
+
+    std::string path;
+    std::ofstream file;
+};
+
+// One record of a loaded capture; only the fields of its type are set.
+struct CaptureEvent {
+    CaptureRecordType type = CaptureRecordType::Frame;
+    CaptureOptions options;
+    VkExtent2D extent{};
+    CaptureFrame frame;
+    std::vector<uint32_t> feedback;
+};
+
+// A capture file read into memory.
+class FrameCapture {
+  public:
+    // Throws when the file is missing, truncated, of another version or does not start with a
+    // session.
+    void load(const std::string& path);
+
+    const CaptureSession& getSession() const { return session; }
+    // Every record after the session, in capture order.
+    const std::vector<CaptureEvent>& getEvents() const { return events; }
+    uint32_t getFrameCount() const { return frameCount; }
+
+  private:
+    CaptureSession session;
+    std::vector<CaptureEvent> events;
+    uint32_t frameCount = 0;
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class VulkanDevice;
+class Swapchain;
+
+const uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+// Upper bound for setFramesInFlight(); more frames add latency without adding throughput.
+const uint32_t MAX_FRAMES_IN_FLIGHT = 3;
+
+enum class FrameStatus {
+    Presented,
+    // The frame slot or the next swapchain image did not become available within the timeout.
+    NotReady,
+    // The swapchain no longer matches the surface and must be recreated.
+    OutOfDate,
+};
+
+// Per swapchain image command buffers and the per frame synchronisation used to keep up to
+// framesInFlight frames queued on the GPU.
+class FrameManager {
+  public:
+    void create(const VulkanDevice& vulkanDevice,
+                uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT);
+    void destroy();
+
+    // Waits for every submitted frame and recreates the synchronisation for framesInFlight
+    // frames, clamped to [1, MAX_FRAMES_IN_FLIGHT].
+    void setFramesInFlight(uint32_t framesInFlight);
+    uint32_t getFramesInFlight() const { return static_cast<uint32_t>(inFlightFences.size()); }
+
+    // Records one command buffer per swapchain image; record is called between the GPU
+    // timestamps of each.
+    void recordCommandBuffers(const Swapchain& swapchain,
+                              const std::function<void(VkCommandBuffer, uint32_t)>& record);
+    void freeCommandBuffers();
+
+    // Acquires, submits and presents one frame. beforeSubmit runs once the acquired image is
+    // known and no longer in use; command buffers it appends are submitted after the image's
+    // recorded one, in the same batch. timeout bounds the waits for a free frame slot, for the
+    // next image and for that image's previous frame; with a timeout of 0 the call never blocks.
+    // An image acquired before the last wait timed out is kept for the next call.
+    FrameStatus drawFrame(
+        const Swapchain& swapchain, uint64_t timeout,
+        const std::function<void(uint32_t, std::vector<VkCommandBuffer>&)>& beforeSubmit);
+
+    // Gives up the image kept by a drawFrame that returned NotReady. Call before destroying the
+    // swapchain it was acquired from.
+    void releaseAcquiredImage();
+    // Waits for the frames submitted by this manager only, leaving other users of the device
+    // running.
+    void waitIdle() const;
+
+    // Blocks until the most recently submitted frame finishes and returns its GPU time.
+    bool getLastFrameGpuTime(double& milliseconds) const;
+    // GPU time of the last frame rendered to imageIndex, without blocking; false while that
+    // frame has not finished. From beforeSubmit the image's last frame is known to be done.
+    bool getImageGpuTime(uint32_t imageIndex, double& milliseconds) const;
+    // Swapchain image index of the most recently submitted frame, UINT32_MAX before the first.
+    uint32_t getSubmittedImage() const { return submittedImage; }
+
+  private:
+    void createSyncObjects(uint32_t framesInFlight);
+    void destroySyncObjects();
+    bool readGpuTime(uint32_t imageIndex, VkQueryResultFlags flags, double& milliseconds) const;
+    void waitForAcquiredImage();
+
+    const VulkanDevice* vulkanDevice = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+
+    std::vector<VkCommandBuffer> commandBuffers;
+    VkQueryPool timestampQueryPool = VK_NULL_HANDLE;
+    uint32_t submittedImage = UINT32_MAX;
+
+    std::vector<VkSemaphore> imageAvailableSemaphores;
+    std::vector<VkSemaphore> renderFinishedSemaphores;
+    std::vector<VkFence> inFlightFences;
+    std::vector<VkFence> imagesInFlight;
+    // Whether an image was submitted since its command buffer was recorded, so its timestamps
+    // have been written.
+    std::vector<uint8_t> imagesSubmitted;
+    size_t currentFrame = 0;
+    // Image acquired into currentFrame by a drawFrame that then timed out, or UINT32_MAX. Once
+    // waited, its acquire semaphore has already been consumed.
+    uint32_t acquiredImage = UINT32_MAX;
+    bool acquiredImageWaited = false;
+    std::vector<VkCommandBuffer> submitCommandBuffers;
+};
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "QueueScheduler.h"
+
+class VulkanDevice;
+
+using GeometryHandle = uint32_t;
+const GeometryHandle NO_GEOMETRY = UINT32_MAX;
+
+// Where a mesh lives in the arena, counted in vertices and indices. Indices are relative to
+// vertexOffset, so moving a mesh only changes the offsets and never its index data.
+struct GeometryRange {
+    int32_t vertexOffset = 0;
+    uint32_t vertexCount = 0;
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+};
+
+// First fit allocator over [0, capacity). Free ranges are kept sorted by offset and merged with
+// their neighbours when freed.
+class RangeAllocator {
+  public:
+    void reset(uint32_t capacity);
+    bool allocate(uint32_t size, uint32_t& offset);
+    void free(uint32_t offset, uint32_t size);
+
+    uint32_t getFreeSize() const { return freeSize; }
+    uint32_t getLargestFreeRange() const;
+
+  private:
+    // Offset to size.
+    std::map<uint32_t, uint32_t> freeRanges;
+    uint32_t freeSize = 0;
+};
+
+// One device-local vertex buffer and one 16-bit index buffer shared by every mesh, so a whole
+// scene binds once and its draws can be issued together with indirect draws. Meshes are
+// sub-allocated from free lists and addressed by firstIndex and vertexOffset. An optional
+// position buffer holds a second, position-only copy of every vertex at the same vertex offsets
+// for depth-only passes.
+//
+// When freed space becomes fragmented, update() starts a compaction that copies the live meshes
+// to the front of new buffers on the graphics queue without waiting for it. A later update()
+// swaps the new buffers in once the copies have finished.
+class GeometryArena {
+  public:
+    // vertexStride is the size of one vertex in bytes, positionStride the size of one position or
+    // 0 to go without the position buffer.
+    void create(const VulkanDevice& vulkanDevice, VkDeviceSize vertexStride,
+                VkDeviceSize positionStride, uint32_t vertexCapacity, uint32_t indexCapacity);
+    void destroy();
+
+    // Throws when no free range is large enough. Waits for a running compaction first.
+    GeometryHandle allocate(uint32_t vertexCount, uint32_t indexCount);
+    void free(GeometryHandle mesh);
+    const GeometryRange& getRange(GeometryHandle mesh) const { return ranges.at(mesh); }
+
+    VkBuffer getVertexBuffer() const { return vertices.buffer; }
+    VkBuffer getPositionBuffer() const { return positions.buffer; }
+    VkBuffer getIndexBuffer() const { return indices.buffer; }
+    VkIndexType getIndexType() const { return VK_INDEX_TYPE_UINT16; }
+    // Host pointers to the buffers when they live in mappable device memory (ReBAR or UMA), so
+    // uploads can write them directly. Null otherwise.
+    void* getVertexMapping() const { return vertices.mapping; }
+    void* getPositionMapping() const { return positions.mapping; }
+    void* getIndexMapping() const { return indices.mapping; }
+    // Byte offsets of a mesh's data, for uploads. Mesh data must be written before the next
+    // update(), since a compaction only carries over what was already in the old buffers.
+    VkDeviceSize getVertexDataOffset(GeometryHandle mesh) const;
+    VkDeviceSize getPositionDataOffset(GeometryHandle mesh) const;
+    VkDeviceSize getIndexDataOffset(GeometryHandle mesh) const;
+
+    // Starts or finishes a background compaction. Returns true when meshes moved to new buffers;
+    // commands recorded with the old buffers or ranges must then be re-recorded before
+    // releaseRetiredBuffers() frees the old buffers.
+    bool update();
+    void releaseRetiredBuffers();
+
+  private:
+    struct Buffer {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void* mapping = nullptr;
+    };
+
+    bool isFragmented() const;
+    void beginCompaction();
+    void finishCompaction(bool wait);
+    void createBuffers(Buffer& vertexData, Buffer& positionData, Buffer& indexData) const;
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, Buffer& buffer) const;
+    void retireBuffer(Buffer& buffer);
+
+    const VulkanDevice* vulkanDevice = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+    VkDeviceSize vertexStride = 0;
+    VkDeviceSize positionStride = 0;
+    uint32_t vertexCapacity = 0;
+    uint32_t indexCapacity = 0;
+    bool mappable = false;
+
+    Buffer vertices;
+    Buffer positions;
+    Buffer indices;
+
+    RangeAllocator vertexAllocator;
+    RangeAllocator indexAllocator;
+    // Indexed by GeometryHandle.
+    std::vector<GeometryRange> ranges;
+    std::vector<uint8_t> live;
+    std::vector<GeometryHandle> freeHandles;
+
+    // The compaction in flight, swapped in by finishCompaction().
+    struct Compaction {
+        bool running = false;
+        Buffer vertices;
+        Buffer positions;
+        Buffer indices;
+        RangeAllocator vertexAllocator;
+        RangeAllocator indexAllocator;
+        std::vector<GeometryRange> ranges;
+    };
+    Compaction compaction;
+    QueueScheduler scheduler;
+    bool moved = false;
+
+    std::vector<VkBuffer> retiredBuffers;
+    std::vector<VkDeviceMemory> retiredBuffersMemory;
+};
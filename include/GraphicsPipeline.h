@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "ShaderRegistry.h"
+
+class VulkanDevice;
+
+struct GraphicsPipelineInfo {
+    ShaderCode vertexShader;
+    // Unused by depth-only pipelines.
+    ShaderCode fragmentShader;
+    // Depth-only variant for shadow maps: no fragment shader or colour attachments, the position
+    // stream instead of the full Vertex, no culling, and depth bias against shadow acne.
+    bool depthOnly = false;
+    // A null render pass creates the pipeline for dynamic rendering into the attachment formats
+    // of rendering instead.
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    VkPipelineRenderingCreateInfoKHR rendering{};
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+};
+
+VkShaderModule createShaderModule(VkDevice device, ShaderCode code);
+
+// Depth tested, back face culled pipeline for the scene's Vertex layout, or its depth-only
+// variant. Built through the device's shared pipeline cache, so render targets with matching
+// state compile it once. The viewport and scissor are dynamic state, set to the attachments'
+// extent by the render graph, so the pipeline does not depend on the target's size.
+class GraphicsPipeline {
+  public:
+    void create(const VulkanDevice& vulkanDevice, const GraphicsPipelineInfo& info);
+    void destroy();
+
+    VkPipeline getHandle() const { return pipeline; }
+    VkPipelineLayout getLayout() const { return layout; }
+
+  private:
+    VkDevice device = VK_NULL_HANDLE;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "AssetPack.h"
+
+class VulkanDevice;
+
+// One indirect command's level of detail inputs, laid out as the lod_select shader reads them.
+struct LodDraw {
+    uint32_t firstInstance = 0;
+    uint32_t instanceCount = 0;
+    // Zero leaves the command as it was recorded.
+    uint32_t lodCount = 0;
+    uint32_t reserved = 0;
+    // Index range of each level in the geometry arena.
+    uint32_t firstIndex[MAX_MESH_LODS] = {};
+    uint32_t indexCount[MAX_MESH_LODS] = {};
+    // Center and radius in mesh space.
+    float boundingSphere[4] = {};
+};
+
+static_assert(sizeof(LodDraw) == 64, "LodDraw must match the lod_select shader's layout");
+
+// What one indirect command drew last frame and the level it picked, which the hysteresis
+// starts from when the command draws the same thing again.
+struct LodState {
+    uint32_t firstIndex = 0;
+    uint32_t firstInstance = 0;
+    uint32_t instanceCount = 0;
+    uint32_t lod = 0;
+};
+
+static_assert(sizeof(LodState) == 16, "LodState must match the lod_select shader's layout");
+
+// Picks the level of detail of every indirect draw on the GPU, from the projected size of its
+// instances' bounding spheres, and patches the draw's index range in place. Selection costs no
+// CPU time and the recorded command buffers stay valid whichever levels are chosen. The
+// selection state is one buffer shared by every swapchain image, so each frame continues from
+// the frame submitted just before it.
+class LodSelector {
+  public:
+    // Every vector is indexed by swapchain image. Each indirect buffer holds commandCount
+    // commands, and each instance buffer the InstanceData the commands' instances index.
+    void create(const VulkanDevice& vulkanDevice, const std::vector<VkBuffer>& uniformBuffers,
+                const std::vector<VkBuffer>& instanceBuffers,
+                const std::vector<VkBuffer>& indirectBuffers, uint32_t commandCount);
+    void destroy();
+    // Rebuilds the pipeline from the shader currently in the registry.
+    void reloadPipeline();
+
+    // One LodDraw per indirect command, persistently mapped; written while the image's commands
+    // are recorded.
+    LodDraw* getDraws(uint32_t imageIndex) const { return drawMappings[imageIndex]; }
+    // Records the selection, followed by a barrier that makes the patched commands visible to
+    // indirect draws and the selection state to the next frame's selection and the host.
+    void record(VkCommandBuffer commandBuffer, uint32_t imageIndex) const;
+
+  private:
+    void createPipeline();
+    void createDescriptorSets(const std::vector<VkBuffer>& uniformBuffers,
+                              const std::vector<VkBuffer>& instanceBuffers);
+
+    const VulkanDevice* vulkanDevice = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+    uint32_t commandCount = 0;
+
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+
+    std::vector<VkBuffer> indirectBuffers;
+    std::vector<VkBuffer> drawBuffers;
+    std::vector<VkDeviceMemory> drawBuffersMemory;
+    std::vector<LodDraw*> drawMappings;
+
+    VkBuffer stateBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory stateBufferMemory = VK_NULL_HANDLE;
+    LodState* stateMapping = nullptr;
+    // Read back by destroy() so the levels survive swapchain recreation.
+    std::vector<LodState> savedStates;
+
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> descriptorSets;
+};
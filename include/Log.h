@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+// Each subsystem has its own level, so one noisy area can be turned up without the others.
+enum class LogSubsystem { App, Device, Render, Streaming, Shaders, Validation, Count };
+enum class LogLevel { Trace, Debug, Info, Warn, Error, Off };
+
+// Messages are formatted by the caller and written by a background thread through a bounded
+// queue. When the queue is full the oldest messages are dropped, so logging never waits on I/O.
+// Warnings and errors are flushed as soon as the background thread reaches them, everything else
+// at least once a second.
+//
+// levels is a comma separated list of "level" for every subsystem or "subsystem=level", applied
+// in order, e.g. "warn,shaders=debug". Levels are trace, debug, info, warn, error and off; the
+// default is info.
+void initLogging(const std::string& levels = {});
+// Writes every queued message and stops logging; later messages are dropped. Call it once the
+// threads that log have stopped.
+void shutdownLogging();
+// Throws on an unknown subsystem or level, leaving the current levels unchanged.
+void setLogLevels(const std::string& levels);
+
+bool isLogEnabled(LogSubsystem subsystem, LogLevel level);
+// Errors and validation messages carry the number of the frame being recorded.
+void logMessage(LogSubsystem subsystem, LogLevel level, const std::string& message);
+void setLogFrame(uint64_t frame);
+
+// Streams message into a string only when the subsystem logs at level:
+//     LOG(Streaming, Info, "texture cache: " << slots << " tiles");
+#define LOG(subsystem, level, message)                                                        \
+    do {                                                                                      \
+        if (isLogEnabled(LogSubsystem::subsystem, LogLevel::level)) {                         \
+            std::ostringstream logStream;                                                     \
+            logStream << message;                                                             \
+            logMessage(LogSubsystem::subsystem, LogLevel::level, logStream.str());            \
+        }                                                                                     \
+    } while (false)
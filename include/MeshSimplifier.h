@@ -0,0 +1,34 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "AssetPack.h"
+
+// Levels of detail of one mesh, as stored in an asset pack entry.
+struct MeshLodChain {
+    // Every level's indices, finest first and back to back.
+    std::vector<uint16_t> indices;
+    std::vector<uint32_t> lodIndexCounts;
+    // Center and radius around every vertex.
+    glm::vec4 boundingSphere{0.0f};
+};
+
+// Quadric edge-collapse simplification of a triangle list. Each collapse moves a vertex onto a
+// neighbour, so the result indexes the same vertices and every level can share one vertex
+// buffer. Stops once at most targetIndexCount indices remain or the cheapest collapse would move
+// the surface further than maxError. Open borders only collapse along themselves, and vertices
+// sharing a position with another (attribute seams) stay where they are.
+std::vector<uint16_t> simplifyMesh(const glm::vec3* positions, uint32_t vertexCount,
+                                   const uint16_t* indices, uint32_t indexCount,
+                                   uint32_t targetIndexCount, float maxError);
+
+// Builds up to MAX_MESH_LODS levels, each aiming for half the triangles of the one before with
+// an error bound relative to the mesh's size that doubles per level. Stops early when a level no
+// longer gets meaningfully smaller.
+MeshLodChain buildMeshLods(const glm::vec3* positions, uint32_t vertexCount,
+                           const uint16_t* indices, uint32_t indexCount);
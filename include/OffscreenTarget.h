@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "GraphicsPipeline.h"
+#include "RenderGraph.h"
+#include "RenderTarget.h"
+#include "SceneView.h"
+
+class SceneResources;
+class VulkanDevice;
+
+// Renders a SceneResources into an image owned by the target instead of a swapchain, for
+// headless jobs on devices without a surface. Frames are submitted and waited on one at a time.
+class OffscreenTarget {
+  public:
+    OffscreenTarget() = default;
+    OffscreenTarget(const OffscreenTarget&) = delete;
+    OffscreenTarget& operator=(const OffscreenTarget&) = delete;
+
+    void create(const VulkanDevice& vulkanDevice, const SceneResources& scene, VkExtent2D extent,
+                const RenderTargetOptions& options = {});
+    void destroy();
+
+    // Renders one frame and waits for it; the image is left in TRANSFER_SRC_OPTIMAL for readback.
+    void renderFrame();
+    // GPU time of each pass of the last frame; false when the device has no timestamps or no
+    // frame was rendered yet.
+    bool getLastFramePassTimes(std::vector<RenderGraphPassTime>& times) const;
+
+    VkImage getImage() const { return image; }
+    VkFormat getFormat() const { return format; }
+    VkExtent2D getExtent() const { return extent; }
+
+  private:
+    void createRenderGraph();
+    void createPipeline();
+
+    const VulkanDevice* vulkanDevice = nullptr;
+    const SceneResources* scene = nullptr;
+    VkExtent2D extent{};
+    VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+    VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+    bool dynamicRendering = false;
+    bool frameRendered = false;
+
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory imageMemory = VK_NULL_HANDLE;
+    VkImageView imageView = VK_NULL_HANDLE;
+
+    RenderGraph renderGraph;
+    RenderGraphResource output;
+    RenderGraphPass* mainPass = nullptr;
+    RenderGraphResource shadowMap;
+    RenderGraphPass* shadowPass = nullptr;
+
+    GraphicsPipeline pipeline;
+    GraphicsPipeline shadowPipeline;
+    SceneView view;
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "RenderTarget.h"
+
+class SceneResources;
+class Swapchain;
+class VulkanDevice;
+class VulkanInstance;
+struct GLFWwindow;
+
+// Frames kept in the overlay's frame time graphs.
+const uint32_t OVERLAY_HISTORY_FRAMES = 120;
+
+// CPU time of one phase of the main loop.
+struct FramePhaseTime {
+    std::string name;
+    double milliseconds = 0.0;
+};
+
+// ImGui window showing frame time graphs, CPU and GPU timings, draw and bind counts, memory and
+// streaming state, with live controls for the target's present mode, frames in flight, MSAA and
+// dynamic rendering. It renders in its own render pass on top of the presented image, which the
+// ImGui backend needs whether or not the target renders dynamically, recorded every frame into a
+// command buffer submitted after the target's, and times itself on both the CPU and the GPU so
+// its cost shows apart from the frame's.
+class PerformanceOverlay {
+  public:
+    // window receives ImGui's input callbacks, chained to the ones already installed. format and
+    // imageCount are the swapchain's the overlay will draw into.
+    void create(const VulkanInstance& instance, const VulkanDevice& vulkanDevice,
+                GLFWwindow* window, VkFormat format, uint32_t imageCount);
+    void destroy();
+
+    // Called by RenderTarget whenever its swapchain is created or destroyed.
+    void createSwapchainResources(const Swapchain& swapchain);
+    void destroySwapchainResources();
+
+    // Builds the overlay's UI for this frame from target, scene and the main loop's phases.
+    // Returns true when a control changed options, which the caller then applies to the target.
+    bool draw(const RenderTarget& target, const SceneResources& scene,
+              const std::vector<FramePhaseTime>& cpuPhases, RenderTargetOptions& options);
+    // Records the UI built by the last draw() for imageIndex, whose previous frame must have
+    // finished. The returned command buffer is valid until imageIndex is next recorded.
+    VkCommandBuffer record(uint32_t imageIndex);
+
+  private:
+    void createRenderPass(VkFormat format);
+    void createDescriptorPool();
+    void createCommandPool();
+
+    const VulkanDevice* vulkanDevice = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+
+    // Per swapchain image.
+    VkExtent2D extent{};
+    std::vector<VkFramebuffer> framebuffers;
+    std::vector<VkCommandBuffer> commandBuffers;
+    // Whether the image's command buffer has been recorded, so its timestamps will be written.
+    std::vector<uint8_t> imagesRecorded;
+    VkQueryPool timestampQueryPool = VK_NULL_HANDLE;
+
+    // Ring buffers of frame times in milliseconds, oldest at historyOffset.
+    std::array<float, OVERLAY_HISTORY_FRAMES> cpuHistory{};
+    std::array<float, OVERLAY_HISTORY_FRAMES> gpuHistory{};
+    uint32_t historyOffset = 0;
+    std::chrono::high_resolution_clock::time_point lastDrawTime;
+
+    // The overlay's own cost: draw() plus record() on the CPU, its render pass on the GPU.
+    double cpuTime = 0.0;
+    double gpuTime = 0.0;
+};
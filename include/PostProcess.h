@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "RenderGraph.h"
+
+class VulkanDevice;
+
+// Format of the scene colour the post chain reads. Storage, sampling, blending and blits from it
+// are mandatory for every Vulkan device.
+const VkFormat HDR_COLOR_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+// HDR post-processing as compute passes of a RenderGraph: a log luminance histogram drives auto
+// exposure, a dual filter downsample/upsample chain adds bloom, then the image is tonemapped,
+// anti-aliased with FXAA and blitted into the output. Every intermediate is a graph transient,
+// so images whose lifetimes do not overlap share memory.
+class PostProcessChain {
+  public:
+    void create(const VulkanDevice& vulkanDevice);
+    void destroy();
+    // Rebuilds the compute pipelines from the shaders currently in the registry.
+    void reloadPipelines();
+
+    // Declares the passes reading hdr and writing output, which must have hdr's extent and
+    // accept transfer writes.
+    void addPasses(RenderGraph& renderGraph, RenderGraphResource hdr, RenderGraphResource output);
+    // Writes the descriptor sets for the passes of the last addPasses(), whose graph must be
+    // compiled.
+    void updateDescriptors(const RenderGraph& renderGraph);
+    // Frees the descriptor sets; must be called before the graph is destroyed.
+    void releaseDescriptors();
+
+  private:
+    enum Kernel {
+        Histogram,
+        Exposure,
+        BloomDown,
+        BloomUp,
+        Tonemap,
+        Fxaa,
+        KERNEL_COUNT,
+    };
+
+    // One compute pass. Inputs are sampled through bindings 0 and 1, output is the storage image
+    // at binding 2 and the exposure state buffer is always at binding 3.
+    struct Dispatch {
+        Kernel kernel;
+        std::array<RenderGraphResource, 2> inputs;
+        RenderGraphResource output;
+        // Interpreted by each shader's push constant block.
+        std::array<float, 4> constants;
+        // Workgroup counts.
+        uint32_t groupsX = 1;
+        uint32_t groupsY = 1;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    };
+
+    void createPipelines();
+    void destroyPipelines();
+    void createExposureState();
+    RenderGraphPass& addDispatch(RenderGraph& renderGraph, const std::string& name,
+                                 Dispatch dispatch);
+    void recordDispatch(VkCommandBuffer commandBuffer, const Dispatch& dispatch) const;
+    void recordStateBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStages,
+                            VkAccessFlags srcAccess, VkPipelineStageFlags dstStages,
+                            VkAccessFlags dstAccess) const;
+
+    const VulkanDevice* vulkanDevice = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    std::array<VkPipeline, KERNEL_COUNT> pipelines{};
+
+    // Luminance histogram, adapted luminance and exposure, carried over from frame to frame.
+    VkBuffer exposureState = VK_NULL_HANDLE;
+    VkDeviceMemory exposureStateMemory = VK_NULL_HANDLE;
+
+    // Indexed by the passes' execute callbacks, so it only changes in addPasses().
+    std::vector<Dispatch> dispatches;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "VulkanDevice.h"
+
+// Refers to a submission queued on a QueueScheduler until the next flush.
+struct SubmissionHandle {
+    uint32_t index = UINT32_MAX;
+    uint64_t flushIndex = 0;
+};
+
+// Makes a submission wait for an earlier one before running its work at stages.
+struct SubmissionWait {
+    SubmissionHandle submission;
+    VkPipelineStageFlags stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+};
+
+// Batches command buffers for the graphics, compute and transfer queues and orders work across
+// queues with semaphores, so uploads and compute can overlap graphics instead of serialising
+// behind it. Submissions are collected until flush(), which issues one vkQueueSubmit per queue
+// unless a cross-queue wait needs an earlier batch to be submitted first. Semaphores, fences and
+// the command buffers from beginCommands are recycled once the GPU is done with them.
+class QueueScheduler {
+  public:
+    void create(const VulkanDevice& vulkanDevice);
+    // Waits for all flushed work.
+    void destroy();
+
+    // A primary command buffer from the queue type's pool, ready for recording. submit() ends it.
+    VkCommandBuffer beginCommands(QueueType queue);
+    SubmissionHandle submit(QueueType queue, VkCommandBuffer commandBuffer,
+                            const std::vector<SubmissionWait>& waits = {});
+    // Returns an index identifying this flush for isFlushFinished().
+    uint64_t flush();
+    // Blocks until all flushed work has finished.
+    void waitIdle();
+    // Whether all flushed work has finished, without blocking.
+    bool isIdle();
+    // Whether the given flush and every flush before it have finished, without blocking.
+    bool isFlushFinished(uint64_t index);
+
+  private:
+    struct Submission {
+        VkQueue queue = VK_NULL_HANDLE;
+        QueueType queueType = QueueType::Graphics;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        bool ownsCommandBuffer = false;
+        std::vector<uint32_t> waitSources;
+        std::vector<VkSemaphore> waitSemaphores;
+        std::vector<VkPipelineStageFlags> waitStages;
+        std::vector<VkSemaphore> signalSemaphores;
+        bool submitted = false;
+    };
+
+    // Work from one vkQueueSubmit, released when its fence signals.
+    struct InFlightBatch {
+        VkFence fence = VK_NULL_HANDLE;
+        uint64_t flushIndex = 0;
+        std::vector<VkSemaphore> semaphores;
+        std::vector<std::pair<QueueType, VkCommandBuffer>> commandBuffers;
+    };
+
+    void submitQueue(VkQueue queue, size_t end);
+    void recycle(bool wait);
+    VkSemaphore acquireSemaphore();
+    VkFence acquireFence();
+
+    const VulkanDevice* vulkanDevice = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+
+    uint64_t flushIndex = 0;
+    std::vector<Submission> submissions;
+    std::vector<std::pair<QueueType, VkCommandBuffer>> begunCommandBuffers;
+    std::vector<InFlightBatch> inFlight;
+
+    std::vector<VkSemaphore> freeSemaphores;
+    std::vector<VkFence> freeFences;
+};
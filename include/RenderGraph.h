@@ -0,0 +1,279 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using RenderGraphResource = uint32_t;
+
+using RenderGraphExecuteFn
+    = std::function<void(VkCommandBuffer commandBuffer, uint32_t imageIndex)>;
+
+struct ImageSyncState {
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkPipelineStageFlags stages = 0;
+    VkAccessFlags access = 0;
+};
+
+// Pipeline stages and access masks that touch an image while it is in the given layout.
+ImageSyncState getLayoutSyncState(VkImageLayout layout);
+
+VkImageAspectFlags getImageAspectFlags(VkFormat format);
+
+struct RenderGraphImageInfo {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkExtent2D extent{};
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    uint32_t layers = 1;
+};
+
+struct RenderGraphStats {
+    uint32_t declaredPasses = 0;
+    uint32_t culledPasses = 0;
+    uint32_t barrierBatches = 0;
+    uint32_t imageBarriers = 0;
+    // Device-local memory allocated for graph-owned images after aliasing.
+    VkDeviceSize attachmentMemory = 0;
+    // Lazily allocated memory reserved for transient attachments.
+    VkDeviceSize lazyAttachmentMemory = 0;
+    // Largest total size of graph-owned images alive during any single pass.
+    VkDeviceSize peakLiveAttachmentMemory = 0;
+    // What the graph-owned images would need with one allocation each.
+    VkDeviceSize unaliasedAttachmentMemory = 0;
+};
+
+struct RenderGraphPassTime {
+    std::string name;
+    double milliseconds = 0.0;
+};
+
+class RenderGraphPass {
+  public:
+    RenderGraphPass& writeColor(RenderGraphResource resource,
+                                VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                                VkClearValue clearValue = {});
+    RenderGraphPass& writeDepthStencil(RenderGraphResource resource,
+                                       VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                                       VkClearValue clearValue = {});
+    // Resolves the multisampled colour attachment source into target at the end of the pass.
+    RenderGraphPass& resolveColor(RenderGraphResource source, RenderGraphResource target);
+    RenderGraphPass& readDepthStencil(RenderGraphResource resource);
+    RenderGraphPass& readTexture(
+        RenderGraphResource resource,
+        VkPipelineStageFlags stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    RenderGraphPass& readStorage(RenderGraphResource resource, VkPipelineStageFlags stages);
+    RenderGraphPass& writeStorage(RenderGraphResource resource, VkPipelineStageFlags stages);
+    RenderGraphPass& readTransfer(RenderGraphResource resource);
+    RenderGraphPass& writeTransfer(RenderGraphResource resource);
+
+    // Renders the attachment layers set in viewMask in one multiview pass; shaders select their
+    // layer with gl_ViewIndex. The attachments need at least as many layers as the highest bit.
+    RenderGraphPass& setViewMask(uint32_t mask);
+    // Keeps the pass alive even when nothing consumes its outputs.
+    RenderGraphPass& setSideEffects();
+    RenderGraphPass& setExecute(RenderGraphExecuteFn callback);
+
+    const std::string& getName() const { return name; }
+    // Pipelines drawing in the pass are created against its render pass, or against its
+    // attachment formats when the graph uses dynamic rendering and the render pass is null. Both
+    // are set by compile().
+    VkRenderPass getRenderPass() const { return renderPass; }
+    const VkPipelineRenderingCreateInfoKHR& getRenderingInfo() const { return renderingInfo; }
+    bool isCulled() const { return culled; }
+
+  private:
+    friend class RenderGraph;
+
+    struct Access {
+        RenderGraphResource resource;
+        ImageSyncState state;
+        VkImageUsageFlags usage;
+        bool read;
+        bool write;
+        // The previous contents are not needed, so the layout transition may discard them.
+        bool discard;
+    };
+
+    struct Attachment {
+        RenderGraphResource resource;
+        VkAttachmentLoadOp loadOp;
+        VkClearValue clearValue;
+        VkImageLayout layout;
+        bool store = true;
+    };
+
+    RenderGraphPass(std::string name, VkPipelineBindPoint bindPoint)
+        : name(std::move(name)), bindPoint(bindPoint) {}
+
+    void addAccess(RenderGraphResource resource, VkImageLayout layout, VkPipelineStageFlags stages,
+                   VkAccessFlags access, VkImageUsageFlags usage, bool read, bool write,
+                   bool discard = false);
+
+    std::string name;
+    VkPipelineBindPoint bindPoint;
+    std::vector<Access> accesses;
+    std::vector<Attachment> colorAttachments;
+    // Parallel to colorAttachments; VK_ATTACHMENT_UNUSED marks colour attachments not resolved.
+    std::vector<Attachment> resolveAttachments;
+    std::vector<Attachment> depthAttachment;
+    uint32_t viewMask = 0;
+    bool sideEffects = false;
+    bool culled = false;
+    RenderGraphExecuteFn execute;
+
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    // pColorAttachmentFormats points into colorFormats.
+    std::vector<VkFormat> colorFormats;
+    VkPipelineRenderingCreateInfoKHR renderingInfo{};
+};
+
+// Frame graph of image resources and the passes that read and write them. Passes declare their
+// accesses up front; compile() culls passes that do not contribute to an output, derives the
+// minimal set of layout transitions and barriers between passes, batches them into one
+// vkCmdPipelineBarrier per pass and lets transient images with disjoint lifetimes share memory.
+// Attachments that never leave their render pass are created with
+// VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT and backed by lazily allocated memory where available.
+// Graphics passes are recorded in render pass and framebuffer objects, or with
+// VK_KHR_dynamic_rendering, which supplies the attachments when the pass begins instead.
+class RenderGraph {
+  public:
+    // An image owned outside the graph (e.g. a swapchain image). The graph transitions it to
+    // finalLayout after its last use; VK_IMAGE_LAYOUT_UNDEFINED means it is not a graph output.
+    RenderGraphResource importImage(const std::string& name, const RenderGraphImageInfo& info,
+                                    ImageSyncState initialState, VkImageLayout finalLayout);
+    // A transient image owned and allocated by the graph.
+    RenderGraphResource createImage(const std::string& name, const RenderGraphImageInfo& info);
+
+    RenderGraphPass& addPass(const std::string& name,
+                             VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+    // Records graphics passes with vkCmdBeginRenderingKHR instead of render pass and framebuffer
+    // objects; the device must have VK_KHR_dynamic_rendering enabled. Call before compile().
+    void setDynamicRendering(bool enabled) { dynamicRendering = enabled; }
+
+    // memProperties are the device's, from its DeviceCapabilities.
+    void compile(VkDevice device, const VkPhysicalDeviceMemoryProperties& memProperties);
+
+    void setImportedImage(RenderGraphResource resource, VkImage image, VkImageView imageView);
+    void execute(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+
+    // Writes GPU timestamps between the passes of every execute() whose imageIndex is below
+    // recordingCount. Call after compile(); does nothing when timestampPeriod, the device's
+    // nanoseconds per tick, is 0.
+    void enableTimestamps(uint32_t recordingCount, float timestampPeriod);
+    // Blocks until the commands executed for imageIndex have finished and returns the GPU time of
+    // each pass. Only valid once those commands have been submitted. Without wait it returns
+    // false instead of blocking while they are still running.
+    bool getPassTimes(uint32_t imageIndex, std::vector<RenderGraphPassTime>& times,
+                      bool wait = true) const;
+
+    // Destroys every Vulkan object owned by the graph and forgets all declarations.
+    void destroy();
+    // Like destroy(), but keeps the timestamp query pool for the next enableTimestamps() to
+    // reuse when the graph is declared again with as many passes, e.g. at a new extent.
+    void clear();
+
+    VkImage getImage(RenderGraphResource resource) const;
+    VkImageView getImageView(RenderGraphResource resource) const;
+    const RenderGraphImageInfo& getImageInfo(RenderGraphResource resource) const;
+    const RenderGraphStats& getStats() const { return stats; }
+
+  private:
+    struct ImageResource {
+        std::string name;
+        RenderGraphImageInfo info;
+        bool imported = false;
+        ImageSyncState initialState;
+        VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkImageUsageFlags usage = 0;
+        // Some pass stores its contents, so it cannot be a transient attachment.
+        bool stored = false;
+        bool transient = false;
+        uint32_t firstPass = UINT32_MAX;
+        uint32_t lastPass = 0;
+        uint32_t memorySlot = UINT32_MAX;
+        VkMemoryRequirements memoryRequirements{};
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView imageView = VK_NULL_HANDLE;
+    };
+
+    struct MemorySlot {
+        VkDeviceSize size = 0;
+        VkDeviceSize alignment = 1;
+        uint32_t memoryTypeBits = UINT32_MAX;
+        VkMemoryPropertyFlags properties = 0;
+        bool lazy = false;
+        std::vector<RenderGraphResource> resources;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+    };
+
+    // Per-image hazard tracking used while deriving barriers.
+    struct TrackedState {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags writeStages = 0;
+        VkAccessFlags writeAccess = 0;
+        VkPipelineStageFlags readStages = 0;
+        VkAccessFlags readAccess = 0;
+    };
+
+    struct BarrierBatch {
+        VkPipelineStageFlags srcStages = 0;
+        VkPipelineStageFlags dstStages = 0;
+        std::vector<VkImageMemoryBarrier> imageBarriers;
+        std::vector<RenderGraphResource> barrierResources;
+
+        bool empty() const { return srcStages == 0 && dstStages == 0 && imageBarriers.empty(); }
+    };
+
+    struct CompiledPass {
+        RenderGraphPass* pass;
+        BarrierBatch barriers;
+        VkExtent2D extent{};
+        uint32_t layers = 1;
+        std::vector<VkClearValue> clearValues;
+        std::vector<RenderGraphResource> attachmentResources;
+        // A graphics pass with attachments, begun and ended by the graph.
+        bool rendering = false;
+        std::map<std::vector<VkImageView>, VkFramebuffer> framebuffers;
+    };
+
+    void cullPasses();
+    void computeLifetimes();
+    void allocateImages(const VkPhysicalDeviceMemoryProperties& memProperties);
+    void buildBarriers();
+    void checkResolves(const RenderGraphPass& pass) const;
+    void createRenderPass(CompiledPass& compiledPass);
+    void setRenderingFormats(CompiledPass& compiledPass);
+    void addBarrier(TrackedState& tracked, RenderGraphResource resource,
+                    const RenderGraphPass::Access& access, BarrierBatch& batch);
+    VkFramebuffer getFramebuffer(CompiledPass& compiledPass);
+    void recordRenderPass(VkCommandBuffer commandBuffer, CompiledPass& compiledPass,
+                          uint32_t imageIndex);
+    void recordRendering(VkCommandBuffer commandBuffer, CompiledPass& compiledPass,
+                         uint32_t imageIndex);
+    void recordBarriers(VkCommandBuffer commandBuffer, BarrierBatch& batch);
+
+    VkDevice device = VK_NULL_HANDLE;
+    bool dynamicRendering = false;
+    PFN_vkCmdBeginRenderingKHR cmdBeginRendering = nullptr;
+    PFN_vkCmdEndRenderingKHR cmdEndRendering = nullptr;
+    std::vector<ImageResource> images;
+    std::vector<std::unique_ptr<RenderGraphPass>> passes;
+    std::vector<CompiledPass> compiledPasses;
+    std::vector<MemorySlot> memorySlots;
+    BarrierBatch finalBarriers;
+    RenderGraphStats stats;
+
+    // One timestamp before the first pass and one after each pass, per recording.
+    VkQueryPool timestampQueryPool = VK_NULL_HANDLE;
+    uint32_t timestampRecordings = 0;
+    // Queries per recording in the pool; timestamps are off while it differs from the compiled
+    // graph's, after clear() until enableTimestamps().
+    uint32_t timestampQueryCount = 0;
+    float timestampPeriod = 0.0f;
+};
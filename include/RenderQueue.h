@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+// One indexed draw and the state it needs. Items are sorted by pass first, then by pipeline,
+// material (descriptor set) and mesh, then front to back by depth.
+struct RenderQueueItem {
+    // Lower passes are recorded first.
+    uint32_t pass = 0;
+    // View depth in [0, 1]; out of range values are clamped.
+    float depth = 0.0f;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+    VkBuffer vertexBuffer = VK_NULL_HANDLE;
+    VkBuffer instanceBuffer = VK_NULL_HANDLE;
+    VkBuffer indexBuffer = VK_NULL_HANDLE;
+    VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+
+    uint32_t indexCount = 0;
+    uint32_t firstIndex = 0;
+    int32_t vertexOffset = 0;
+    uint32_t firstInstance = 0;
+    uint32_t instanceCount = 1;
+
+    // Not used by the queue; lets the caller tell what an indirect command draws.
+    uint32_t userData = 0;
+};
+
+// Host visible buffer that record() writes draw commands into, so a run of draws sharing all
+// bound state is issued as one indirect draw.
+struct RenderQueueIndirectBuffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    // Byte offset of commands[0] in buffer, so several queues can share one buffer.
+    VkDeviceSize offset = 0;
+    VkDrawIndexedIndirectCommand* commands = nullptr;
+    uint32_t capacity = 0;
+    // Without the multiDrawIndirect feature each command needs its own indirect draw call.
+    bool multiDraw = false;
+};
+
+struct RenderQueueStats {
+    uint32_t items = 0;
+    // Items with matching state and adjacent instances are recorded as one draw.
+    uint32_t draws = 0;
+    // vkCmdDrawIndexed and vkCmdDrawIndexedIndirect calls.
+    uint32_t drawCalls = 0;
+    uint32_t pipelineBinds = 0;
+    uint32_t descriptorSetBinds = 0;
+    uint32_t vertexBufferBinds = 0;
+    uint32_t indexBufferBinds = 0;
+};
+
+// Collects draws, orders them by packed 64-bit sort keys and records them with only the binds
+// that change between consecutive draws. Pipelines, descriptor sets and vertex/index buffer pairs
+// are numbered in the order they are first added, so the key groups equal state without
+// comparing handles.
+class RenderQueue {
+  public:
+    void clear();
+    void add(const RenderQueueItem& item);
+
+    // Radix sorts the keys, splitting each pass over up to threadCount threads.
+    void sort(uint32_t threadCount = 1);
+    // Records the sorted items; the render pass must already be begun. With an indirect buffer
+    // the draws go through it, and direct draws are only used once it is full.
+    void record(VkCommandBuffer commandBuffer, const RenderQueueIndirectBuffer* indirect = nullptr);
+
+    uint32_t getItemCount() const { return static_cast<uint32_t>(items.size()); }
+    const RenderQueueItem& getItem(uint32_t index) const { return items[index]; }
+    // Index of the first item merged into each indirect command written by the last record(), in
+    // command order.
+    const std::vector<uint32_t>& getIndirectItems() const { return indirectItems; }
+    // Counts from the last record().
+    const RenderQueueStats& getStats() const { return stats; }
+
+  private:
+    void recordIndirectDraws(VkCommandBuffer commandBuffer,
+                             const RenderQueueIndirectBuffer& indirect, uint32_t first,
+                             uint32_t count);
+
+    struct SortEntry {
+        uint64_t key;
+        uint32_t item;
+    };
+
+    template <typename Handle>
+    static uint32_t getStateId(std::map<Handle, uint32_t>& ids, Handle handle, uint32_t limit,
+                               const char* what);
+
+    std::vector<RenderQueueItem> items;
+    std::vector<SortEntry> entries;
+    std::vector<SortEntry> scratch;
+    std::vector<uint32_t> indirectItems;
+
+    std::map<VkPipeline, uint32_t> pipelineIds;
+    std::map<VkDescriptorSet, uint32_t> materialIds;
+    std::map<std::pair<VkBuffer, VkBuffer>, uint32_t> meshIds;
+
+    RenderQueueStats stats;
+};
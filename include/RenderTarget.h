@@ -0,0 +1,154 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+#include "FrameManager.h"
+#include "GraphicsPipeline.h"
+#include "PostProcess.h"
+#include "RenderGraph.h"
+#include "SceneView.h"
+#include "Swapchain.h"
+#include "VirtualTexture.h"
+
+class PerformanceOverlay;
+class SceneResources;
+class VulkanDevice;
+
+struct RenderTargetOptions {
+    // Requested MSAA sample count, clamped to what the device supports.
+    uint32_t msaaSamples = 4;
+    // Falls back to FIFO when the surface does not support it.
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+    // Clamped to [1, MAX_FRAMES_IN_FLIGHT].
+    uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+    // Renders without render pass and framebuffer objects, and keeps the pipelines across
+    // resizes. Ignored when the device has no VK_KHR_dynamic_rendering.
+    bool dynamicRendering = false;
+};
+
+// Points info at the render pass pipelines drawing in pass are created against, or at its
+// attachment formats when the pass renders dynamically.
+void setPipelinePass(GraphicsPipelineInfo& info, const RenderGraphPass& pass);
+
+// Declares the compute pass that picks the scene's levels of detail; it has to come before every
+// pass drawing the scene. The caller sets the pass's execute callback.
+RenderGraphPass& addLodPass(RenderGraph& renderGraph);
+
+// Declares the pass rendering every shadow cascade into the layers of one depth image, returned
+// in shadowMap, in a single multiview pass. The caller sets the pass's execute callback.
+RenderGraphPass& addShadowPass(RenderGraph& renderGraph, VkFormat format,
+                               RenderGraphResource& shadowMap);
+
+// Declares the pass rendering the virtual texture tiles the scene samples into an R32_UINT image
+// at a fraction of extent, returned in feedback. The caller sets the pass's execute callback.
+RenderGraphPass& addFeedbackPass(RenderGraph& renderGraph, VkExtent2D extent, VkFormat depthFormat,
+                                 RenderGraphResource& feedback);
+
+// Declares the scene's colour and depth pass writing output and sampling shadowMap, rendering
+// multisampled and resolving into output when samples is above one. The caller sets the pass's
+// execute callback.
+RenderGraphPass& addScenePass(RenderGraph& renderGraph, RenderGraphResource output,
+                              const RenderGraphImageInfo& outputInfo, VkFormat depthFormat,
+                              VkSampleCountFlagBits samples, RenderGraphResource shadowMap);
+
+// Renders a SceneResources to one surface through an HDR target and the post-processing chain.
+// Any number of targets can share a VulkanDevice and a scene; the swapchain, render graph,
+// pipeline, uniforms and frame synchronisation are per target. The caller drives frames, so one
+// thread can serve several targets.
+class RenderTarget {
+  public:
+    RenderTarget() = default;
+    RenderTarget(const RenderTarget&) = delete;
+    RenderTarget& operator=(const RenderTarget&) = delete;
+
+    // extent is the surface's framebuffer size, used when the surface leaves it to the swapchain.
+    void create(const VulkanDevice& vulkanDevice, const SceneResources& scene,
+                VkSurfaceKHR surface, VkExtent2D extent, const RenderTargetOptions& options = {});
+    void destroy();
+
+    // Renders and presents one frame. With the default timeout of 0 the call returns NotReady
+    // instead of waiting for a free frame slot or swapchain image. After OutOfDate the target
+    // must be resized before the next frame.
+    FrameStatus renderFrame(uint64_t timeout = 0);
+
+    // Recreates the swapchain and the render graph's images at extent. The scene's per-image
+    // buffers, the feedback readback and the timestamp queries are kept.
+    void resize(VkExtent2D extent);
+    // Clamps samples to what the device supports and rebuilds the attachments and pipeline.
+    void setSampleCount(uint32_t samples);
+    // Applies changed options between frames, rebuilding the swapchain resources only when the
+    // sample count, present mode or dynamic rendering changed.
+    void setOptions(const RenderTargetOptions& newOptions);
+    // With the sample count, frames in flight and dynamic rendering actually in use.
+    const RenderTargetOptions& getOptions() const { return options; }
+    // Draws overlay over every frame from the next one on, or stops drawing one when null. The
+    // overlay must outlive the target or be detached first.
+    void setOverlay(PerformanceOverlay* overlay);
+    // Reads the recent GPU times every frame even without an overlay.
+    void setCollectTimings(bool collect) { collectTimings = collect; }
+    // Rebuilds the pipeline from the shaders currently in the registry.
+    void reloadPipeline();
+    // Re-records the frame command buffers, e.g. after the scene's geometry moved.
+    void refreshCommands();
+    // Virtual texture tiles sampled by the frames finished since the last call; the caller
+    // passes them on to the scene's VirtualTexture.
+    std::vector<uint32_t> takeTextureFeedback() { return textureFeedback.take(); }
+
+    VkSampleCountFlagBits getSampleCount() const { return msaaSamples; }
+    // Blocks until the last presented frame finishes and returns its GPU time.
+    bool getLastFrameGpuTime(double& milliseconds) const {
+        return frames.getLastFrameGpuTime(milliseconds);
+    }
+    // Blocks until the last presented frame finishes and returns the GPU time of each pass.
+    bool getLastFramePassTimes(std::vector<RenderGraphPassTime>& times) const;
+    // GPU times of the latest finished frame, read without blocking while an overlay is
+    // attached or timings are collected; empty or zero until one has been read.
+    double getRecentGpuTime() const { return recentGpuTime; }
+    const std::vector<RenderGraphPassTime>& getRecentPassTimes() const { return recentPassTimes; }
+
+    const Swapchain& getSwapchain() const { return swapchain; }
+    const RenderGraphStats& getRenderGraphStats() const { return renderGraph.getStats(); }
+    const RenderQueueStats& getRenderQueueStats() const { return view.getRenderQueueStats(); }
+
+  private:
+    void createSwapchainResources(VkExtent2D extent);
+    void destroySwapchainResources();
+    // Recreates the swapchain resources at extent, and the pipelines unless keepPipelines.
+    void rebuild(VkExtent2D extent, bool keepPipelines);
+    void createRenderGraph();
+    void createPipeline();
+    void destroyPipeline();
+    void recordCommandBuffers();
+    void recordMainPass(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+
+    const VulkanDevice* vulkanDevice = nullptr;
+    const SceneResources* scene = nullptr;
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
+    RenderTargetOptions options;
+    VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    Swapchain swapchain;
+
+    RenderGraph renderGraph;
+    RenderGraphResource backbuffer;
+    RenderGraphPass* mainPass = nullptr;
+    RenderGraphResource shadowMap;
+    RenderGraphPass* shadowPass = nullptr;
+    RenderGraphResource feedback;
+    RenderGraphPass* feedbackPass = nullptr;
+    PostProcessChain post;
+
+    GraphicsPipeline pipeline;
+    GraphicsPipeline shadowPipeline;
+    GraphicsPipeline feedbackPipeline;
+    SceneView view;
+    VirtualTextureFeedback textureFeedback;
+    FrameManager frames;
+
+    PerformanceOverlay* overlay = nullptr;
+    bool collectTimings = false;
+    double recentGpuTime = 0.0;
+    std::vector<RenderGraphPassTime> recentPassTimes;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+class VirtualTexture;
+class VulkanDevice;
+struct MemoryBudget;
+
+// Share of the device's memory budget streamed textures get when no budget is configured.
+const float TEXTURE_BUDGET_SHARE = 0.25f;
+// Frames between queries of the device's memory budget, which go to the driver every time.
+const uint32_t BUDGET_POLL_INTERVAL = 60;
+
+struct ResidencyStats {
+    // Bytes of tiles the streamed textures may keep resident.
+    VkDeviceSize budget = 0;
+    VkDeviceSize residentBytes = 0;
+    // From the last VulkanDevice::getMemoryBudget() poll, with the usage adjusted by the tile
+    // caches allocated since.
+    VkDeviceSize deviceBudget = 0;
+    VkDeviceSize deviceUsage = 0;
+};
+
+// Keeps the streamed textures under a video memory budget, so a scene that outgrows the device
+// loses texture detail instead of failing to allocate. Each texture's tile cache is sized from
+// what is left of the budget when it is created, and every update() splits the budget between
+// the textures by screen coverage, as resident tile limits. A texture over its limit evicts its
+// least recently used tiles and streams out its finest level until it fits.
+class ResidencyManager {
+  public:
+    // A zero budget follows TEXTURE_BUDGET_SHARE of the device's memory budget instead, which
+    // shrinks and grows with what other processes allocate when VK_EXT_memory_budget is there.
+    void create(const VulkanDevice& vulkanDevice, VkDeviceSize budget);
+    void destroy();
+
+    // Bytes a texture created now may allocate for its tile cache.
+    VkDeviceSize getCacheBudget() const;
+    // The texture must have been created and stay alive until destroy().
+    void addTexture(VirtualTexture& texture);
+
+    // Runs between frames, before the textures' own update(). Queries the driver's budget every
+    // BUDGET_POLL_INTERVAL calls, and on the first call after a texture was added.
+    void update();
+
+    const ResidencyStats& getStats() const { return stats; }
+
+  private:
+    struct Texture {
+        VirtualTexture* texture = nullptr;
+        // Smoothed coverage; only the ratios between textures matter.
+        double priority = 0.0;
+    };
+
+    VkDeviceSize getBudget(const MemoryBudget& deviceBudget) const;
+    VkDeviceSize getAllocatedBytes() const;
+    void pollBudget();
+    MemoryBudget getDeviceBudget() const;
+
+    const VulkanDevice* vulkanDevice = nullptr;
+    VkDeviceSize configuredBudget = 0;
+    std::vector<Texture> textures;
+    ResidencyStats stats;
+
+    // Usage reported by the last poll, and the tile cache bytes allocated at the time.
+    VkDeviceSize polledUsage = 0;
+    VkDeviceSize polledAllocated = 0;
+    uint32_t framesSincePoll = 0;
+};
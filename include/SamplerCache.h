@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+
+struct SamplerInfoHash {
+    size_t operator()(const VkSamplerCreateInfo& info) const;
+};
+
+struct SamplerInfoEqual {
+    bool operator()(const VkSamplerCreateInfo& a, const VkSamplerCreateInfo& b) const;
+};
+
+// Shares one VkSampler between every user asking for the same sampler state. Devices can cap
+// their samplers at maxSamplerAllocationCount, as low as 4000, so one sampler per texture or
+// target does not scale. The cache is keyed on the full VkSamplerCreateInfo, after clearing the
+// fields the state ignores, so samplers that only differ there are shared as well.
+class SamplerCache {
+  public:
+    // limits and enabledFeatures are the device's, kept so creating a sampler queries nothing.
+    void create(VkDevice device, const VkPhysicalDeviceLimits& limits,
+                const VkPhysicalDeviceFeatures& enabledFeatures);
+    // Destroys every sampler handed out.
+    void destroy();
+
+    // The cache owns the sampler; it stays valid until destroy(). Anisotropy is clamped to the
+    // device's limit, or disabled without the samplerAnisotropy feature. Extension structures in
+    // pNext are not supported.
+    VkSampler getSampler(const VkSamplerCreateInfo& info);
+    size_t getSamplerCount() const;
+
+  private:
+    VkDevice device = VK_NULL_HANDLE;
+    float maxAnisotropy = 1.0f;
+    bool anisotropyEnabled = false;
+    uint32_t maxSamplerCount = 0;
+
+    mutable std::mutex mutex;
+    std::unordered_map<VkSamplerCreateInfo, VkSampler, SamplerInfoHash, SamplerInfoEqual> samplers;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+using SceneNode = uint32_t;
+const SceneNode NO_SCENE_NODE = UINT32_MAX;
+
+// Transform hierarchy stored as flat arrays sorted by depth, so the children of a node are
+// contiguous and every parent comes before its children. Changing a local transform marks the
+// node dirty; update() recomputes world transforms level by level for dirty nodes and their
+// descendants only, so its cost follows the number of changed nodes rather than the node count.
+//
+// Every node is one instance of the scene mesh. Instance indices are storage indices and change
+// when nodes are added, which the change history reports as a full change.
+class SceneGraph {
+  public:
+    SceneNode createNode(SceneNode parent = NO_SCENE_NODE,
+                         const glm::mat4& localTransform = glm::mat4(1.0f));
+    void setLocalTransform(SceneNode node, const glm::mat4& localTransform);
+    const glm::mat4& getLocalTransform(SceneNode node) const;
+    // Valid after update().
+    const glm::mat4& getWorldTransform(SceneNode node) const;
+
+    // Propagates dirty transforms. Levels with enough dirty nodes are split across up to
+    // threadCount threads.
+    void update(uint32_t threadCount = 1);
+
+    uint32_t getInstanceCount() const { return static_cast<uint32_t>(worldTransforms.size()); }
+    // World transforms in instance order, laid out as the per-instance vertex data.
+    const glm::mat4* getInstanceTransforms() const { return worldTransforms.data(); }
+
+    // Incremented by every update() that changed a world transform.
+    uint64_t getVersion() const { return version; }
+    // Appends the instances changed by updates after version since. Returns false when the
+    // history does not reach back that far or instances were renumbered, in which case every
+    // instance has to be treated as changed.
+    bool getChangesSince(uint64_t since, std::vector<uint32_t>& instances) const;
+
+  private:
+    void rebuildLayout();
+    void markDirty(uint32_t index);
+    void updateLevel(const std::vector<uint32_t>& level, uint32_t threadCount);
+
+    // Indexed by storage position.
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> firstChildren;
+    std::vector<uint32_t> childCounts;
+    std::vector<uint32_t> depths;
+    std::vector<glm::mat4> localTransforms;
+    std::vector<glm::mat4> worldTransforms;
+    std::vector<uint8_t> dirty;
+    std::vector<SceneNode> nodes;
+
+    // Indexed by SceneNode.
+    std::vector<uint32_t> indices;
+
+    bool layoutChanged = false;
+    std::vector<std::vector<uint32_t>> dirtyLevels;
+
+    struct Change {
+        uint64_t version;
+        std::vector<uint32_t> instances;
+    };
+    uint64_t version = 0;
+    // Updates up to and including this version renumbered instances.
+    uint64_t renumberedVersion = 0;
+    std::deque<Change> history;
+};
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "AssetPack.h"
+#include "GeometryArena.h"
+#include "ResidencyManager.h"
+#include "SceneGraph.h"
+#include "StagingPool.h"
+#include "VirtualTexture.h"
+
+class VulkanDevice;
+
+// The directional light's shadow map is split into this many cascades along the view depth,
+// each a SHADOW_MAP_SIZE square layer of one depth image.
+const uint32_t SHADOW_CASCADE_COUNT = 4;
+const uint32_t SHADOW_MAP_SIZE = 2048;
+
+struct Vertex {
+    glm::vec3 pos;
+    glm::vec3 color;
+    glm::vec2 texCoord;
+
+    static VkVertexInputBindingDescription getBindingDescription();
+    static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions();
+    // Depth-only passes read the arena's separate position stream, a tightly packed vec3 per
+    // vertex, at binding 0 instead.
+    static VkVertexInputBindingDescription getPositionBindingDescription();
+    static VkVertexInputAttributeDescription getPositionAttributeDescription();
+};
+
+// Per instance vertex input: a scene graph node's world transform, one column per location.
+struct InstanceData {
+    glm::mat4 model;
+
+    static VkVertexInputBindingDescription getBindingDescription();
+    static std::array<VkVertexInputAttributeDescription, 4> getAttributeDescriptions();
+};
+
+// A mesh's levels of detail, finest first: index ranges relative to the mesh's range in the
+// geometry arena, all over the same vertices.
+struct MeshLods {
+    uint32_t count = 1;
+    std::array<uint32_t, MAX_MESH_LODS> firstIndex{};
+    std::array<uint32_t, MAX_MESH_LODS> indexCount{};
+    // Center and radius in mesh space.
+    glm::vec4 boundingSphere{0.0f};
+};
+
+struct UniformBufferObject {
+    alignas(16) glm::mat4 model;
+    alignas(16) glm::mat4 view;
+    alignas(16) glm::mat4 proj;
+    // World to light clip space of each shadow cascade.
+    alignas(16) glm::mat4 lightViewProj[SHADOW_CASCADE_COUNT];
+    // View depth at which each cascade ends.
+    alignas(16) glm::vec4 cascadeSplits;
+    // The virtual texture's level 0 width and height and its level count.
+    alignas(16) glm::vec4 virtualTexture;
+    // Tile size and border, and the tile cache's width and height, in texels.
+    alignas(16) glm::vec4 virtualTextureTiles;
+};
+
+// Geometry, virtual texture and transform hierarchy of the demo scene. It is shared between
+// render targets; each target draws it through its own SceneView, one instance per scene graph
+// node.
+class SceneResources {
+  public:
+    // Built by the VulkanLearn_pack target; relative to the working directory.
+    static constexpr const char* ASSET_PACK_PATH = "assets/scene.pack";
+
+    // Uploads every mesh in the asset pack and starts streaming its "texture" virtual texture.
+    // The pack stays open for the streaming until destroy(). textureBudget caps the video memory
+    // of streamed textures in bytes; zero leaves it to the residency manager.
+    void create(const VulkanDevice& vulkanDevice, VkDeviceSize textureBudget = 0);
+    void destroy();
+
+    // Every mesh is drawn once per scene graph node. Their Vertex data and 16-bit indices live
+    // in one geometry arena.
+    GeometryArena& getGeometry() { return geometry; }
+    const GeometryArena& getGeometry() const { return geometry; }
+    const std::vector<GeometryHandle>& getMeshes() const { return meshes; }
+    // Parallel to getMeshes().
+    const std::vector<MeshLods>& getMeshLods() const { return meshLods; }
+
+    SceneGraph& getGraph() { return graph; }
+    const SceneGraph& getGraph() const { return graph; }
+    SceneNode getRootNode() const { return rootNode; }
+
+    // Binding 0 is the UniformBufferObject, 1 the virtual texture's tile cache, 2 the shadow
+    // cascades and 3 the virtual texture's page table. The samplers of 1 and 2 are immutable.
+    VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+    // Render targets feed it the tiles they sample.
+    VirtualTexture& getVirtualTexture() { return virtualTexture; }
+    const VirtualTexture& getVirtualTexture() const { return virtualTexture; }
+    const ResidencyManager& getResidency() const { return residency; }
+    // Runs between frames: rebalances the texture budget and streams the tiles sampled since the
+    // last call.
+    void updateTextures();
+    // Depth comparison sampler for the shadow cascades; lookups outside a cascade count as lit.
+    // Owned by the device's sampler cache.
+    VkSampler getShadowSampler() const { return shadowSampler; }
+
+  private:
+    // Copies recorded for the transfer queue, plus the graphics queue commands that take
+    // ownership of the results when the two queues are in different families. Their source data
+    // is staged in stagingPool, which only exists while create() uploads the scene.
+    struct UploadBatch {
+        VkCommandBuffer transferCommands = VK_NULL_HANDLE;
+        VkCommandBuffer graphicsCommands = VK_NULL_HANDLE;
+    };
+
+    void createShadowSampler();
+    void uploadMesh(UploadBatch& batch, const AssetPackEntry& entry, const AssetPack& assets);
+    void uploadBuffer(UploadBatch& batch, const void* contents, VkDeviceSize size, VkBuffer buffer,
+                      VkDeviceSize offset);
+    void createDescriptorSetLayout();
+    void createSceneGraph();
+
+    const VulkanDevice* vulkanDevice = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+
+    StagingPool stagingPool;
+    AssetPack assets;
+
+    ResidencyManager residency;
+    VirtualTexture virtualTexture;
+    VkSampler shadowSampler = VK_NULL_HANDLE;
+
+    GeometryArena geometry;
+    std::vector<GeometryHandle> meshes;
+    std::vector<MeshLods> meshLods;
+
+    SceneGraph graph;
+    SceneNode rootNode = NO_SCENE_NODE;
+};
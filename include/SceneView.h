@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "LodSelector.h"
+#include "RenderQueue.h"
+
+class GraphicsPipeline;
+class SceneResources;
+class VulkanDevice;
+struct InstanceData;
+
+// One render target's view of a shared SceneResources: the uniform buffers, instance buffers and
+// descriptor sets for each of the target's swapchain images.
+class SceneView {
+  public:
+    // The instance count is fixed to the scene graph's node count at this point. shadowMap is the
+    // target's layered shadow cascade image, sampled by the scene's fragment shader.
+    void create(const VulkanDevice& vulkanDevice, const SceneResources& scene, uint32_t imageCount,
+                VkImageView shadowMap);
+    void destroy();
+    // Points every image's descriptor set at a new shadow map, e.g. after the target's render
+    // graph was rebuilt at another extent. None of the sets may be in use.
+    void setShadowMap(VkImageView shadowMap);
+    // Zero until create().
+    uint32_t getImageCount() const { return static_cast<uint32_t>(descriptorSets.size()); }
+
+    // Writes the camera and the shadow cascades fitted to its frustum.
+    void updateUniformBuffer(uint32_t imageIndex, VkExtent2D extent);
+    // Copies the world transforms changed since this image was last updated into its persistently
+    // mapped instance buffer.
+    void updateInstances(uint32_t imageIndex);
+    // Queues one draw per scene graph node and mesh, sorted to minimise state changes, and
+    // records them, through indirect draws where the device allows. The GPU must no longer be
+    // using the image's previous commands.
+    void draw(VkCommandBuffer commandBuffer, const GraphicsPipeline& pipeline, uint32_t imageIndex);
+    // Draws every instance into the shadow cascades with a depth-only pipeline, reading the
+    // geometry's position stream. One set of draws covers all cascades through multiview.
+    void drawShadowCasters(VkCommandBuffer commandBuffer, const GraphicsPipeline& pipeline,
+                           uint32_t imageIndex);
+    // Draws every instance into the virtual texture feedback target with a pipeline writing the
+    // texture tiles each fragment samples.
+    void drawFeedback(VkCommandBuffer commandBuffer, const GraphicsPipeline& pipeline,
+                      uint32_t imageIndex);
+    // Picks the level of detail of every indirect draw recorded by the draw calls above from its
+    // projected size, on the GPU. Must come before all of them in the command buffer; does
+    // nothing without indirect draws, which then always use the finest level.
+    void selectLods(VkCommandBuffer commandBuffer, uint32_t imageIndex) const;
+    // Rebuilds the LOD selection pipeline from the shader currently in the registry.
+    void reloadPipelines();
+
+    // Bind and draw counts of the last recorded draw().
+    const RenderQueueStats& getRenderQueueStats() const { return renderQueue.getStats(); }
+
+  private:
+    void createDescriptorPool(uint32_t imageCount);
+    void createDescriptorSets(uint32_t imageCount, VkImageView shadowMap);
+    void queueDraws(RenderQueue& queue, const GraphicsPipeline& pipeline, VkBuffer vertexBuffer,
+                    uint32_t imageIndex);
+    void recordQueue(RenderQueue& queue, RenderQueueIndirectBuffer& queueIndirect,
+                     VkCommandBuffer commandBuffer, uint32_t imageIndex);
+
+    const SceneResources* scene = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+
+    std::vector<VkBuffer> uniformBuffers;
+    std::vector<VkDeviceMemory> uniformBuffersMemory;
+
+    uint32_t instanceCount = 0;
+    std::vector<VkBuffer> instanceBuffers;
+    std::vector<VkDeviceMemory> instanceBuffersMemory;
+    std::vector<InstanceData*> instanceMappings;
+    // Scene graph version each image's instance buffer was last synced to.
+    std::vector<uint64_t> instanceVersions;
+    std::vector<uint32_t> changedInstances;
+
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> descriptorSets;
+
+    // Draw commands written by draw(), followed by those of drawShadowCasters() and
+    // drawFeedback(); only created when the device supports indirect draws with a first
+    // instance.
+    std::vector<VkBuffer> indirectBuffers;
+    std::vector<VkDeviceMemory> indirectBuffersMemory;
+    std::vector<VkDrawIndexedIndirectCommand*> indirectMappings;
+    RenderQueueIndirectBuffer indirect;
+    RenderQueueIndirectBuffer shadowIndirect;
+    RenderQueueIndirectBuffer feedbackIndirect;
+    LodSelector lodSelector;
+
+    RenderQueue renderQueue;
+    RenderQueue shadowQueue;
+    RenderQueue feedbackQueue;
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A shader that was recompiled after its source changed. The name follows the embedded shader
+// headers, e.g. shader/shader_depth.vert is "shader_depth_vert".
+struct ShaderUpdate {
+    std::string name;
+    std::vector<uint32_t> code;
+};
+
+// Development helper that watches the shader source directory with inotify and recompiles
+// changed shaders with glslc on a background thread. SPIR-V is cached on disk by a hash of the
+// shader source and every file it includes, so switching back to an earlier version does not
+// invoke the compiler again.
+class ShaderHotReloader {
+  public:
+    ShaderHotReloader(std::string shaderDirectory, std::string cacheDirectory,
+                      std::string compiler = "glslc");
+    ~ShaderHotReloader();
+
+    ShaderHotReloader(const ShaderHotReloader&) = delete;
+    ShaderHotReloader& operator=(const ShaderHotReloader&) = delete;
+
+    void start();
+    void stop();
+
+    // Shaders recompiled since the last call. Meant to be polled once per frame.
+    std::vector<ShaderUpdate> takeUpdates();
+
+  private:
+    void watch();
+    bool compile(const std::string& fileName, std::vector<uint32_t>& code);
+
+    std::string shaderDirectory;
+    std::string cacheDirectory;
+    std::string compiler;
+
+    int inotifyFd = -1;
+    std::atomic<bool> running{false};
+    std::thread watcher;
+
+    std::mutex updatesMutex;
+    std::vector<ShaderUpdate> updates;
+};
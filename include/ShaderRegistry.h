@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Non-owning view of a SPIR-V module.
+struct ShaderCode {
+    const uint32_t* data = nullptr;
+    size_t wordCount = 0;
+
+    // In bytes, as expected by VkShaderModuleCreateInfo::codeSize.
+    size_t size() const { return wordCount * sizeof(uint32_t); }
+};
+
+// SPIR-V embedded at build time, looked up by the generated header name (e.g. "shader_depth_vert"
+// for shader/shader_depth.vert). Throws std::runtime_error for unknown shaders.
+ShaderCode getEmbeddedShader(std::string_view name);
+
+// Replaces an embedded shader for every later getShaderCode call, e.g. with SPIR-V recompiled by
+// the hot reloader. Not thread safe; meant to be called between frames.
+void setShaderOverride(std::string name, std::vector<uint32_t> code);
+
+// The override set for name if there is one, otherwise the embedded shader. The returned view
+// stays valid until the override for name is replaced.
+ShaderCode getShaderCode(std::string_view name);
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+class QueueScheduler;
+class VulkanDevice;
+
+// Mapped upload space inside one of the pool's buffers.
+struct StagingAllocation {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void* data = nullptr;
+};
+
+// Persistently mapped, host visible upload memory shared by every upload of a scene. Allocations
+// are carved linearly out of chunks. retire() ties the chunks written so far to a QueueScheduler
+// flush, and recycle() makes them writable again once that flush has finished, so an upload no
+// longer creates, maps and destroys its own staging buffer.
+//
+// New chunks double in size while every existing chunk is still in flight, and chunks that stay
+// unused for a while are freed again, which shrinks the size back towards the minimum.
+class StagingPool {
+  public:
+    void create(const VulkanDevice& vulkanDevice);
+    // The GPU must be done with every retired chunk.
+    void destroy();
+
+    // Largest size allocate() accepts; bigger uploads have to be split.
+    static VkDeviceSize getMaxAllocationSize();
+    // alignment must be a power of two.
+    StagingAllocation allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+    // Chunks written since the last retire() are in use until the scheduler's flush flushIndex
+    // has finished.
+    void retire(uint64_t flushIndex);
+    void recycle(QueueScheduler& scheduler);
+
+  private:
+    struct Chunk {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void* data = nullptr;
+        VkDeviceSize size = 0;
+        VkDeviceSize used = 0;
+        bool retired = false;
+        uint64_t flushIndex = 0;
+        // recycle() calls this chunk has gone unused for.
+        uint32_t idleRecycles = 0;
+    };
+
+    void destroyChunk(Chunk& chunk);
+
+    const VulkanDevice* vulkanDevice = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+
+    std::vector<Chunk> chunks;
+    VkDeviceSize nextChunkSize = 0;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+class VulkanDevice;
+
+struct SwapChainSupportDetails {
+    VkSurfaceCapabilitiesKHR capabilities;
+    std::vector<VkSurfaceFormatKHR> formats;
+    std::vector<VkPresentModeKHR> presentModes;
+};
+
+SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface);
+
+class Swapchain {
+  public:
+    // framebufferExtent is used when the surface lets the swapchain choose its size. Surface
+    // formats and present modes are queried once per surface and reused when the swapchain is
+    // recreated, for example on resize; only the surface capabilities are queried again. FIFO is
+    // used when the surface does not support preferredPresentMode.
+    void create(const VulkanDevice& vulkanDevice, VkSurfaceKHR surface,
+                VkExtent2D framebufferExtent,
+                VkPresentModeKHR preferredPresentMode = VK_PRESENT_MODE_MAILBOX_KHR);
+    void destroy();
+
+    VkSwapchainKHR getHandle() const { return swapChain; }
+    VkFormat getImageFormat() const { return imageFormat; }
+    VkExtent2D getExtent() const { return extent; }
+    uint32_t getImageCount() const { return static_cast<uint32_t>(images.size()); }
+    VkImage getImage(uint32_t index) const { return images[index]; }
+    VkImageView getImageView(uint32_t index) const { return imageViews[index]; }
+    VkPresentModeKHR getPresentMode() const { return presentMode; }
+    // Present modes the surface supports.
+    const std::vector<VkPresentModeKHR>& getPresentModes() const { return presentModes; }
+
+  private:
+    VkDevice device = VK_NULL_HANDLE;
+    // Surface the cached formats and present modes belong to.
+    VkSurfaceKHR supportSurface = VK_NULL_HANDLE;
+    std::vector<VkSurfaceFormatKHR> surfaceFormats;
+    std::vector<VkPresentModeKHR> presentModes;
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+    std::vector<VkImage> images;
+    std::vector<VkImageView> imageViews;
+    VkFormat imageFormat = VK_FORMAT_UNDEFINED;
+    VkExtent2D extent{};
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+};
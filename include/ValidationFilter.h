@@ -0,0 +1,34 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+// Repeats of a validation message within this interval are counted instead of logged.
+const std::chrono::seconds VALIDATION_REPEAT_INTERVAL{5};
+// Reports per message ID before it is only counted, for messages that fire every frame.
+const uint32_t VALIDATION_MAX_REPORTS = 8;
+
+// Deduplicates and rate limits validation messages by message ID. The first occurrence of an ID
+// is reported; later ones at most once per VALIDATION_REPEAT_INTERVAL, with the number folded
+// into them, and not at all after VALIDATION_MAX_REPORTS. The driver reports from whichever
+// thread made the offending call, so every method may be called concurrently.
+class ValidationFilter {
+  public:
+    // Whether the message should be logged; repeats is set to the occurrences of messageId
+    // suppressed since its last report.
+    bool accept(int64_t messageId, uint32_t& repeats);
+    // Logs how often each ID occurred after its last report, then forgets every ID.
+    void reportSuppressed();
+
+  private:
+    struct MessageCount {
+        uint32_t reports = 0;
+        uint32_t suppressed = 0;
+        std::chrono::steady_clock::time_point lastReport;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<int64_t, MessageCount> messages;
+};
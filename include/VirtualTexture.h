@@ -0,0 +1,235 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "AssetPack.h"
+#include "QueueScheduler.h"
+#include "StagingPool.h"
+
+class VulkanDevice;
+
+// The tile cache is a square of at most this many tile slots per side.
+const uint32_t VIRTUAL_TEXTURE_CACHE_SLOTS = 16;
+// The feedback pass renders at this fraction of the target's width and height.
+const uint32_t VIRTUAL_TEXTURE_FEEDBACK_SCALE = 4;
+// Feedback texel of a fragment that sampled no virtual texture.
+const uint32_t VIRTUAL_TEXTURE_NO_FEEDBACK = 0xffffffff;
+
+struct VirtualTextureStats {
+    uint32_t residentTiles = 0;
+    // Tiles the residency manager currently allows, out of the cache's slots.
+    uint32_t residentLimit = 0;
+    uint32_t cacheSlots = 0;
+    // Finest level streamed; above 0 when the limit cannot hold what the views sample.
+    uint32_t finestLevel = 0;
+    uint32_t pendingLoads = 0;
+    // Since create.
+    uint64_t uploadedTiles = 0;
+    uint64_t evictedTiles = 0;
+};
+
+// A texture streamed tile by tile out of an asset pack, so only what the camera sees occupies
+// video memory. Resident tiles live in the slots of a fixed size cache image; a page table
+// buffer maps every tile of every mip level to the slot holding it, or to the slot of its
+// closest resident ancestor, so a missing tile falls back to a blurrier one instead of a hole.
+//
+// Render targets report the tiles their frames sampled through addFeedback(). update() queues
+// the missing ones for a loader thread, which copies them out of the mapped pack, and uploads
+// the finished ones into the least recently used slots. The coarsest levels are pinned in the
+// cache, so every texel always resolves to something.
+//
+// A ResidencyManager caps the resident tiles below the cache's size. When the views sample more
+// tiles than the cap holds, the finest level is streamed out for the whole texture, and streamed
+// back in once the coarser levels leave enough room.
+class VirtualTexture {
+  public:
+    VirtualTexture() = default;
+    VirtualTexture(const VirtualTexture&) = delete;
+    VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+    // entry must be a VirtualTexture entry of assets, which has to stay open until destroy().
+    // The cache gets as many slots as fit in cacheBudget bytes, but at least four. Uploads the
+    // pinned levels and waits for them.
+    void create(const VulkanDevice& vulkanDevice, const AssetPack& assets,
+                const AssetPackEntry& entry, VkDeviceSize cacheBudget);
+    void destroy();
+
+    // Feedback texels of a frame that has finished: level << 24 | tileY << 12 | tileX, or
+    // VIRTUAL_TEXTURE_NO_FEEDBACK.
+    void addFeedback(const std::vector<uint32_t>& feedback);
+    // Feedback texels added since the last call, a measure of the texture's screen coverage.
+    uint64_t takeCoverage();
+    // Tiles that may be resident from the next update() on, never below the pinned tiles.
+    void setResidentLimit(uint32_t tiles);
+    // Runs between frames. Uploads the tiles the loader has finished, evicting the least
+    // recently used tiles once the cache is full, and queues loads for the tiles requested since
+    // the last update. The uploads go to the graphics queue behind every frame already submitted.
+    void update();
+
+    VkImageView getCacheImageView() const { return cacheImageView; }
+    // Owned by the device's sampler cache.
+    VkSampler getCacheSampler() const { return cacheSampler; }
+    VkBuffer getPageTable() const { return pageTable; }
+
+    uint32_t getWidth() const { return width; }
+    uint32_t getHeight() const { return height; }
+    uint32_t getLevelCount() const { return static_cast<uint32_t>(levels.size()); }
+    uint32_t getTileSize() const { return tileSize; }
+    uint32_t getTileBorder() const { return tileBorder; }
+    // Width and height of the cache image in texels.
+    uint32_t getCacheSize() const { return cacheSlots * tileStride; }
+    uint32_t getSlotCount() const { return static_cast<uint32_t>(slots.size()); }
+    uint32_t getPinnedCount() const { return pinnedCount; }
+    VkDeviceSize getTileBytes() const { return VkDeviceSize(tileStride) * tileStride * 4; }
+
+    VirtualTextureStats getStats() const;
+
+  private:
+    struct Level {
+        uint32_t pagesX = 0;
+        uint32_t pagesY = 0;
+        // Index of the level's first page.
+        uint32_t firstPage = 0;
+    };
+
+    struct Slot {
+        uint32_t page = UINT32_MAX;
+        // update() count at which the tile was last sampled.
+        uint64_t lastUsed = 0;
+        bool pinned = false;
+    };
+
+    struct LoadedTile {
+        uint32_t page = 0;
+        std::vector<unsigned char> texels;
+    };
+
+    void createCache();
+    void createSampler();
+    void createPageTable();
+    void loadPinnedLevels();
+    void startLoader();
+    void stopLoader();
+    void runLoader();
+
+    uint32_t getPageLevel(uint32_t page) const;
+    uint32_t getResidentCount() const;
+    uint32_t acquireSlot();
+    // Evicts the least recently used unpinned tile if it was last sampled before usedBefore.
+    bool evictOldest(uint64_t usedBefore);
+    // Raises or lowers finestLevel from whether the last update() had to drop tiles.
+    void adjustFinestLevel(uint32_t droppedTiles);
+    void recordTileUpload(VkCommandBuffer commandBuffer, uint32_t slot, const void* texels);
+    void makeResident(uint32_t page, uint32_t slot);
+    void evict(uint32_t slot);
+    // Points every entry in the page's subtree, the page included, that resolves to fromLevel
+    // or a coarser level at pageEntry.
+    void fillSubtree(uint32_t page, uint32_t pageEntry, uint32_t fromLevel);
+    void recordPageTableUpload(VkCommandBuffer commandBuffer);
+    void recordCacheBarrier(VkCommandBuffer commandBuffer, VkImageLayout oldLayout,
+                            VkImageLayout newLayout) const;
+
+    const VulkanDevice* vulkanDevice = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+    const AssetPack* assets = nullptr;
+    const AssetPackEntry* entry = nullptr;
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t tileSize = 0;
+    uint32_t tileBorder = 0;
+    // Tile size including the border on both sides.
+    uint32_t tileStride = 0;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    std::vector<Level> levels;
+    // Slots per side of the cache.
+    uint32_t cacheSlots = 0;
+
+    VkImage cacheImage = VK_NULL_HANDLE;
+    VkDeviceMemory cacheImageMemory = VK_NULL_HANDLE;
+    VkImageView cacheImageView = VK_NULL_HANDLE;
+    VkSampler cacheSampler = VK_NULL_HANDLE;
+
+    // One uint per page: slotX | slotY << 8 | resolved level << 16.
+    VkBuffer pageTable = VK_NULL_HANDLE;
+    VkDeviceMemory pageTableMemory = VK_NULL_HANDLE;
+    std::vector<uint32_t> pageEntries;
+    // Range of pageEntries changed since the last upload.
+    uint32_t dirtyBegin = UINT32_MAX;
+    uint32_t dirtyEnd = 0;
+
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+    std::vector<uint32_t> pageSlots;
+    std::vector<bool> pagePending;
+    // Pages requested since the last update, each once.
+    std::vector<uint32_t> requestedPages;
+    std::vector<uint64_t> pageRequested;
+    uint64_t updateCount = 1;
+    uint32_t pendingLoads = 0;
+    uint32_t pinnedCount = 0;
+    uint32_t residentLimit = 0;
+    // Requests for finer levels are served from this one.
+    uint32_t finestLevel = 0;
+    // Consecutive updates that dropped no tile.
+    uint32_t updatesWithoutDrops = 0;
+    uint64_t coverage = 0;
+    uint64_t uploadedTiles = 0;
+    uint64_t evictedTiles = 0;
+
+    QueueScheduler scheduler;
+    StagingPool stagingPool;
+
+    std::thread loader;
+    std::mutex loaderMutex;
+    std::condition_variable loadAvailable;
+    std::deque<uint32_t> loadQueue;
+    std::vector<LoadedTile> loadedTiles;
+    bool loaderStopping = false;
+};
+
+// Reads a render target's virtual texture feedback back to the CPU: one host visible buffer per
+// swapchain image, copied from the feedback image by that image's commands and collected once
+// its frame has finished.
+class VirtualTextureFeedback {
+  public:
+    // Feedback images are the target's extent divided by VIRTUAL_TEXTURE_FEEDBACK_SCALE.
+    static VkExtent2D getExtent(VkExtent2D targetExtent);
+
+    void create(const VulkanDevice& vulkanDevice, uint32_t imageCount, VkExtent2D targetExtent);
+    void destroy();
+    // Follows a new target extent, reallocating the buffers only when they are too small. No
+    // readback may be in flight.
+    void resize(VkExtent2D targetExtent);
+
+    // Copies the feedback image, in TRANSFER_SRC_OPTIMAL, into the image's buffer and makes it
+    // visible to the host.
+    void recordReadback(VkCommandBuffer commandBuffer, VkImage feedback, uint32_t imageIndex) const;
+    // Appends what the image's last frame, which must have finished, sampled to the collected
+    // feedback.
+    void collect(uint32_t imageIndex);
+    // Everything collected since the last call, for VirtualTexture::addFeedback().
+    std::vector<uint32_t> take();
+
+  private:
+    void createBuffers(uint32_t imageCount);
+    void destroyBuffers();
+
+    const VulkanDevice* vulkanDevice = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+    VkExtent2D extent{};
+    // Bytes allocated per buffer, at least the extent's texels.
+    VkDeviceSize bufferSize = 0;
+
+    std::vector<VkBuffer> buffers;
+    std::vector<VkDeviceMemory> buffersMemory;
+    std::vector<uint32_t*> mappings;
+    std::vector<uint32_t> collected;
+};
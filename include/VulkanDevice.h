@@ -0,0 +1,132 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "DeviceCapabilities.h"
+#include "DeviceSelection.h"
+#include "SamplerCache.h"
+
+class VulkanInstance;
+
+// Queues work can be scheduled on. Compute and Transfer map to dedicated families when the device
+// has them and fall back to the graphics queue otherwise.
+enum class QueueType { Graphics, Compute, Transfer };
+
+// Video memory over every device local heap.
+struct MemoryBudget {
+    // How much this process can allocate without failing or being paged out.
+    VkDeviceSize budget = 0;
+    // Allocated by this process so far; zero without VK_EXT_memory_budget.
+    VkDeviceSize usage = 0;
+};
+
+// Physical and logical device with their queues, plus the allocation and one-time command
+// helpers used by everything that creates Vulkan resources. One VulkanDevice is shared by every
+// RenderTarget on the same GPU, together with its pipeline cache.
+class VulkanDevice {
+  public:
+    // Creates the logical device on the candidate's physical device, usually from
+    // selectPhysicalDevice, and keeps its capabilities. A null surface creates a headless device
+    // without a present queue or swapchain support.
+    void createDevice(const VulkanInstance& instance, const PhysicalDeviceCandidate& candidate,
+                      VkSurfaceKHR surface);
+    void destroy();
+
+    VkPhysicalDevice getPhysicalDevice() const { return physicalDevice; }
+    VkDevice getDevice() const { return device; }
+    const DeviceCapabilities& getCapabilities() const { return *capabilities; }
+    const VkPhysicalDeviceProperties& getProperties() const {
+        return capabilities->getProperties();
+    }
+    const VkPhysicalDeviceFeatures& getEnabledFeatures() const { return enabledFeatures; }
+    const QueueFamilyIndices& getQueueFamilies() const { return queueFamilies; }
+    VkQueue getGraphicsQueue() const { return getQueue(QueueType::Graphics); }
+    VkQueue getPresentQueue() const { return presentQueue; }
+    VkCommandPool getCommandPool() const { return getCommandPool(QueueType::Graphics); }
+    VkQueue getQueue(QueueType type) const { return queues[static_cast<size_t>(type)]; }
+    uint32_t getQueueFamily(QueueType type) const {
+        return queueFamilyIndices[static_cast<size_t>(type)];
+    }
+    // Command pools are shared between queue types of the same family.
+    VkCommandPool getCommandPool(QueueType type) const {
+        return commandPools[static_cast<size_t>(type)];
+    }
+    VkPipelineCache getPipelineCache() const { return pipelineCache; }
+    // Shared sampler for info from the device's sampler cache, destroyed with the device.
+    VkSampler getSampler(const VkSamplerCreateInfo& info) const {
+        return samplerCache.getSampler(info);
+    }
+    // Whether VK_EXT_memory_budget is enabled, which makes getMemoryBudget() track the driver.
+    bool hasMemoryBudget() const { return memoryBudgetEnabled; }
+    // Whether VK_KHR_dynamic_rendering is enabled, so render graphs can record their passes
+    // without render pass and framebuffer objects.
+    bool hasDynamicRendering() const { return dynamicRenderingEnabled; }
+
+    // Whether the present queue of this device can present to surface, which may belong to a
+    // different window than the one the device was picked for. Always false when headless.
+    bool supportsPresent(VkSurfaceKHR surface) const;
+
+    // Nanoseconds per timestamp tick, or 0 when graphics queues cannot write timestamps.
+    float getTimestampPeriod() const;
+    // Highest sample count not above requestedSamples usable for both colour and depth.
+    VkSampleCountFlagBits getMaxUsableSampleCount(uint32_t requestedSamples) const;
+
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+    // True on UMA devices and on discrete GPUs with resizable BAR, where host visible device
+    // local memory spans the largest device local heap and uploads can skip the staging copy.
+    bool hasMappableDeviceMemory() const;
+    // Current budget from VK_EXT_memory_budget, which changes as other processes allocate.
+    // Without it, a fixed share of the heap sizes.
+    MemoryBudget getMemoryBudget() const;
+    VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling,
+                                 VkFormatFeatureFlags features) const;
+    VkFormat findDepthFormat() const;
+    // Depth-only format that can be rendered to and sampled, for shadow maps.
+    VkFormat findShadowMapFormat() const;
+
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                      VkMemoryPropertyFlags properties, VkBuffer& buffer,
+                      VkDeviceMemory& bufferMemory) const;
+    void createImage(uint32_t width, uint32_t height, VkSampleCountFlagBits numSamples,
+                     VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
+                     VkMemoryPropertyFlags properties, VkImage& image,
+                     VkDeviceMemory& imageMemory) const;
+    VkImageView createImageView(VkImage image, VkFormat format,
+                                VkImageAspectFlags aspectFlags) const;
+
+    VkCommandBuffer beginSingleTimeCommands(QueueType type = QueueType::Graphics) const;
+    void endSingleTimeCommands(VkCommandBuffer commandBuffer,
+                               QueueType type = QueueType::Graphics) const;
+    void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) const;
+    void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) const;
+    void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout,
+                               VkImageLayout newLayout) const;
+
+  private:
+    void createLogicalDevice(const std::vector<const char*>& layers);
+    void createCommandPools();
+    void createPipelineCache();
+
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    std::shared_ptr<const DeviceCapabilities> capabilities;
+    VkPhysicalDeviceFeatures enabledFeatures{};
+    QueueFamilyIndices queueFamilies;
+    VkDevice device = VK_NULL_HANDLE;
+
+    // Indexed by QueueType.
+    std::array<uint32_t, 3> queueFamilyIndices{};
+    std::array<VkQueue, 3> queues{};
+    std::array<VkCommandPool, 3> commandPools{};
+    VkQueue presentQueue = VK_NULL_HANDLE;
+    bool memoryBudgetEnabled = false;
+    bool dynamicRenderingEnabled = false;
+
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    // Handing out a sampler does not change the device as its users see it.
+    mutable SamplerCache samplerCache;
+};
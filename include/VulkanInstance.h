@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+#include "ValidationFilter.h"
+
+// The Vulkan instance with its validation layers and debug messenger. One instance is shared by
+// every VulkanDevice in the process, so several GPUs can be opened side by side.
+class VulkanInstance {
+  public:
+    // extensions are the instance extensions required by the window system, empty when headless.
+    void create(const std::vector<const char*>& extensions);
+    void destroy();
+
+    VkInstance getHandle() const { return instance; }
+    // Layers that devices created from this instance enable for older loaders.
+    const std::vector<const char*>& getEnabledLayers() const { return enabledLayers; }
+
+    std::vector<VkPhysicalDevice> enumeratePhysicalDevices() const;
+
+  private:
+    void setupDebugMessenger();
+
+    VkInstance instance = VK_NULL_HANDLE;
+    VkDebugUtilsMessengerEXT debugMessenger = VK_NULL_HANDLE;
+    std::vector<const char*> enabledLayers;
+    // Shared by the debug messenger and the one chained to instance creation.
+    ValidationFilter validationFilter;
+};
@@ -1,13 +1,69 @@
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "Log.h"
 #include "VulkanApp.h"
-int main() {
-    HelloTriangleApplication app;
+
+int main(int argc, char** argv) {
+    AppOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--msaa" && i + 1 < argc) {
+            options.msaaSamples = static_cast<uint32_t>(std::atoi(argv[++i]));
+        } else if (arg == "--benchmark-msaa") {
+            options.benchmarkMsaa = true;
+        } else if (arg == "--views" && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+            options.views = static_cast<uint32_t>(std::atoi(argv[++i]));
+        } else if (arg == "--gpu" && i + 1 < argc) {
+            options.gpu = argv[++i];
+        } else if (arg == "--headless-jobs" && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+            options.headlessJobs = static_cast<uint32_t>(std::atoi(argv[++i]));
+        } else if (arg == "--cold-start") {
+            options.coldStart = true;
+        } else if (arg == "--startup-only") {
+            options.startupOnly = true;
+        } else if (arg == "--texture-budget" && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+            options.textureBudget = static_cast<uint32_t>(std::atoi(argv[++i]));
+        } else if (arg == "--dump-capabilities" && i + 1 < argc) {
+            options.capabilitiesPath = argv[++i];
+        } else if (arg == "--log" && i + 1 < argc) {
+            options.logLevels = argv[++i];
+        } else if (arg == "--overlay") {
+            options.overlay = true;
+        } else if (arg == "--capture" && i + 1 < argc) {
+            options.capturePath = argv[++i];
+        } else if (arg == "--dynamic-rendering") {
+            options.dynamicRendering = true;
+        } else {
+            std::cerr << "usage: " << argv[0]
+                      << " [--msaa <samples>] [--benchmark-msaa] [--views <count>]"
+                      << " [--gpu <index|uuid>] [--headless-jobs <count>]"
+                      << " [--cold-start] [--startup-only] [--texture-budget <MiB>]"
+                      << " [--dump-capabilities <path>] [--log <levels>] [--overlay]"
+                      << " [--capture <path>] [--dynamic-rendering]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
 
     try {
-        app.run();
+        initLogging(options.logLevels);
     } catch (const std::runtime_error& e) {
         std::cerr << e.what() << std::endl;
         return EXIT_FAILURE;
     }
 
+    HelloTriangleApplication app(options);
+
+    try {
+        app.run();
+    } catch (const std::runtime_error& e) {
+        LOG(App, Error, e.what());
+        shutdownLogging();
+        return EXIT_FAILURE;
+    }
+
+    shutdownLogging();
     return EXIT_SUCCESS;
 }
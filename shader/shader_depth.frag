@@ -1,12 +1,102 @@
 #version 450
 
-layout(binding = 1) uniform sampler2D texSampler;
+const int CASCADE_COUNT = 4;
+// Light reaching surfaces in shadow.
+const float AMBIENT = 0.35;
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    mat4 lightViewProj[CASCADE_COUNT];
+    vec4 cascadeSplits;
+    // Level 0 width and height, level count.
+    vec4 virtualTexture;
+    // Tile size, tile border, tile cache size.
+    vec4 virtualTextureTiles;
+} ubo;
+
+layout(binding = 1) uniform sampler2D tileCache;
+layout(binding = 2) uniform sampler2DArrayShadow shadowMap;
+// Per virtual texture page: the cache slot's x | y << 8 | the level it holds << 16.
+layout(std430, binding = 3) readonly buffer PageTable {
+    uint entries[];
+} pageTable;
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) in vec3 fragWorldPosition;
+layout(location = 3) in float fragViewDepth;
 
 layout(location = 0) out vec4 outColor;
 
+// Fraction of the light reaching the fragment, filtered over 3x3 texels of its cascade on top of
+// the sampler's bilinear comparison.
+float getLightVisibility() {
+    int cascade = 0;
+    for (int i = 0; i < CASCADE_COUNT - 1; i++) {
+        if (fragViewDepth > ubo.cascadeSplits[i]) {
+            cascade = i + 1;
+        }
+    }
+
+    vec4 shadowCoord = ubo.lightViewProj[cascade] * vec4(fragWorldPosition, 1.0);
+    vec3 coord = shadowCoord.xyz / shadowCoord.w;
+    coord.xy = coord.xy * 0.5 + 0.5;
+
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+    float visibility = 0.0;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            vec2 uv = coord.xy + vec2(x, y) * texelSize;
+            visibility += texture(shadowMap, vec4(uv, cascade, coord.z));
+        }
+    }
+    return visibility / 9.0;
+}
+
+vec2 getLevelSize(int level) {
+    return max(floor(ubo.virtualTexture.xy / exp2(level)), vec2(1.0));
+}
+
+// Samples one level of the virtual texture at uv in [0, 1), through the tile the page table
+// resolves it to: the level's own tile or the closest resident one above it.
+vec4 sampleVirtualLevel(vec2 uv, int level) {
+    float tileSize = ubo.virtualTextureTiles.x;
+    uint firstPage = 0;
+    for (int i = 0; i < level; i++) {
+        uvec2 pages = uvec2(ceil(getLevelSize(i) / tileSize));
+        firstPage += pages.x * pages.y;
+    }
+    uvec2 pages = uvec2(ceil(getLevelSize(level) / tileSize));
+    uvec2 page = uvec2(uv * getLevelSize(level) / tileSize);
+    uint entry = pageTable.entries[firstPage + page.y * pages.x + page.x];
+
+    vec2 texel = uv * getLevelSize(int((entry >> 16) & 0xff));
+    vec2 inTile = texel - floor(texel / tileSize) * tileSize;
+    vec2 slot = vec2(entry & 0xff, (entry >> 8) & 0xff);
+    float tileBorder = ubo.virtualTextureTiles.y;
+    vec2 cacheTexel = slot * (tileSize + 2.0 * tileBorder) + tileBorder + inTile;
+    return textureLod(tileCache, cacheTexel / ubo.virtualTextureTiles.z, 0.0);
+}
+
+// Trilinear filtering of the repeating virtual texture, blending the two levels around the
+// fragment's footprint.
+vec4 sampleVirtualTexture(vec2 uv) {
+    vec2 texels = uv * ubo.virtualTexture.xy;
+    float footprint = max(length(dFdx(texels)), length(dFdy(texels)));
+    float lod = clamp(log2(footprint), 0.0, ubo.virtualTexture.z - 1.0);
+    int level = int(lod);
+
+    vec2 wrapped = fract(uv);
+    vec4 color = sampleVirtualLevel(wrapped, level);
+    if (level + 1 < int(ubo.virtualTexture.z)) {
+        color = mix(color, sampleVirtualLevel(wrapped, level + 1), fract(lod));
+    }
+    return color;
+}
+
 void main() {
-    outColor = texture(texSampler, fragTexCoord);
+    vec4 color = sampleVirtualTexture(fragTexCoord);
+    outColor = vec4(color.rgb * mix(AMBIENT, 1.0, getLightVisibility()), color.a);
 }
\ No newline at end of file
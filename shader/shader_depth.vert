@@ -1,20 +1,31 @@
 #version 450
 
+const int CASCADE_COUNT = 4;
+
 layout(binding = 0) uniform UniformBufferObject {
     mat4 model;
     mat4 view;
     mat4 proj;
+    mat4 lightViewProj[CASCADE_COUNT];
+    vec4 cascadeSplits;
 } ubo;
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
+layout(location = 3) in mat4 inModel;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out vec3 fragWorldPosition;
+layout(location = 3) out float fragViewDepth;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    vec4 worldPosition = ubo.model * inModel * vec4(inPosition, 1.0);
+    vec4 viewPosition = ubo.view * worldPosition;
+    gl_Position = ubo.proj * viewPosition;
     fragColor = inColor;
     fragTexCoord = inTexCoord;
+    fragWorldPosition = worldPosition.xyz;
+    fragViewDepth = -viewPosition.z;
 }
\ No newline at end of file
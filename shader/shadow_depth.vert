@@ -0,0 +1,20 @@
+#version 450
+#extension GL_EXT_multiview : require
+
+const int CASCADE_COUNT = 4;
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    mat4 lightViewProj[CASCADE_COUNT];
+    vec4 cascadeSplits;
+} ubo;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 3) in mat4 inModel;
+
+// Each multiview view renders one cascade into its layer of the shadow map.
+void main() {
+    gl_Position = ubo.lightViewProj[gl_ViewIndex] * ubo.model * inModel * vec4(inPosition, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#version 450
+
+const int CASCADE_COUNT = 4;
+// The target is a quarter of the view's width and height, which makes every footprint four
+// times larger; the bias asks for the level the full resolution pass samples.
+const float LOD_BIAS = -2.0;
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    mat4 lightViewProj[CASCADE_COUNT];
+    vec4 cascadeSplits;
+    // Level 0 width and height, level count.
+    vec4 virtualTexture;
+    // Tile size, tile border, tile cache size.
+    vec4 virtualTextureTiles;
+} ubo;
+
+layout(location = 1) in vec2 fragTexCoord;
+
+// The finer of the levels shader_depth.frag blends: level << 24 | page y << 12 | page x.
+layout(location = 0) out uint outPage;
+
+void main() {
+    vec2 texels = fragTexCoord * ubo.virtualTexture.xy;
+    float footprint = max(length(dFdx(texels)), length(dFdy(texels)));
+    float lod = clamp(log2(footprint) + LOD_BIAS, 0.0, ubo.virtualTexture.z - 1.0);
+    int level = int(lod);
+
+    vec2 levelSize = max(floor(ubo.virtualTexture.xy / exp2(level)), vec2(1.0));
+    uvec2 page = uvec2(fract(fragTexCoord) * levelSize / ubo.virtualTextureTiles.x);
+    outPage = uint(level) << 24 | page.y << 12 | page.x;
+}
\ No newline at end of file
@@ -0,0 +1,356 @@
+#include "AssetPack.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#    define WIN32_LEAN_AND_MEAN
+#    define NOMINMAX
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+static uint64_t alignUp(uint64_t value) {
+    return (value + ASSET_PACK_ALIGNMENT - 1) & ~(ASSET_PACK_ALIGNMENT - 1);
+}
+
+static bool isPowerOfTwo(uint32_t value) {
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+// Levels a virtual texture needs to get down to one that fits a single tile.
+static uint32_t getVirtualLevelCount(uint32_t width, uint32_t height, uint32_t tileSize) {
+    uint32_t levelCount = 1;
+    while (getVirtualPageCount(width, tileSize, levelCount - 1) > 1
+           || getVirtualPageCount(height, tileSize, levelCount - 1) > 1) {
+        levelCount++;
+    }
+    return levelCount;
+}
+
+static uint32_t getVirtualTileCount(uint32_t width, uint32_t height, uint32_t tileSize,
+                                    uint32_t levelCount) {
+    uint32_t tileCount = 0;
+    for (uint32_t level = 0; level < levelCount; level++) {
+        tileCount += getVirtualPageCount(width, tileSize, level)
+                     * getVirtualPageCount(height, tileSize, level);
+    }
+    return tileCount;
+}
+
+uint32_t getVirtualPageCount(uint32_t size, uint32_t tileSize, uint32_t level) {
+    uint32_t levelSize = std::max(1u, size >> level);
+    return (levelSize + tileSize - 1) / tileSize;
+}
+
+uint64_t getVirtualTileStride(const AssetPackEntry& entry) {
+    uint64_t extent = entry.tileSize + 2 * uint64_t(entry.tileBorder);
+    return alignUp(extent * extent * 4);
+}
+
+void AssetPack::open(const std::string& path) {
+    close();
+
+#ifdef _WIN32
+    HANDLE fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("failed to open asset pack " + path + "!");
+    }
+    file = fileHandle;
+    LARGE_INTEGER fileSize{};
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+        close();
+        throw std::runtime_error("failed to read asset pack " + path + "!");
+    }
+    size = static_cast<size_t>(fileSize.QuadPart);
+
+    fileMapping = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (fileMapping != nullptr) {
+        mapping = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+    }
+    if (mapping == nullptr) {
+        close();
+        throw std::runtime_error("failed to map asset pack " + path + "!");
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("failed to open asset pack " + path + "!");
+    }
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size == 0) {
+        ::close(fd);
+        throw std::runtime_error("failed to read asset pack " + path + "!");
+    }
+    size = static_cast<size_t>(status.st_size);
+
+    // The mapping keeps its own reference to the file.
+    void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        size = 0;
+        throw std::runtime_error("failed to map asset pack " + path + "!");
+    }
+    mapping = address;
+    // Payloads are read once, front to back, while they are uploaded.
+    madvise(mapping, size, MADV_SEQUENTIAL);
+#endif
+
+    try {
+        validate();
+    } catch (...) {
+        close();
+        throw;
+    }
+
+    const auto* header = static_cast<const AssetPackHeader*>(mapping);
+    entries = reinterpret_cast<const AssetPackEntry*>(static_cast<const char*>(mapping)
+                                                      + header->tocOffset);
+    entryCount = header->entryCount;
+}
+
+void AssetPack::validate() const {
+    if (size < sizeof(AssetPackHeader)) {
+        throw std::runtime_error("asset pack is truncated!");
+    }
+    const auto* header = static_cast<const AssetPackHeader*>(mapping);
+    if (header->magic != ASSET_PACK_MAGIC || header->version != ASSET_PACK_VERSION) {
+        throw std::runtime_error("asset pack has an unsupported format!");
+    }
+    if (header->tocOffset % alignof(AssetPackEntry) != 0 || header->tocOffset > size
+        || (size - header->tocOffset) / sizeof(AssetPackEntry) < header->entryCount) {
+        throw std::runtime_error("asset pack table of contents is truncated!");
+    }
+
+    const auto* toc = reinterpret_cast<const AssetPackEntry*>(static_cast<const char*>(mapping)
+                                                              + header->tocOffset);
+    for (uint32_t i = 0; i < header->entryCount; i++) {
+        const AssetPackEntry& entry = toc[i];
+        bool valid = entry.offset % ASSET_PACK_ALIGNMENT == 0 && entry.offset <= header->tocOffset
+                     && entry.size <= header->tocOffset - entry.offset
+                     && memchr(entry.name, '\0', ASSET_NAME_SIZE) != nullptr;
+        if (entry.type == AssetType::Mesh) {
+            uint64_t lodIndices = 0;
+            for (uint32_t lod = 0; lod < entry.lodCount && lod < MAX_MESH_LODS; lod++) {
+                lodIndices += entry.lodIndexCounts[lod];
+            }
+            valid = valid && entry.lodCount > 0 && entry.lodCount <= MAX_MESH_LODS
+                    && lodIndices == entry.indexCount
+                    && entry.indexOffset % sizeof(uint16_t) == 0
+                    && entry.positionOffset % sizeof(float) == 0
+                    && uint64_t(entry.vertexStride) * entry.vertexCount <= entry.positionOffset
+                    && entry.positionOffset <= entry.indexOffset
+                    && uint64_t(entry.vertexCount) * 3 * sizeof(float)
+                           <= entry.indexOffset - entry.positionOffset
+                    && entry.indexOffset <= entry.size
+                    && uint64_t(entry.indexCount) * sizeof(uint16_t)
+                           <= entry.size - entry.indexOffset;
+        } else if (entry.type == AssetType::Texture) {
+            valid = valid && uint64_t(entry.width) * entry.height * 4 <= entry.size;
+        } else if (entry.type == AssetType::VirtualTexture) {
+            // Level counts are checked before they are used to count the tiles.
+            valid = valid && isPowerOfTwo(entry.width) && isPowerOfTwo(entry.height)
+                    && isPowerOfTwo(entry.tileSize) && entry.tileBorder <= entry.tileSize
+                    && entry.levelCount
+                           == getVirtualLevelCount(entry.width, entry.height, entry.tileSize)
+                    && entry.tileCount
+                           == getVirtualTileCount(entry.width, entry.height, entry.tileSize,
+                                                  entry.levelCount)
+                    && entry.tileCount <= entry.size / getVirtualTileStride(entry);
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            throw std::runtime_error("asset pack entry is out of range!");
+        }
+    }
+}
+
+void AssetPack::close() {
+#ifdef _WIN32
+    if (mapping != nullptr) {
+        UnmapViewOfFile(mapping);
+    }
+    if (fileMapping != nullptr) {
+        CloseHandle(fileMapping);
+    }
+    if (file != nullptr) {
+        CloseHandle(file);
+    }
+    file = nullptr;
+    fileMapping = nullptr;
+#else
+    if (mapping != nullptr) {
+        munmap(mapping, size);
+    }
+#endif
+    mapping = nullptr;
+    size = 0;
+    entries = nullptr;
+    entryCount = 0;
+}
+
+void AssetPack::evictFromPageCache(const std::string& path) {
+#if defined(POSIX_FADV_DONTNEED)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+    }
+#endif
+}
+
+void AssetPack::adviseRandomAccess(const AssetPackEntry& entry) const {
+#ifndef _WIN32
+    // madvise takes whole pages.
+    uintptr_t pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t start = reinterpret_cast<uintptr_t>(getPayload(entry)) & ~(pageSize - 1);
+    uintptr_t end = reinterpret_cast<uintptr_t>(getPayload(entry)) + entry.size;
+    madvise(reinterpret_cast<void*>(start), end - start, MADV_RANDOM);
+#endif
+}
+
+const AssetPackEntry* AssetPack::find(const char* name, AssetType type) const {
+    for (uint32_t i = 0; i < entryCount; i++) {
+        const AssetPackEntry& entry = entries[i];
+        if (entry.type == type && strcmp(entry.name, name) == 0) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+void AssetPackWriter::addMesh(const std::string& name, const void* vertices,
+                              uint32_t vertexStride, uint32_t vertexCount, const float* positions,
+                              const uint16_t* indices, const uint32_t* lodIndexCounts,
+                              uint32_t lodCount, const float boundingSphere[4]) {
+    if (lodCount == 0 || lodCount > MAX_MESH_LODS) {
+        throw std::runtime_error("mesh " + name + " has an unsupported number of LODs!");
+    }
+
+    AssetPackEntry& entry = addEntry(name, AssetType::Mesh);
+    entry.vertexStride = vertexStride;
+    entry.vertexCount = vertexCount;
+    entry.lodCount = lodCount;
+    uint32_t indexCount = 0;
+    for (uint32_t lod = 0; lod < lodCount; lod++) {
+        entry.lodIndexCounts[lod] = lodIndexCounts[lod];
+        indexCount += lodIndexCounts[lod];
+    }
+    entry.indexCount = indexCount;
+    memcpy(entry.boundingSphere, boundingSphere, sizeof(entry.boundingSphere));
+
+    entry.offset = appendPayload(vertices, size_t(vertexStride) * vertexCount);
+    entry.positionOffset
+        = appendPayload(positions, 3 * sizeof(float) * vertexCount) - entry.offset;
+    uint64_t indexStart = appendPayload(indices, sizeof(uint16_t) * indexCount);
+    entry.indexOffset = indexStart - entry.offset;
+    entry.size = entry.indexOffset + sizeof(uint16_t) * indexCount;
+}
+
+void AssetPackWriter::addTexture(const std::string& name, VkFormat format, uint32_t width,
+                                 uint32_t height, const void* pixels) {
+    AssetPackEntry& entry = addEntry(name, AssetType::Texture);
+    entry.format = format;
+    entry.width = width;
+    entry.height = height;
+    entry.size = uint64_t(width) * height * 4;
+    entry.offset = appendPayload(pixels, static_cast<size_t>(entry.size));
+}
+
+// Each tile's border repeats the texels across the level's edges, matching a repeating sampler.
+void AssetPackWriter::addVirtualTexture(const std::string& name, VkFormat format, uint32_t width,
+                                        uint32_t height, uint32_t tileSize, uint32_t tileBorder,
+                                        const std::vector<const uint32_t*>& levels) {
+    if (!isPowerOfTwo(width) || !isPowerOfTwo(height)) {
+        throw std::runtime_error("virtual texture " + name + " is not a power of two!");
+    }
+    if (!isPowerOfTwo(tileSize) || tileBorder > tileSize
+        || levels.size() != getVirtualLevelCount(width, height, tileSize)) {
+        throw std::runtime_error("virtual texture " + name + " has the wrong number of levels!");
+    }
+
+    AssetPackEntry& entry = addEntry(name, AssetType::VirtualTexture);
+    entry.format = format;
+    entry.width = width;
+    entry.height = height;
+    entry.tileSize = tileSize;
+    entry.tileBorder = tileBorder;
+    entry.levelCount = static_cast<uint32_t>(levels.size());
+    entry.tileCount = getVirtualTileCount(width, height, tileSize, entry.levelCount);
+
+    uint32_t extent = tileSize + 2 * tileBorder;
+    std::vector<uint32_t> tile(size_t(extent) * extent);
+    for (uint32_t level = 0; level < entry.levelCount; level++) {
+        uint32_t levelWidth = std::max(1u, width >> level);
+        uint32_t levelHeight = std::max(1u, height >> level);
+        for (uint32_t pageY = 0; pageY < getVirtualPageCount(height, tileSize, level); pageY++) {
+            for (uint32_t pageX = 0; pageX < getVirtualPageCount(width, tileSize, level);
+                 pageX++) {
+                for (uint32_t y = 0; y < extent; y++) {
+                    int64_t sourceY = int64_t(pageY) * tileSize + y - tileBorder;
+                    sourceY = (sourceY % levelHeight + levelHeight) % levelHeight;
+                    for (uint32_t x = 0; x < extent; x++) {
+                        int64_t sourceX = int64_t(pageX) * tileSize + x - tileBorder;
+                        sourceX = (sourceX % levelWidth + levelWidth) % levelWidth;
+                        tile[size_t(y) * extent + x]
+                            = levels[level][sourceY * levelWidth + sourceX];
+                    }
+                }
+
+                uint64_t offset = appendPayload(tile.data(), sizeof(uint32_t) * tile.size());
+                if (level == 0 && pageY == 0 && pageX == 0) {
+                    entry.offset = offset;
+                }
+            }
+        }
+    }
+    entry.size = getVirtualTileStride(entry) * entry.tileCount;
+}
+
+AssetPackEntry& AssetPackWriter::addEntry(const std::string& name, AssetType type) {
+    if (name.size() >= ASSET_NAME_SIZE) {
+        throw std::runtime_error("asset name " + name + " is too long!");
+    }
+
+    AssetPackEntry entry;
+    memcpy(entry.name, name.c_str(), name.size());
+    entry.type = type;
+    entries.push_back(entry);
+    return entries.back();
+}
+
+// Returns the payload's file offset.
+uint64_t AssetPackWriter::appendPayload(const void* data, size_t dataSize) {
+    uint64_t offset = alignUp(sizeof(AssetPackHeader) + payloads.size());
+    payloads.resize(static_cast<size_t>(offset - sizeof(AssetPackHeader)));
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    payloads.insert(payloads.end(), bytes, bytes + dataSize);
+    return offset;
+}
+
+void AssetPackWriter::write(const std::string& path) const {
+    AssetPackHeader header;
+    header.entryCount = static_cast<uint32_t>(entries.size());
+    header.tocOffset = alignUp(sizeof(AssetPackHeader) + payloads.size());
+
+    std::vector<char> padding(
+        static_cast<size_t>(header.tocOffset - sizeof(AssetPackHeader) - payloads.size()));
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(payloads.data()), payloads.size());
+    file.write(padding.data(), padding.size());
+    file.write(reinterpret_cast<const char*>(entries.data()),
+               entries.size() * sizeof(AssetPackEntry));
+    if (!file) {
+        throw std::runtime_error("failed to write asset pack " + path + "!");
+    }
+}
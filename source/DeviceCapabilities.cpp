@@ -0,0 +1,278 @@
+#include "DeviceCapabilities.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+// Formats up to VK_FORMAT_ASTC_12x12_SRGB_BLOCK are core Vulkan 1.0 and numbered contiguously.
+static const uint32_t CORE_FORMAT_COUNT = 185;
+// Memory property flag combinations with a precomputed type mask: every flag up to
+// VK_MEMORY_PROPERTY_RDMA_CAPABLE_BIT_NV.
+static const uint32_t MEMORY_PROPERTY_COMBINATIONS = 1 << 9;
+
+static std::string toJsonString(const char* text) {
+    std::string quoted = "\"";
+    for (const char* c = text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            quoted += '\\';
+            quoted += *c;
+        } else if (static_cast<unsigned char>(*c) < 0x20) {
+            char escaped[7];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", *c);
+            quoted += escaped;
+        } else {
+            quoted += *c;
+        }
+    }
+    return quoted + "\"";
+}
+
+static std::string formatVersion(uint32_t version) {
+    return std::to_string(VK_VERSION_MAJOR(version)) + "."
+           + std::to_string(VK_VERSION_MINOR(version)) + "."
+           + std::to_string(VK_VERSION_PATCH(version));
+}
+
+std::vector<const char*> getDynamicRenderingExtensions() {
+    return {VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME, VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME,
+            VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME};
+}
+
+void DeviceCapabilities::query(VkPhysicalDevice physicalDevice) {
+    this->physicalDevice = physicalDevice;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+
+    // The device UUID and multiview are core from Vulkan 1.1 on.
+    if (properties.apiVersion >= VK_API_VERSION_1_1) {
+        VkPhysicalDeviceIDProperties idProperties{};
+        idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+        VkPhysicalDeviceProperties2 properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &idProperties;
+        vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+        std::copy(std::begin(idProperties.deviceUUID), std::end(idProperties.deviceUUID),
+                  uuid.begin());
+
+        VkPhysicalDeviceMultiviewFeatures multiviewFeatures{};
+        multiviewFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES;
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &multiviewFeatures;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+        multiview = multiviewFeatures.multiview == VK_TRUE;
+    }
+
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    memoryTypeMasks.assign(MEMORY_PROPERTY_COMBINATIONS, 0);
+    for (uint32_t flags = 0; flags < MEMORY_PROPERTY_COMBINATIONS; flags++) {
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+            if ((memoryProperties.memoryTypes[i].propertyFlags & flags) == flags) {
+                memoryTypeMasks[flags] |= 1u << i;
+            }
+        }
+    }
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    queueFamilies.resize(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount,
+                                             queueFamilies.data());
+
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+    extensions.resize(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount,
+                                         extensions.data());
+    extensionNames.clear();
+    for (const VkExtensionProperties& extension : extensions) {
+        extensionNames.insert(extension.extensionName);
+    }
+
+    dynamicRendering = false;
+    if (properties.apiVersion >= VK_API_VERSION_1_1
+        && hasExtensions(getDynamicRenderingExtensions())) {
+        VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+        dynamicRenderingFeatures.sType
+            = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &dynamicRenderingFeatures;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+        dynamicRendering = dynamicRenderingFeatures.dynamicRendering == VK_TRUE;
+    }
+
+    formatProperties.resize(CORE_FORMAT_COUNT);
+    for (uint32_t format = 0; format < CORE_FORMAT_COUNT; format++) {
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, static_cast<VkFormat>(format),
+                                            &formatProperties[format]);
+    }
+}
+
+bool DeviceCapabilities::hasExtension(const std::string& name) const {
+    return extensionNames.count(name) > 0;
+}
+
+bool DeviceCapabilities::hasExtensions(const std::vector<const char*>& names) const {
+    for (const char* name : names) {
+        if (!hasExtension(name)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t DeviceCapabilities::getMemoryTypeMask(VkMemoryPropertyFlags properties) const {
+    if (properties < MEMORY_PROPERTY_COMBINATIONS) {
+        return memoryTypeMasks[properties];
+    }
+
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        if ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+}
+
+uint32_t DeviceCapabilities::findMemoryType(uint32_t typeFilter,
+                                            VkMemoryPropertyFlags properties) const {
+    uint32_t candidates = typeFilter & getMemoryTypeMask(properties);
+    if (candidates == 0) {
+        return NO_MEMORY_TYPE;
+    }
+
+    uint32_t index = 0;
+    while (!(candidates & (1u << index))) {
+        index++;
+    }
+    return index;
+}
+
+VkFormatProperties DeviceCapabilities::getFormatProperties(VkFormat format) const {
+    if (static_cast<uint32_t>(format) < formatProperties.size()) {
+        return formatProperties[format];
+    }
+
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+    return props;
+}
+
+std::string DeviceCapabilities::toJson() const {
+    const VkPhysicalDeviceLimits& limits = properties.limits;
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"deviceName\": " << toJsonString(properties.deviceName) << ",\n";
+    json << "  \"vendorID\": " << properties.vendorID << ",\n";
+    json << "  \"deviceID\": " << properties.deviceID << ",\n";
+    json << "  \"deviceType\": " << properties.deviceType << ",\n";
+    json << "  \"apiVersion\": \"" << formatVersion(properties.apiVersion) << "\",\n";
+    json << "  \"driverVersion\": " << properties.driverVersion << ",\n";
+
+    json << "  \"uuid\": \"";
+    for (uint8_t byte : uuid) {
+        char digits[3];
+        std::snprintf(digits, sizeof(digits), "%02x", byte);
+        json << digits;
+    }
+    json << "\",\n";
+
+    json << "  \"limits\": {\n"
+         << "    \"maxImageDimension2D\": " << limits.maxImageDimension2D << ",\n"
+         << "    \"maxImageArrayLayers\": " << limits.maxImageArrayLayers << ",\n"
+         << "    \"maxStorageBufferRange\": " << limits.maxStorageBufferRange << ",\n"
+         << "    \"maxPushConstantsSize\": " << limits.maxPushConstantsSize << ",\n"
+         << "    \"maxMemoryAllocationCount\": " << limits.maxMemoryAllocationCount << ",\n"
+         << "    \"maxSamplerAllocationCount\": " << limits.maxSamplerAllocationCount << ",\n"
+         << "    \"bufferImageGranularity\": " << limits.bufferImageGranularity << ",\n"
+         << "    \"maxBoundDescriptorSets\": " << limits.maxBoundDescriptorSets << ",\n"
+         << "    \"maxComputeWorkGroupInvocations\": " << limits.maxComputeWorkGroupInvocations
+         << ",\n"
+         << "    \"maxDrawIndirectCount\": " << limits.maxDrawIndirectCount << ",\n"
+         << "    \"maxSamplerAnisotropy\": " << limits.maxSamplerAnisotropy << ",\n"
+         << "    \"minUniformBufferOffsetAlignment\": " << limits.minUniformBufferOffsetAlignment
+         << ",\n"
+         << "    \"minStorageBufferOffsetAlignment\": " << limits.minStorageBufferOffsetAlignment
+         << ",\n"
+         << "    \"framebufferColorSampleCounts\": " << limits.framebufferColorSampleCounts
+         << ",\n"
+         << "    \"framebufferDepthSampleCounts\": " << limits.framebufferDepthSampleCounts
+         << ",\n"
+         << "    \"timestampComputeAndGraphics\": " << limits.timestampComputeAndGraphics
+         << ",\n"
+         << "    \"timestampPeriod\": " << limits.timestampPeriod << ",\n"
+         << "    \"nonCoherentAtomSize\": " << limits.nonCoherentAtomSize << "\n"
+         << "  },\n";
+
+    json << "  \"features\": {\n"
+         << "    \"samplerAnisotropy\": " << features.samplerAnisotropy << ",\n"
+         << "    \"multiDrawIndirect\": " << features.multiDrawIndirect << ",\n"
+         << "    \"drawIndirectFirstInstance\": " << features.drawIndirectFirstInstance << ",\n"
+         << "    \"depthClamp\": " << features.depthClamp << ",\n"
+         << "    \"multiview\": " << (multiview ? 1 : 0) << ",\n"
+         << "    \"dynamicRendering\": " << (dynamicRendering ? 1 : 0) << "\n"
+         << "  },\n";
+
+    json << "  \"memoryHeaps\": [";
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+        json << (i == 0 ? "\n" : ",\n") << "    {\"size\": "
+             << memoryProperties.memoryHeaps[i].size
+             << ", \"flags\": " << memoryProperties.memoryHeaps[i].flags << "}";
+    }
+    json << "\n  ],\n";
+
+    json << "  \"memoryTypes\": [";
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        json << (i == 0 ? "\n" : ",\n") << "    {\"heap\": "
+             << memoryProperties.memoryTypes[i].heapIndex
+             << ", \"flags\": " << memoryProperties.memoryTypes[i].propertyFlags << "}";
+    }
+    json << "\n  ],\n";
+
+    json << "  \"queueFamilies\": [";
+    for (size_t i = 0; i < queueFamilies.size(); i++) {
+        json << (i == 0 ? "\n" : ",\n") << "    {\"flags\": " << queueFamilies[i].queueFlags
+             << ", \"count\": " << queueFamilies[i].queueCount
+             << ", \"timestampValidBits\": " << queueFamilies[i].timestampValidBits << "}";
+    }
+    json << "\n  ],\n";
+
+    json << "  \"extensions\": {";
+    for (size_t i = 0; i < extensions.size(); i++) {
+        json << (i == 0 ? "\n" : ",\n") << "    " << toJsonString(extensions[i].extensionName)
+             << ": " << extensions[i].specVersion;
+    }
+    json << "\n  },\n";
+
+    // Only formats with any support, keyed by their VkFormat value.
+    json << "  \"formats\": {";
+    bool first = true;
+    for (uint32_t format = 0; format < formatProperties.size(); format++) {
+        const VkFormatProperties& props = formatProperties[format];
+        if (props.linearTilingFeatures == 0 && props.optimalTilingFeatures == 0
+            && props.bufferFeatures == 0) {
+            continue;
+        }
+        json << (first ? "\n" : ",\n") << "    \"" << format << "\": {\"linear\": "
+             << props.linearTilingFeatures << ", \"optimal\": " << props.optimalTilingFeatures
+             << ", \"buffer\": " << props.bufferFeatures << "}";
+        first = false;
+    }
+    json << "\n  }\n";
+
+    json << "}\n";
+    return json.str();
+}
+
+void DeviceCapabilities::writeJson(const std::string& path) const {
+    std::ofstream file(path, std::ios::trunc);
+    file << toJson();
+    if (!file) {
+        throw std::runtime_error("failed to write device capabilities " + path + "!");
+    }
+}
@@ -0,0 +1,111 @@
+#include "DeviceGroup.h"
+
+#include <stdexcept>
+
+#include "DeviceSelection.h"
+#include "Log.h"
+#include "VulkanInstance.h"
+
+DeviceGroup::~DeviceGroup() { destroy(); }
+
+void DeviceGroup::create(const VulkanInstance& instance) {
+    std::vector<PhysicalDeviceCandidate> candidates
+        = rankPhysicalDevices(instance, VK_NULL_HANDLE);
+    printDeviceRanking(candidates);
+
+    for (const PhysicalDeviceCandidate& candidate : candidates) {
+        if (!candidate.suitable) {
+            continue;
+        }
+
+        auto device = std::make_unique<VulkanDevice>();
+        device->createDevice(instance, candidate, VK_NULL_HANDLE);
+        devices.push_back(std::move(device));
+    }
+
+    if (devices.empty()) {
+        throw std::runtime_error("failed to find a suitable GPU!");
+    }
+    LOG(Device, Info, "device group: " << devices.size() << " gpus");
+
+    stopping = false;
+    completedJobs.assign(devices.size(), 0);
+    for (uint32_t i = 0; i < devices.size(); i++) {
+        workers.emplace_back(&DeviceGroup::work, this, i);
+    }
+}
+
+void DeviceGroup::destroy() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        jobsFinished.wait(lock, [this] { return jobs.empty() && runningJobs == 0; });
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+
+    for (auto& device : devices) {
+        device->destroy();
+    }
+    devices.clear();
+}
+
+void DeviceGroup::submit(Job job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    jobAvailable.notify_one();
+}
+
+void DeviceGroup::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    jobsFinished.wait(lock, [this] { return jobs.empty() && runningJobs == 0; });
+
+    if (firstError) {
+        std::exception_ptr error = firstError;
+        firstError = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+std::vector<uint32_t> DeviceGroup::getCompletedJobs() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return completedJobs;
+}
+
+void DeviceGroup::work(uint32_t deviceIndex) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if (jobs.empty()) {
+            return;
+        }
+
+        Job job = std::move(jobs.front());
+        jobs.pop_front();
+        runningJobs++;
+
+        lock.unlock();
+        std::exception_ptr error;
+        try {
+            job(*devices[deviceIndex], deviceIndex);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        lock.lock();
+
+        if (error && !firstError) {
+            firstError = error;
+        }
+        completedJobs[deviceIndex]++;
+        runningJobs--;
+        if (jobs.empty() && runningJobs == 0) {
+            jobsFinished.notify_all();
+        }
+    }
+}
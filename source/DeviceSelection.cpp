@@ -0,0 +1,246 @@
+#include "DeviceSelection.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "Log.h"
+#include "Swapchain.h"
+#include "VulkanInstance.h"
+
+QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface) {
+    QueueFamilyIndices indices;
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+
+    uint32_t i = 0;
+    for (const auto& queueFamily : queueFamilies) {
+        VkQueueFlags flags = queueFamily.queueFlags;
+        if ((flags & VK_QUEUE_GRAPHICS_BIT) && !indices.graphicsFamily.has_value()) {
+            indices.graphicsFamily = i;
+        }
+
+        // Async families lack graphics (and for copies compute) support, so their work runs
+        // beside the graphics queue instead of time slicing with it.
+        if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)
+            && !indices.computeFamily.has_value()) {
+            indices.computeFamily = i;
+        }
+        if ((flags & VK_QUEUE_TRANSFER_BIT)
+            && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))
+            && !indices.transferFamily.has_value()) {
+            indices.transferFamily = i;
+        }
+
+        if (surface != VK_NULL_HANDLE && !indices.presentFamily.has_value()) {
+            VkBool32 presentSupport = false;
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+
+            if (presentSupport) {
+                indices.presentFamily = i;
+            }
+        }
+
+        i++;
+    }
+
+    return indices;
+}
+
+std::vector<const char*> getRequiredDeviceExtensions(bool presentation) {
+    if (presentation) {
+        return {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    }
+
+    return {};
+}
+
+static bool isDeviceSuitable(const DeviceCapabilities& capabilities, VkSurfaceKHR surface) {
+    VkPhysicalDevice device = capabilities.getPhysicalDevice();
+    bool presentation = surface != VK_NULL_HANDLE;
+    QueueFamilyIndices indices = findQueueFamilies(device, surface);
+
+    bool extensionsSupported
+        = capabilities.hasExtensions(getRequiredDeviceExtensions(presentation));
+
+    bool swapChainAdequate = !presentation;
+    if (presentation && extensionsSupported) {
+        SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device, surface);
+        swapChainAdequate
+            = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
+    }
+
+    // Multiview renders every shadow cascade in one pass.
+    bool queuesFound = presentation ? indices.isComplete() : indices.graphicsFamily.has_value();
+    return queuesFound && extensionsSupported && swapChainAdequate
+           && capabilities.getFeatures().samplerAnisotropy && capabilities.supportsMultiview();
+}
+
+static uint64_t getDeviceTypeScore(VkPhysicalDeviceType type) {
+    switch (type) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+            return 4;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+            return 3;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+            return 2;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static const char* getDeviceTypeName(VkPhysicalDeviceType type) {
+    switch (type) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+            return "discrete";
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+            return "integrated";
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+            return "virtual";
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:
+            return "cpu";
+        default:
+            return "other";
+    }
+}
+
+static PhysicalDeviceCandidate describePhysicalDevice(VkPhysicalDevice device, uint32_t index,
+                                                      VkSurfaceKHR surface) {
+    PhysicalDeviceCandidate candidate;
+    candidate.physicalDevice = device;
+    candidate.index = index;
+    auto capabilities = std::make_shared<DeviceCapabilities>();
+    capabilities->query(device);
+    candidate.capabilities = capabilities;
+    candidate.properties = capabilities->getProperties();
+    candidate.uuid = capabilities->getUuid();
+
+    const VkPhysicalDeviceMemoryProperties& memProperties = capabilities->getMemoryProperties();
+    for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++) {
+        if (memProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            candidate.localMemory
+                = std::max(candidate.localMemory, memProperties.memoryHeaps[i].size);
+        }
+    }
+
+    QueueFamilyIndices indices = findQueueFamilies(device, VK_NULL_HANDLE);
+    candidate.dedicatedCompute = indices.computeFamily.has_value();
+    candidate.dedicatedTransfer = indices.transferFamily.has_value();
+
+    candidate.suitable = isDeviceSuitable(*capabilities, surface);
+
+    // Type dominates, then local memory in MiB; the queue bits only break ties.
+    uint64_t localMemoryMiB = std::min<uint64_t>(candidate.localMemory >> 20, (1ull << 40) - 1);
+    candidate.score = getDeviceTypeScore(candidate.properties.deviceType) << 56
+                      | localMemoryMiB << 8 | uint64_t(candidate.dedicatedCompute) << 1
+                      | uint64_t(candidate.dedicatedTransfer);
+
+    return candidate;
+}
+
+std::vector<PhysicalDeviceCandidate> rankPhysicalDevices(const VulkanInstance& instance,
+                                                         VkSurfaceKHR surface) {
+    std::vector<VkPhysicalDevice> devices = instance.enumeratePhysicalDevices();
+
+    std::vector<PhysicalDeviceCandidate> candidates;
+    for (uint32_t i = 0; i < devices.size(); i++) {
+        candidates.push_back(describePhysicalDevice(devices[i], i, surface));
+    }
+
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const PhysicalDeviceCandidate& a, const PhysicalDeviceCandidate& b) {
+                         if (a.suitable != b.suitable) {
+                             return a.suitable;
+                         }
+                         return a.score > b.score;
+                     });
+
+    return candidates;
+}
+
+std::string formatDeviceUuid(const std::array<uint8_t, VK_UUID_SIZE>& uuid) {
+    std::string text;
+    for (size_t i = 0; i < uuid.size(); i++) {
+        if (i == 4 || i == 6 || i == 8 || i == 10) {
+            text += '-';
+        }
+        char digits[3];
+        std::snprintf(digits, sizeof(digits), "%02x", uuid[i]);
+        text += digits;
+    }
+
+    return text;
+}
+
+static bool matchesSelection(const PhysicalDeviceCandidate& candidate,
+                             const std::string& selection) {
+    if (std::all_of(selection.begin(), selection.end(),
+                    [](unsigned char c) { return std::isdigit(c); })) {
+        return std::strtoul(selection.c_str(), nullptr, 10) == candidate.index;
+    }
+
+    std::string wanted;
+    for (char c : selection) {
+        if (c != '-') {
+            wanted += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+    }
+    std::string uuid = formatDeviceUuid(candidate.uuid);
+    uuid.erase(std::remove(uuid.begin(), uuid.end(), '-'), uuid.end());
+
+    return wanted == uuid;
+}
+
+void printDeviceRanking(const std::vector<PhysicalDeviceCandidate>& candidates) {
+    for (const PhysicalDeviceCandidate& candidate : candidates) {
+        LOG(Device, Info,
+            "gpu " << candidate.index << ": " << candidate.properties.deviceName << " ["
+                   << getDeviceTypeName(candidate.properties.deviceType) << ", "
+                   << candidate.localMemory / (1024 * 1024) << " MiB local"
+                   << (candidate.dedicatedCompute ? ", compute queue" : "")
+                   << (candidate.dedicatedTransfer ? ", transfer queue" : "") << "] uuid "
+                   << formatDeviceUuid(candidate.uuid)
+                   << (candidate.suitable ? "" : " (unsuitable)"));
+    }
+}
+
+PhysicalDeviceCandidate selectPhysicalDevice(const VulkanInstance& instance, VkSurfaceKHR surface,
+                                             const std::string& selection) {
+    std::vector<PhysicalDeviceCandidate> candidates = rankPhysicalDevices(instance, surface);
+    printDeviceRanking(candidates);
+
+    std::string deviceOverride = selection;
+    if (deviceOverride.empty()) {
+        const char* environment = std::getenv("VULKANLEARN_GPU");
+        deviceOverride = environment != nullptr ? environment : "";
+    }
+
+    if (deviceOverride.empty()) {
+        if (!candidates.front().suitable) {
+            throw std::runtime_error("failed to find a suitable GPU!");
+        }
+        LOG(Device, Info, "selected gpu " << candidates.front().index);
+        return candidates.front();
+    }
+
+    for (const PhysicalDeviceCandidate& candidate : candidates) {
+        if (matchesSelection(candidate, deviceOverride)) {
+            if (!candidate.suitable) {
+                throw std::runtime_error("selected GPU " + deviceOverride + " is not suitable!");
+            }
+            LOG(Device, Info,
+                "selected gpu " << candidate.index << " (override " << deviceOverride << ")");
+            return candidate;
+        }
+    }
+
+    throw std::runtime_error("failed to find GPU " + deviceOverride + "!");
+}
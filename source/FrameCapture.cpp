@@ -0,0 +1,205 @@
+#include "FrameCapture.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "AssetPack.h"
+
+static const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+static const uint64_t FNV_PRIME = 0x100000001b3ull;
+
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+void hashAssetPack(const std::string& path, uint64_t& size, uint64_t& hash) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        throw std::runtime_error("failed to open asset pack " + path + "!");
+    }
+    size = static_cast<uint64_t>(file.tellg());
+
+    // Entries record each payload's position, size and layout, so they cover every payload.
+    AssetPackHeader header;
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    std::vector<AssetPackEntry> entries(file ? header.entryCount : 0);
+    file.seekg(static_cast<std::streamoff>(header.tocOffset));
+    file.read(reinterpret_cast<char*>(entries.data()), entries.size() * sizeof(AssetPackEntry));
+    if (!file) {
+        throw std::runtime_error("failed to read asset pack " + path + "!");
+    }
+
+    hash = hashBytes(FNV_OFFSET_BASIS, &header, sizeof(header));
+    hash = hashBytes(hash, entries.data(), entries.size() * sizeof(AssetPackEntry));
+}
+
+CaptureOptions toCaptureOptions(const RenderTargetOptions& options) {
+    CaptureOptions captured;
+    captured.msaaSamples = options.msaaSamples;
+    captured.presentMode = static_cast<uint32_t>(options.presentMode);
+    captured.framesInFlight = options.framesInFlight;
+    captured.dynamicRendering = options.dynamicRendering ? 1 : 0;
+    return captured;
+}
+
+RenderTargetOptions fromCaptureOptions(const CaptureOptions& options) {
+    RenderTargetOptions targetOptions;
+    targetOptions.msaaSamples = options.msaaSamples;
+    targetOptions.presentMode = static_cast<VkPresentModeKHR>(options.presentMode);
+    targetOptions.framesInFlight = options.framesInFlight;
+    targetOptions.dynamicRendering = options.dynamicRendering != 0;
+    return targetOptions;
+}
+
+void FrameCaptureWriter::open(const std::string& path, const CaptureSession& session) {
+    this->path = path;
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("failed to create frame capture " + path + "!");
+    }
+
+    FrameCaptureHeader header;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writeRecordHeader(CaptureRecordType::Session, sizeof(session));
+    file.write(reinterpret_cast<const char*>(&session), sizeof(session));
+}
+
+void FrameCaptureWriter::close() {
+    if (!file.is_open()) {
+        return;
+    }
+
+    file.close();
+    if (!file) {
+        throw std::runtime_error("failed to write frame capture " + path + "!");
+    }
+}
+
+void FrameCaptureWriter::writeOptions(const RenderTargetOptions& options) {
+    CaptureOptions captured = toCaptureOptions(options);
+    writeRecordHeader(CaptureRecordType::Options, sizeof(captured));
+    file.write(reinterpret_cast<const char*>(&captured), sizeof(captured));
+}
+
+void FrameCaptureWriter::writeResize(VkExtent2D extent) {
+    writeRecordHeader(CaptureRecordType::Resize, sizeof(extent));
+    file.write(reinterpret_cast<const char*>(&extent), sizeof(extent));
+}
+
+void FrameCaptureWriter::writeFrame(const CaptureFrame& frame,
+                                    const std::vector<uint32_t>& feedback) {
+    CaptureFrame captured = frame;
+    captured.feedbackCount = static_cast<uint32_t>(feedback.size());
+    writeRecordHeader(CaptureRecordType::Frame,
+                      sizeof(captured) + feedback.size() * sizeof(uint32_t));
+    file.write(reinterpret_cast<const char*>(&captured), sizeof(captured));
+    file.write(reinterpret_cast<const char*>(feedback.data()), feedback.size() * sizeof(uint32_t));
+}
+
+void FrameCaptureWriter::writeRecordHeader(CaptureRecordType type, size_t size) {
+    FrameCaptureRecord record;
+    record.type = type;
+    record.size = static_cast<uint32_t>(size);
+    file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+}
+
+// Checks that a record's payload has the size its type implies before it is copied out.
+static void checkRecordSize(const FrameCaptureRecord& record, size_t size,
+                            const std::string& path) {
+    if (record.size != size) {
+        throw std::runtime_error("failed to parse frame capture " + path + ", bad record size!");
+    }
+}
+
+void FrameCapture::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        throw std::runtime_error("failed to open frame capture " + path + "!");
+    }
+    std::vector<char> data(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(data.data(), data.size());
+    if (!file) {
+        throw std::runtime_error("failed to read frame capture " + path + "!");
+    }
+
+    FrameCaptureHeader header;
+    if (data.size() < sizeof(header)) {
+        throw std::runtime_error("failed to parse frame capture " + path + ", file too small!");
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (header.magic != FRAME_CAPTURE_MAGIC || header.version != FRAME_CAPTURE_VERSION) {
+        throw std::runtime_error("failed to parse frame capture " + path
+                                 + ", unsupported format or version!");
+    }
+
+    events.clear();
+    frameCount = 0;
+    bool sessionRead = false;
+    size_t offset = sizeof(header);
+    while (offset < data.size()) {
+        FrameCaptureRecord record;
+        if (data.size() - offset < sizeof(record)) {
+            throw std::runtime_error("failed to parse frame capture " + path + ", truncated!");
+        }
+        std::memcpy(&record, data.data() + offset, sizeof(record));
+        offset += sizeof(record);
+        if (data.size() - offset < record.size) {
+            throw std::runtime_error("failed to parse frame capture " + path + ", truncated!");
+        }
+        const char* payload = data.data() + offset;
+        offset += record.size;
+
+        if (!sessionRead) {
+            if (record.type != CaptureRecordType::Session) {
+                throw std::runtime_error("failed to parse frame capture " + path
+                                         + ", missing session!");
+            }
+            checkRecordSize(record, sizeof(session), path);
+            std::memcpy(&session, payload, sizeof(session));
+            sessionRead = true;
+            continue;
+        }
+
+        CaptureEvent event;
+        event.type = record.type;
+        switch (record.type) {
+            case CaptureRecordType::Options:
+                checkRecordSize(record, sizeof(event.options), path);
+                std::memcpy(&event.options, payload, sizeof(event.options));
+                break;
+            case CaptureRecordType::Resize:
+                checkRecordSize(record, sizeof(event.extent), path);
+                std::memcpy(&event.extent, payload, sizeof(event.extent));
+                break;
+            case CaptureRecordType::Frame:
+                if (record.size < sizeof(event.frame)) {
+                    throw std::runtime_error("failed to parse frame capture " + path
+                                             + ", bad record size!");
+                }
+                std::memcpy(&event.frame, payload, sizeof(event.frame));
+                checkRecordSize(record,
+                                sizeof(event.frame) + event.frame.feedbackCount * sizeof(uint32_t),
+                                path);
+                event.feedback.resize(event.frame.feedbackCount);
+                std::memcpy(event.feedback.data(), payload + sizeof(event.frame),
+                            event.feedback.size() * sizeof(uint32_t));
+                frameCount++;
+                break;
+            default:
+                // Records added by later versions bump the version, so this is corruption.
+                throw std::runtime_error("failed to parse frame capture " + path
+                                         + ", unknown record type!");
+        }
+        events.push_back(std::move(event));
+    }
+
+    if (!sessionRead) {
+        throw std::runtime_error("failed to parse frame capture " + path + ", missing session!");
+    }
+}
@@ -0,0 +1,292 @@
+#include "FrameManager.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "Swapchain.h"
+#include "VulkanDevice.h"
+
+void FrameManager::create(const VulkanDevice& vulkanDevice, uint32_t framesInFlight) {
+    this->vulkanDevice = &vulkanDevice;
+    device = vulkanDevice.getDevice();
+    createSyncObjects(std::clamp(framesInFlight, 1u, MAX_FRAMES_IN_FLIGHT));
+}
+
+void FrameManager::destroy() {
+    freeCommandBuffers();
+    destroySyncObjects();
+}
+
+void FrameManager::setFramesInFlight(uint32_t framesInFlight) {
+    waitForAcquiredImage();
+    waitIdle();
+    // Presentation may still be waiting on the render finished semaphores.
+    vkQueueWaitIdle(vulkanDevice->getPresentQueue());
+    destroySyncObjects();
+    createSyncObjects(std::clamp(framesInFlight, 1u, MAX_FRAMES_IN_FLIGHT));
+    // The fences the images last used are gone, and their frames have finished.
+    std::fill(imagesInFlight.begin(), imagesInFlight.end(), VK_NULL_HANDLE);
+}
+
+void FrameManager::createSyncObjects(uint32_t framesInFlight) {
+    imageAvailableSemaphores.resize(framesInFlight);
+    renderFinishedSemaphores.resize(framesInFlight);
+    inFlightFences.resize(framesInFlight);
+    currentFrame = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+    for (size_t i = 0; i < framesInFlight; i++) {
+        if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i])
+                != VK_SUCCESS
+            || vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i])
+                   != VK_SUCCESS
+            || vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create synchronization objects for a frame!");
+        }
+    }
+}
+
+void FrameManager::destroySyncObjects() {
+    for (size_t i = 0; i < inFlightFences.size(); i++) {
+        vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
+        vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
+        vkDestroyFence(device, inFlightFences[i], nullptr);
+    }
+    renderFinishedSemaphores.clear();
+    imageAvailableSemaphores.clear();
+    inFlightFences.clear();
+}
+
+void FrameManager::recordCommandBuffers(
+    const Swapchain& swapchain, const std::function<void(VkCommandBuffer, uint32_t)>& record) {
+    commandBuffers.resize(swapchain.getImageCount());
+    imagesInFlight.assign(swapchain.getImageCount(), VK_NULL_HANDLE);
+    imagesSubmitted.assign(swapchain.getImageCount(), 0);
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = vulkanDevice->getCommandPool();
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = (uint32_t)commandBuffers.size();
+
+    if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate command buffers!");
+    }
+
+    if (vulkanDevice->getTimestampPeriod() > 0.0f) {
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = 2 * static_cast<uint32_t>(commandBuffers.size());
+
+        if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &timestampQueryPool)
+            != VK_SUCCESS) {
+            throw std::runtime_error("failed to create timestamp query pool!");
+        }
+    }
+
+    for (size_t i = 0; i < commandBuffers.size(); i++) {
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+        if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording command buffer!");
+        }
+
+        uint32_t firstQuery = 2 * static_cast<uint32_t>(i);
+        if (timestampQueryPool != VK_NULL_HANDLE) {
+            vkCmdResetQueryPool(commandBuffers[i], timestampQueryPool, firstQuery, 2);
+            vkCmdWriteTimestamp(commandBuffers[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                timestampQueryPool, firstQuery);
+        }
+
+        record(commandBuffers[i], static_cast<uint32_t>(i));
+
+        if (timestampQueryPool != VK_NULL_HANDLE) {
+            vkCmdWriteTimestamp(commandBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                timestampQueryPool, firstQuery + 1);
+        }
+
+        if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
+        }
+    }
+}
+
+void FrameManager::freeCommandBuffers() {
+    if (!commandBuffers.empty()) {
+        vkFreeCommandBuffers(device, vulkanDevice->getCommandPool(),
+                             static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+        commandBuffers.clear();
+    }
+    if (timestampQueryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device, timestampQueryPool, nullptr);
+        timestampQueryPool = VK_NULL_HANDLE;
+    }
+    submittedImage = UINT32_MAX;
+}
+
+FrameStatus FrameManager::drawFrame(
+    const Swapchain& swapchain, uint64_t timeout,
+    const std::function<void(uint32_t, std::vector<VkCommandBuffer>&)>& beforeSubmit) {
+    submittedImage = UINT32_MAX;
+    VkResult result = vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, timeout);
+    if (result == VK_TIMEOUT) {
+        return FrameStatus::NotReady;
+    } else if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to wait for frame fence!");
+    }
+
+    // An image kept by a call that timed out below was acquired into this frame slot, which has
+    // not advanced since.
+    uint32_t imageIndex = acquiredImage;
+    if (imageIndex == UINT32_MAX) {
+        result = vkAcquireNextImageKHR(device, swapchain.getHandle(), timeout,
+                                       imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE,
+                                       &imageIndex);
+
+        if (result == VK_NOT_READY || result == VK_TIMEOUT) {
+            return FrameStatus::NotReady;
+        } else if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            return FrameStatus::OutOfDate;
+        } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+            throw std::runtime_error("failed to acquire swap chain image!");
+        }
+    }
+
+    if (imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
+        result = vkWaitForFences(device, 1, &imagesInFlight[imageIndex], VK_TRUE, timeout);
+        if (result == VK_TIMEOUT) {
+            // Acquired images cannot be handed back, so the next call renders to this one.
+            acquiredImage = imageIndex;
+            return FrameStatus::NotReady;
+        } else if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to wait for swap chain image fence!");
+        }
+    }
+    imagesInFlight[imageIndex] = inFlightFences[currentFrame];
+    bool acquireWaited = acquiredImageWaited;
+    acquiredImage = UINT32_MAX;
+    acquiredImageWaited = false;
+
+    // Per image buffers are only safe to write once the image's previous frame has finished.
+    submitCommandBuffers.assign(1, commandBuffers[imageIndex]);
+    beforeSubmit(imageIndex, submitCommandBuffers);
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+    VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
+    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+    submitInfo.waitSemaphoreCount = acquireWaited ? 0 : 1;
+    submitInfo.pWaitSemaphores = waitSemaphores;
+    submitInfo.pWaitDstStageMask = waitStages;
+
+    submitInfo.commandBufferCount = static_cast<uint32_t>(submitCommandBuffers.size());
+    submitInfo.pCommandBuffers = submitCommandBuffers.data();
+
+    VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = signalSemaphores;
+
+    vkResetFences(device, 1, &inFlightFences[currentFrame]);
+
+    if (vkQueueSubmit(vulkanDevice->getGraphicsQueue(), 1, &submitInfo,
+                      inFlightFences[currentFrame])
+        != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit draw command buffer!");
+    }
+    submittedImage = imageIndex;
+    imagesSubmitted[imageIndex] = 1;
+
+    VkPresentInfoKHR presentInfo{};
+    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+
+    presentInfo.waitSemaphoreCount = 1;
+    presentInfo.pWaitSemaphores = signalSemaphores;
+
+    VkSwapchainKHR swapChains[] = {swapchain.getHandle()};
+    presentInfo.swapchainCount = 1;
+    presentInfo.pSwapchains = swapChains;
+
+    presentInfo.pImageIndices = &imageIndex;
+
+    result = vkQueuePresentKHR(vulkanDevice->getPresentQueue(), &presentInfo);
+
+    currentFrame = (currentFrame + 1) % inFlightFences.size();
+
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+        return FrameStatus::OutOfDate;
+    } else if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to present swap chain image!");
+    }
+
+    return FrameStatus::Presented;
+}
+
+void FrameManager::releaseAcquiredImage() {
+    waitForAcquiredImage();
+    acquiredImage = UINT32_MAX;
+    acquiredImageWaited = false;
+}
+
+// Waits for the acquire of a kept image on the GPU, so its semaphore is unsignalled again and can
+// be destroyed or reused. The image stays acquired; its frame then submits without the wait.
+void FrameManager::waitForAcquiredImage() {
+    if (acquiredImage == UINT32_MAX || acquiredImageWaited) {
+        return;
+    }
+
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pWaitSemaphores = &imageAvailableSemaphores[currentFrame];
+    submitInfo.pWaitDstStageMask = &waitStage;
+
+    // The slot's fence was signalled when the image was acquired and has not been used since.
+    vkResetFences(device, 1, &inFlightFences[currentFrame]);
+    if (vkQueueSubmit(vulkanDevice->getGraphicsQueue(), 1, &submitInfo,
+                      inFlightFences[currentFrame])
+        != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit swap chain image acquire wait!");
+    }
+    vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    acquiredImageWaited = true;
+}
+
+void FrameManager::waitIdle() const {
+    vkWaitForFences(device, static_cast<uint32_t>(inFlightFences.size()), inFlightFences.data(),
+                    VK_TRUE, UINT64_MAX);
+}
+
+bool FrameManager::getLastFrameGpuTime(double& milliseconds) const {
+    return submittedImage != UINT32_MAX
+           && readGpuTime(submittedImage, VK_QUERY_RESULT_WAIT_BIT, milliseconds);
+}
+
+bool FrameManager::getImageGpuTime(uint32_t imageIndex, double& milliseconds) const {
+    return imageIndex < imagesSubmitted.size() && imagesSubmitted[imageIndex]
+           && readGpuTime(imageIndex, 0, milliseconds);
+}
+
+bool FrameManager::readGpuTime(uint32_t imageIndex, VkQueryResultFlags flags,
+                               double& milliseconds) const {
+    uint64_t timestamps[2];
+    if (timestampQueryPool == VK_NULL_HANDLE
+        || vkGetQueryPoolResults(device, timestampQueryPool, 2 * imageIndex, 2,
+                                 sizeof(timestamps), timestamps, sizeof(uint64_t),
+                                 VK_QUERY_RESULT_64_BIT | flags)
+               != VK_SUCCESS) {
+        return false;
+    }
+
+    milliseconds = (timestamps[1] - timestamps[0]) * vulkanDevice->getTimestampPeriod() * 1e-6;
+    return true;
+}
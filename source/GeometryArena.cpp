@@ -0,0 +1,337 @@
+#include "GeometryArena.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+#include "VulkanDevice.h"
+
+void RangeAllocator::reset(uint32_t capacity) {
+    freeRanges.clear();
+    if (capacity > 0) {
+        freeRanges[0] = capacity;
+    }
+    freeSize = capacity;
+}
+
+bool RangeAllocator::allocate(uint32_t size, uint32_t& offset) {
+    if (size == 0) {
+        offset = 0;
+        return true;
+    }
+
+    for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+        if (it->second < size) {
+            continue;
+        }
+
+        offset = it->first;
+        uint32_t remaining = it->second - size;
+        freeRanges.erase(it);
+        if (remaining > 0) {
+            freeRanges[offset + size] = remaining;
+        }
+        freeSize -= size;
+        return true;
+    }
+
+    return false;
+}
+
+void RangeAllocator::free(uint32_t offset, uint32_t size) {
+    if (size == 0) {
+        return;
+    }
+    freeSize += size;
+
+    auto next = freeRanges.lower_bound(offset);
+    if (next != freeRanges.end() && offset + size == next->first) {
+        size += next->second;
+        next = freeRanges.erase(next);
+    }
+    if (next != freeRanges.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            previous->second += size;
+            return;
+        }
+    }
+    freeRanges[offset] = size;
+}
+
+uint32_t RangeAllocator::getLargestFreeRange() const {
+    uint32_t largest = 0;
+    for (const auto& range : freeRanges) {
+        largest = std::max(largest, range.second);
+    }
+    return largest;
+}
+
+void GeometryArena::create(const VulkanDevice& vulkanDevice, VkDeviceSize vertexStride,
+                           VkDeviceSize positionStride, uint32_t vertexCapacity,
+                           uint32_t indexCapacity) {
+    this->vulkanDevice = &vulkanDevice;
+    device = vulkanDevice.getDevice();
+    this->vertexStride = vertexStride;
+    this->positionStride = positionStride;
+    this->vertexCapacity = vertexCapacity;
+    this->indexCapacity = indexCapacity;
+
+    mappable = vulkanDevice.hasMappableDeviceMemory();
+    createBuffers(vertices, positions, indices);
+    vertexAllocator.reset(vertexCapacity);
+    indexAllocator.reset(indexCapacity);
+
+    scheduler.create(vulkanDevice);
+}
+
+void GeometryArena::destroy() {
+    scheduler.destroy();
+    if (compaction.running) {
+        retireBuffer(compaction.vertices);
+        retireBuffer(compaction.positions);
+        retireBuffer(compaction.indices);
+        compaction = {};
+    }
+    retireBuffer(vertices);
+    retireBuffer(positions);
+    retireBuffer(indices);
+    releaseRetiredBuffers();
+
+    ranges.clear();
+    live.clear();
+    freeHandles.clear();
+    moved = false;
+}
+
+void GeometryArena::createBuffers(Buffer& vertexData, Buffer& positionData,
+                                  Buffer& indexData) const {
+    createBuffer(vertexStride * vertexCapacity, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexData);
+    if (positionStride > 0) {
+        createBuffer(positionStride * vertexCapacity, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                     positionData);
+    }
+    createBuffer(sizeof(uint16_t) * indexCapacity, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexData);
+}
+
+void GeometryArena::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                                 Buffer& buffer) const {
+    VkBufferUsageFlags transferUsage
+        = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    if (mappable) {
+        properties |= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    }
+
+    vulkanDevice->createBuffer(size, usage | transferUsage, properties, buffer.buffer,
+                               buffer.memory);
+
+    buffer.mapping = nullptr;
+    if (mappable) {
+        vkMapMemory(device, buffer.memory, 0, size, 0, &buffer.mapping);
+    }
+}
+
+// Hands the buffer to releaseRetiredBuffers() and clears it.
+void GeometryArena::retireBuffer(Buffer& buffer) {
+    if (buffer.buffer != VK_NULL_HANDLE) {
+        retiredBuffers.push_back(buffer.buffer);
+        retiredBuffersMemory.push_back(buffer.memory);
+    }
+    buffer = {};
+}
+
+GeometryHandle GeometryArena::allocate(uint32_t vertexCount, uint32_t indexCount) {
+    finishCompaction(true);
+
+    uint32_t vertexOffset, firstIndex;
+    if (!vertexAllocator.allocate(vertexCount, vertexOffset)) {
+        throw std::runtime_error("failed to allocate vertices in geometry arena!");
+    }
+    if (!indexAllocator.allocate(indexCount, firstIndex)) {
+        vertexAllocator.free(vertexOffset, vertexCount);
+        throw std::runtime_error("failed to allocate indices in geometry arena!");
+    }
+
+    GeometryRange range{};
+    range.vertexOffset = static_cast<int32_t>(vertexOffset);
+    range.vertexCount = vertexCount;
+    range.firstIndex = firstIndex;
+    range.indexCount = indexCount;
+
+    GeometryHandle mesh;
+    if (!freeHandles.empty()) {
+        mesh = freeHandles.back();
+        freeHandles.pop_back();
+        ranges[mesh] = range;
+        live[mesh] = 1;
+    } else {
+        mesh = static_cast<GeometryHandle>(ranges.size());
+        ranges.push_back(range);
+        live.push_back(1);
+    }
+
+    return mesh;
+}
+
+void GeometryArena::free(GeometryHandle mesh) {
+    if (mesh >= live.size() || !live[mesh]) {
+        throw std::runtime_error("geometry arena mesh does not exist!");
+    }
+
+    finishCompaction(true);
+
+    const GeometryRange& range = ranges[mesh];
+    vertexAllocator.free(static_cast<uint32_t>(range.vertexOffset), range.vertexCount);
+    indexAllocator.free(range.firstIndex, range.indexCount);
+    ranges[mesh] = {};
+    live[mesh] = 0;
+    freeHandles.push_back(mesh);
+}
+
+VkDeviceSize GeometryArena::getVertexDataOffset(GeometryHandle mesh) const {
+    return vertexStride * static_cast<uint32_t>(getRange(mesh).vertexOffset);
+}
+
+VkDeviceSize GeometryArena::getPositionDataOffset(GeometryHandle mesh) const {
+    return positionStride * static_cast<uint32_t>(getRange(mesh).vertexOffset);
+}
+
+VkDeviceSize GeometryArena::getIndexDataOffset(GeometryHandle mesh) const {
+    return sizeof(uint16_t) * getRange(mesh).firstIndex;
+}
+
+bool GeometryArena::update() {
+    if (compaction.running) {
+        finishCompaction(false);
+    } else if (isFragmented()) {
+        beginCompaction();
+    }
+
+    bool result = moved;
+    moved = false;
+    return result;
+}
+
+void GeometryArena::releaseRetiredBuffers() {
+    for (size_t i = 0; i < retiredBuffers.size(); i++) {
+        vkDestroyBuffer(device, retiredBuffers[i], nullptr);
+        vkFreeMemory(device, retiredBuffersMemory[i], nullptr);
+    }
+    retiredBuffers.clear();
+    retiredBuffersMemory.clear();
+}
+
+// Fragmented once the largest free range of either buffer is under half of its free space.
+bool GeometryArena::isFragmented() const {
+    return vertexAllocator.getLargestFreeRange() * 2 < vertexAllocator.getFreeSize()
+           || indexAllocator.getLargestFreeRange() * 2 < indexAllocator.getFreeSize();
+}
+
+// Packs the live meshes to the front of new buffers in their current order. The old buffers are
+// only read, so frames in flight keep drawing from them while the copies run.
+void GeometryArena::beginCompaction() {
+    compaction.ranges = ranges;
+    compaction.vertexAllocator.reset(vertexCapacity);
+    compaction.indexAllocator.reset(indexCapacity);
+    createBuffers(compaction.vertices, compaction.positions, compaction.indices);
+
+    std::vector<GeometryHandle> meshes;
+    for (GeometryHandle mesh = 0; mesh < live.size(); mesh++) {
+        if (live[mesh]) {
+            meshes.push_back(mesh);
+        }
+    }
+
+    std::vector<VkBufferCopy> vertexCopies;
+    std::vector<VkBufferCopy> positionCopies;
+    std::sort(meshes.begin(), meshes.end(), [this](GeometryHandle a, GeometryHandle b) {
+        return ranges[a].vertexOffset < ranges[b].vertexOffset;
+    });
+    for (GeometryHandle mesh : meshes) {
+        uint32_t offset;
+        compaction.vertexAllocator.allocate(ranges[mesh].vertexCount, offset);
+        compaction.ranges[mesh].vertexOffset = static_cast<int32_t>(offset);
+        if (ranges[mesh].vertexCount > 0) {
+            vertexCopies.push_back({getVertexDataOffset(mesh), vertexStride * offset,
+                                    vertexStride * ranges[mesh].vertexCount});
+            positionCopies.push_back({getPositionDataOffset(mesh), positionStride * offset,
+                                      positionStride * ranges[mesh].vertexCount});
+        }
+    }
+
+    std::vector<VkBufferCopy> indexCopies;
+    std::sort(meshes.begin(), meshes.end(), [this](GeometryHandle a, GeometryHandle b) {
+        return ranges[a].firstIndex < ranges[b].firstIndex;
+    });
+    for (GeometryHandle mesh : meshes) {
+        uint32_t offset;
+        compaction.indexAllocator.allocate(ranges[mesh].indexCount, offset);
+        compaction.ranges[mesh].firstIndex = offset;
+        if (ranges[mesh].indexCount > 0) {
+            indexCopies.push_back({getIndexDataOffset(mesh), sizeof(uint16_t) * offset,
+                                   sizeof(uint16_t) * ranges[mesh].indexCount});
+        }
+    }
+
+    VkCommandBuffer commandBuffer = scheduler.beginCommands(QueueType::Graphics);
+
+    // Uploads into the old buffers finish before they are read back.
+    VkMemoryBarrier uploadBarrier{};
+    uploadBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    uploadBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    uploadBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &uploadBarrier, 0, nullptr, 0,
+                         nullptr);
+
+    if (!vertexCopies.empty()) {
+        vkCmdCopyBuffer(commandBuffer, vertices.buffer, compaction.vertices.buffer,
+                        static_cast<uint32_t>(vertexCopies.size()), vertexCopies.data());
+        if (positions.buffer != VK_NULL_HANDLE) {
+            vkCmdCopyBuffer(commandBuffer, positions.buffer, compaction.positions.buffer,
+                            static_cast<uint32_t>(positionCopies.size()), positionCopies.data());
+        }
+    }
+    if (!indexCopies.empty()) {
+        vkCmdCopyBuffer(commandBuffer, indices.buffer, compaction.indices.buffer,
+                        static_cast<uint32_t>(indexCopies.size()), indexCopies.data());
+    }
+
+    VkMemoryBarrier drawBarrier{};
+    drawBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    drawBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    drawBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &drawBarrier, 0, nullptr, 0,
+                         nullptr);
+
+    scheduler.submit(QueueType::Graphics, commandBuffer);
+    scheduler.flush();
+    compaction.running = true;
+}
+
+void GeometryArena::finishCompaction(bool wait) {
+    if (!compaction.running) {
+        return;
+    }
+    if (wait) {
+        scheduler.waitIdle();
+    } else if (!scheduler.isIdle()) {
+        return;
+    }
+
+    retireBuffer(vertices);
+    retireBuffer(positions);
+    retireBuffer(indices);
+
+    vertices = compaction.vertices;
+    positions = compaction.positions;
+    indices = compaction.indices;
+    vertexAllocator = compaction.vertexAllocator;
+    indexAllocator = compaction.indexAllocator;
+    ranges.swap(compaction.ranges);
+
+    compaction = {};
+    moved = true;
+}
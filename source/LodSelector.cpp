@@ -0,0 +1,237 @@
+#include "LodSelector.h"
+
+#include <array>
+#include <stdexcept>
+
+#include "GraphicsPipeline.h"
+#include "SceneResources.h"
+#include "ShaderRegistry.h"
+#include "VulkanDevice.h"
+
+static const uint32_t LOD_GROUP_SIZE = 64;
+
+void LodSelector::create(const VulkanDevice& vulkanDevice,
+                         const std::vector<VkBuffer>& uniformBuffers,
+                         const std::vector<VkBuffer>& instanceBuffers,
+                         const std::vector<VkBuffer>& indirectBuffers, uint32_t commandCount) {
+    this->vulkanDevice = &vulkanDevice;
+    device = vulkanDevice.getDevice();
+    this->commandCount = commandCount;
+    this->indirectBuffers = indirectBuffers;
+
+    std::array<VkDescriptorSetLayoutBinding, 5> bindings{};
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout)
+        != VK_SUCCESS) {
+        throw std::runtime_error("failed to create LOD descriptor set layout!");
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.size = sizeof(uint32_t);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout)
+        != VK_SUCCESS) {
+        throw std::runtime_error("failed to create LOD pipeline layout!");
+    }
+
+    createPipeline();
+
+    // Host visible so the draws are written while the commands are recorded, like the commands.
+    size_t imageCount = indirectBuffers.size();
+    VkDeviceSize drawBufferSize = sizeof(LodDraw) * commandCount;
+    drawBuffers.resize(imageCount);
+    drawBuffersMemory.resize(imageCount);
+    drawMappings.resize(imageCount);
+
+    for (size_t i = 0; i < imageCount; i++) {
+        vulkanDevice.createBuffer(
+            drawBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            drawBuffers[i], drawBuffersMemory[i]);
+
+        void* data;
+        vkMapMemory(device, drawBuffersMemory[i], 0, drawBufferSize, 0, &data);
+        drawMappings[i] = static_cast<LodDraw*>(data);
+        for (uint32_t draw = 0; draw < commandCount; draw++) {
+            drawMappings[i][draw] = LodDraw{};
+        }
+    }
+
+    // One buffer for every image. Levels saved by destroy() carry over unless the command count
+    // changed.
+    VkDeviceSize stateBufferSize = sizeof(LodState) * commandCount;
+    vulkanDevice.createBuffer(
+        stateBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stateBuffer,
+        stateBufferMemory);
+
+    void* data;
+    vkMapMemory(device, stateBufferMemory, 0, stateBufferSize, 0, &data);
+    stateMapping = static_cast<LodState*>(data);
+    for (uint32_t draw = 0; draw < commandCount; draw++) {
+        stateMapping[draw] = savedStates.size() == commandCount ? savedStates[draw] : LodState{};
+    }
+
+    createDescriptorSets(uniformBuffers, instanceBuffers);
+}
+
+// Called with the device idle, so every selection's barrier has made its state visible here.
+void LodSelector::destroy() {
+    savedStates.assign(stateMapping, stateMapping + commandCount);
+    vkUnmapMemory(device, stateBufferMemory);
+    vkDestroyBuffer(device, stateBuffer, nullptr);
+    vkFreeMemory(device, stateBufferMemory, nullptr);
+    stateBuffer = VK_NULL_HANDLE;
+    stateBufferMemory = VK_NULL_HANDLE;
+    stateMapping = nullptr;
+
+    for (size_t i = 0; i < drawBuffers.size(); i++) {
+        vkUnmapMemory(device, drawBuffersMemory[i]);
+        vkDestroyBuffer(device, drawBuffers[i], nullptr);
+        vkFreeMemory(device, drawBuffersMemory[i], nullptr);
+    }
+    drawBuffers.clear();
+    drawBuffersMemory.clear();
+    drawMappings.clear();
+    indirectBuffers.clear();
+
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    descriptorPool = VK_NULL_HANDLE;
+    descriptorSets.clear();
+
+    vkDestroyPipeline(device, pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+    pipeline = VK_NULL_HANDLE;
+    pipelineLayout = VK_NULL_HANDLE;
+    descriptorSetLayout = VK_NULL_HANDLE;
+}
+
+void LodSelector::reloadPipeline() {
+    vkDestroyPipeline(device, pipeline, nullptr);
+    pipeline = VK_NULL_HANDLE;
+    createPipeline();
+}
+
+void LodSelector::createPipeline() {
+    VkShaderModule shaderModule = createShaderModule(device, getShaderCode("lod_select_comp"));
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = pipelineLayout;
+
+    VkResult result = vkCreateComputePipelines(device, vulkanDevice->getPipelineCache(), 1,
+                                               &pipelineInfo, nullptr, &pipeline);
+    vkDestroyShaderModule(device, shaderModule, nullptr);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute pipeline!");
+    }
+}
+
+void LodSelector::createDescriptorSets(const std::vector<VkBuffer>& uniformBuffers,
+                                       const std::vector<VkBuffer>& instanceBuffers) {
+    uint32_t imageCount = static_cast<uint32_t>(indirectBuffers.size());
+
+    std::array<VkDescriptorPoolSize, 2> poolSizes{};
+    poolSizes[0] = {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, imageCount};
+    poolSizes[1] = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * imageCount};
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = imageCount;
+
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create LOD descriptor pool!");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(imageCount, descriptorSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = imageCount;
+    allocInfo.pSetLayouts = layouts.data();
+
+    descriptorSets.resize(imageCount);
+    if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate LOD descriptor sets!");
+    }
+
+    for (uint32_t i = 0; i < imageCount; i++) {
+        std::array<VkDescriptorBufferInfo, 5> bufferInfos{};
+        bufferInfos[0] = {uniformBuffers[i], 0, sizeof(UniformBufferObject)};
+        bufferInfos[1] = {instanceBuffers[i], 0, VK_WHOLE_SIZE};
+        bufferInfos[2] = {drawBuffers[i], 0, VK_WHOLE_SIZE};
+        bufferInfos[3] = {indirectBuffers[i], 0, VK_WHOLE_SIZE};
+        bufferInfos[4] = {stateBuffer, 0, VK_WHOLE_SIZE};
+
+        std::array<VkWriteDescriptorSet, 5> writes{};
+        for (uint32_t binding = 0; binding < writes.size(); binding++) {
+            writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[binding].dstSet = descriptorSets[i];
+            writes[binding].dstBinding = binding;
+            writes[binding].descriptorCount = 1;
+            writes[binding].descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+                                                          : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[binding].pBufferInfo = &bufferInfos[binding];
+        }
+
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0,
+                               nullptr);
+    }
+}
+
+void LodSelector::record(VkCommandBuffer commandBuffer, uint32_t imageIndex) const {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1,
+                            &descriptorSets[imageIndex], 0, nullptr);
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(commandCount), &commandCount);
+    vkCmdDispatch(commandBuffer, (commandCount + LOD_GROUP_SIZE - 1) / LOD_GROUP_SIZE, 1, 1);
+
+    std::array<VkBufferMemoryBarrier, 2> barriers{};
+    for (VkBufferMemoryBarrier& barrier : barriers) {
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+    }
+    barriers[0].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    barriers[0].buffer = indirectBuffers[imageIndex];
+    // The next frame's selection reads and rewrites the state; destroy() reads it on the host.
+    barriers[1].dstAccessMask
+        = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_HOST_READ_BIT;
+    barriers[1].buffer = stateBuffer;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+                             | VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(),
+                         0, nullptr);
+}
@@ -0,0 +1,169 @@
+#include "Log.h"
+
+#include <spdlog/async.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+
+static const size_t SUBSYSTEM_COUNT = static_cast<size_t>(LogSubsystem::Count);
+// Messages the background thread can fall behind by before the oldest are dropped.
+static const size_t LOG_QUEUE_SIZE = 8192;
+
+static const std::array<const char*, SUBSYSTEM_COUNT> subsystemNames
+    = {"app", "device", "render", "streaming", "shaders", "validation"};
+static const std::array<const char*, 6> levelNames
+    = {"trace", "debug", "info", "warn", "error", "off"};
+
+struct LogState {
+    std::shared_ptr<spdlog::details::thread_pool> threadPool;
+    std::array<std::shared_ptr<spdlog::logger>, SUBSYSTEM_COUNT> loggers;
+    std::array<LogLevel, SUBSYSTEM_COUNT> levels;
+};
+
+// One logger per subsystem, sharing a sink and the thread that writes to it. Created on first
+// use, so messages logged before initLogging() are not lost.
+static LogState& getLogState() {
+    static LogState state = [] {
+        LogState created;
+        created.levels.fill(LogLevel::Info);
+        created.threadPool = std::make_shared<spdlog::details::thread_pool>(LOG_QUEUE_SIZE, 1);
+        auto sink = std::make_shared<spdlog::sinks::stderr_color_sink_mt>();
+        for (size_t i = 0; i < SUBSYSTEM_COUNT; i++) {
+            auto logger = std::make_shared<spdlog::async_logger>(
+                subsystemNames[i], sink, created.threadPool,
+                spdlog::async_overflow_policy::overrun_oldest);
+            logger->set_pattern("[%H:%M:%S.%e] [%n] [%l] %v");
+            logger->set_level(spdlog::level::info);
+            logger->flush_on(spdlog::level::warn);
+            spdlog::register_logger(logger);
+            created.loggers[i] = logger;
+        }
+        return created;
+    }();
+    return state;
+}
+
+static std::atomic<uint64_t> logFrame{0};
+
+static spdlog::level::level_enum toSpdlogLevel(LogLevel level) {
+    switch (level) {
+        case LogLevel::Trace:
+            return spdlog::level::trace;
+        case LogLevel::Debug:
+            return spdlog::level::debug;
+        case LogLevel::Info:
+            return spdlog::level::info;
+        case LogLevel::Warn:
+            return spdlog::level::warn;
+        case LogLevel::Error:
+            return spdlog::level::err;
+        default:
+            return spdlog::level::off;
+    }
+}
+
+static LogLevel parseLevel(const std::string& name) {
+    for (size_t i = 0; i < levelNames.size(); i++) {
+        if (name == levelNames[i]) {
+            return static_cast<LogLevel>(i);
+        }
+    }
+
+    throw std::runtime_error("unknown log level " + name + "!");
+}
+
+void initLogging(const std::string& levels) {
+    getLogState();
+    setLogLevels(levels);
+    spdlog::flush_every(std::chrono::seconds(1));
+}
+
+void shutdownLogging() {
+    LogState& state = getLogState();
+    if (!state.threadPool) {
+        return;
+    }
+
+    for (const auto& logger : state.loggers) {
+        logger->flush();
+    }
+    size_t dropped = state.threadPool->overrun_counter();
+    // Stops the periodic flush; the thread pool then writes what is queued before it joins.
+    spdlog::shutdown();
+    state.loggers = {};
+    state.threadPool.reset();
+
+    if (dropped > 0) {
+        std::cerr << "log: " << dropped << " messages dropped" << std::endl;
+    }
+}
+
+void setLogLevels(const std::string& levels) {
+    LogState& state = getLogState();
+    std::array<LogLevel, SUBSYSTEM_COUNT> parsed = state.levels;
+
+    size_t start = 0;
+    while (start < levels.size()) {
+        size_t end = levels.find(',', start);
+        if (end == std::string::npos) {
+            end = levels.size();
+        }
+        std::string entry = levels.substr(start, end - start);
+        start = end + 1;
+
+        size_t separator = entry.find('=');
+        if (separator == std::string::npos) {
+            parsed.fill(parseLevel(entry));
+            continue;
+        }
+
+        std::string subsystem = entry.substr(0, separator);
+        LogLevel level = parseLevel(entry.substr(separator + 1));
+        bool found = false;
+        for (size_t i = 0; i < SUBSYSTEM_COUNT; i++) {
+            if (subsystem == subsystemNames[i]) {
+                parsed[i] = level;
+                found = true;
+            }
+        }
+        if (!found) {
+            throw std::runtime_error("unknown log subsystem " + subsystem + "!");
+        }
+    }
+
+    state.levels = parsed;
+    for (size_t i = 0; i < SUBSYSTEM_COUNT; i++) {
+        if (state.loggers[i]) {
+            state.loggers[i]->set_level(toSpdlogLevel(parsed[i]));
+        }
+    }
+}
+
+bool isLogEnabled(LogSubsystem subsystem, LogLevel level) {
+    const auto& logger = getLogState().loggers[static_cast<size_t>(subsystem)];
+    return logger && logger->should_log(toSpdlogLevel(level));
+}
+
+void logMessage(LogSubsystem subsystem, LogLevel level, const std::string& message) {
+    const auto& logger = getLogState().loggers[static_cast<size_t>(subsystem)];
+    if (!logger) {
+        return;
+    }
+
+    uint64_t frame = logFrame.load(std::memory_order_relaxed);
+    if (frame > 0 && (level >= LogLevel::Error || subsystem == LogSubsystem::Validation)) {
+        logger->log(toSpdlogLevel(level), "frame {}: {}", frame, message);
+    } else {
+        logger->log(toSpdlogLevel(level), "{}", message);
+    }
+}
+
+void setLogFrame(uint64_t frame) {
+    logFrame.store(frame, std::memory_order_relaxed);
+}
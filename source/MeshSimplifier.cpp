@@ -0,0 +1,352 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numeric>
+#include <utility>
+
+// Border planes count this many times the squared edge length as area, so open edges keep their
+// shape.
+static const double BORDER_WEIGHT = 10.0;
+// Error bound of the first simplified level, relative to the bounding sphere's radius.
+static const float FIRST_LOD_ERROR = 0.01f;
+// A level has to drop at least this fraction of the previous level's indices to be kept.
+static const float MIN_LOD_REDUCTION = 0.25f;
+
+// Garland and Heckbert's error quadric: the area weighted sum of squared distances to a set of
+// planes, as the upper triangle of a symmetric 4x4 matrix.
+using Quadric = std::array<double, 10>;
+
+static Quadric makePlaneQuadric(const glm::vec3& normal, const glm::vec3& point, double weight) {
+    double a = normal.x, b = normal.y, c = normal.z;
+    double d = -(a * point.x + b * point.y + c * point.z);
+    return {weight * a * a, weight * a * b, weight * a * c, weight * a * d, weight * b * b,
+            weight * b * c, weight * b * d, weight * c * c, weight * c * d, weight * d * d};
+}
+
+static void addQuadric(Quadric& quadric, const Quadric& other) {
+    for (size_t i = 0; i < quadric.size(); i++) {
+        quadric[i] += other[i];
+    }
+}
+
+static double evaluateQuadric(const Quadric& q, const glm::vec3& p) {
+    double x = p.x, y = p.y, z = p.z;
+    return q[0] * x * x + 2.0 * q[1] * x * y + 2.0 * q[2] * x * z + 2.0 * q[3] * x
+           + q[4] * y * y + 2.0 * q[5] * y * z + 2.0 * q[6] * y + q[7] * z * z + 2.0 * q[8] * z
+           + q[9];
+}
+
+// An undirected edge with its lower vertex in the high half, so sorted keys group every use of
+// an edge together.
+static uint64_t makeEdgeKey(uint32_t a, uint32_t b) {
+    return a < b ? uint64_t(a) << 32 | b : uint64_t(b) << 32 | a;
+}
+
+static uint32_t getEdgeStart(uint64_t key) {
+    return static_cast<uint32_t>(key >> 32);
+}
+
+static uint32_t getEdgeEnd(uint64_t key) {
+    return static_cast<uint32_t>(key);
+}
+
+// Triangles using an edge; edges used once are on an open border.
+struct EdgeCount {
+    uint64_t key;
+    uint32_t count;
+};
+
+// Sorts the edges by key and sums the counts of duplicates, dropping edges that collapsed to a
+// point or that no triangle uses any more.
+static void mergeEdges(std::vector<EdgeCount>& edges) {
+    std::sort(edges.begin(), edges.end(),
+              [](const EdgeCount& a, const EdgeCount& b) { return a.key < b.key; });
+    size_t kept = 0;
+    for (size_t i = 0; i < edges.size(); i++) {
+        EdgeCount edge = edges[i];
+        if (edge.count == 0 || getEdgeStart(edge.key) == getEdgeEnd(edge.key)) {
+            continue;
+        }
+        if (kept > 0 && edges[kept - 1].key == edge.key) {
+            edges[kept - 1].count += edge.count;
+        } else {
+            edges[kept++] = edge;
+        }
+    }
+    edges.resize(kept);
+}
+
+static EdgeCount& findEdge(std::vector<EdgeCount>& edges, uint32_t a, uint32_t b) {
+    uint64_t key = makeEdgeKey(a, b);
+    return *std::lower_bound(
+        edges.begin(), edges.end(), key,
+        [](const EdgeCount& edge, uint64_t value) { return edge.key < value; });
+}
+
+static glm::vec3 getNormal(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2) {
+    return glm::cross(p1 - p0, p2 - p0);
+}
+
+std::vector<uint16_t> simplifyMesh(const glm::vec3* positions, uint32_t vertexCount,
+                                   const uint16_t* indices, uint32_t indexCount,
+                                   uint32_t targetIndexCount, float maxError) {
+    // Degenerate triangles cover nothing and would leave edges behind that no collapse removes.
+    std::vector<uint32_t> triangles;
+    triangles.reserve(indexCount);
+    for (uint32_t t = 0; t + 2 < indexCount; t += 3) {
+        uint32_t a = indices[t], b = indices[t + 1], c = indices[t + 2];
+        if (a != b && b != c && c != a) {
+            triangles.insert(triangles.end(), {a, b, c});
+        }
+    }
+
+    // Vertices split only by their attributes cannot move without tearing the seam open.
+    std::vector<bool> locked(vertexCount, false);
+    std::vector<uint32_t> byPosition(vertexCount);
+    std::iota(byPosition.begin(), byPosition.end(), 0u);
+    std::sort(byPosition.begin(), byPosition.end(), [positions](uint32_t a, uint32_t b) {
+        const glm::vec3& p = positions[a];
+        const glm::vec3& q = positions[b];
+        return p.x != q.x ? p.x < q.x : p.y != q.y ? p.y < q.y : p.z < q.z;
+    });
+    for (uint32_t i = 1; i < vertexCount; i++) {
+        if (positions[byPosition[i]] == positions[byPosition[i - 1]]) {
+            locked[byPosition[i]] = true;
+            locked[byPosition[i - 1]] = true;
+        }
+    }
+
+    // Built once here and then kept up to date through every pass's collapses.
+    std::vector<EdgeCount> edges;
+    edges.reserve(triangles.size());
+    for (size_t t = 0; t < triangles.size(); t += 3) {
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            uint32_t a = triangles[t + corner];
+            uint32_t b = triangles[t + (corner + 1) % 3];
+            edges.push_back({makeEdgeKey(a, b), 1});
+        }
+    }
+    mergeEdges(edges);
+
+    // Divided by the accumulated face area, a quadric gives the mean squared distance.
+    std::vector<Quadric> quadrics(vertexCount, Quadric{});
+    std::vector<double> areas(vertexCount, 0.0);
+    for (size_t t = 0; t < triangles.size(); t += 3) {
+        const glm::vec3& p0 = positions[triangles[t]];
+        glm::vec3 normal
+            = getNormal(p0, positions[triangles[t + 1]], positions[triangles[t + 2]]);
+        float length = glm::length(normal);
+        if (length == 0.0f) {
+            continue;
+        }
+        normal /= length;
+
+        double area = 0.5 * length;
+        Quadric face = makePlaneQuadric(normal, p0, area);
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            uint32_t a = triangles[t + corner];
+            uint32_t b = triangles[t + (corner + 1) % 3];
+            addQuadric(quadrics[a], face);
+            areas[a] += area;
+
+            // A plane through the border edge, perpendicular to the face.
+            if (findEdge(edges, a, b).count == 1) {
+                glm::vec3 edge = positions[b] - positions[a];
+                glm::vec3 borderNormal = glm::cross(edge, normal);
+                float borderLength = glm::length(borderNormal);
+                if (borderLength > 0.0f) {
+                    double weight = BORDER_WEIGHT * glm::dot(edge, edge);
+                    Quadric border
+                        = makePlaneQuadric(borderNormal / borderLength, positions[a], weight);
+                    addQuadric(quadrics[a], border);
+                    addQuadric(quadrics[b], border);
+                }
+            }
+        }
+    }
+
+    struct Collapse {
+        double cost;
+        uint32_t from;
+        uint32_t to;
+    };
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<bool> touched(vertexCount);
+    std::vector<bool> border(vertexCount);
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+    std::vector<uint32_t> adjacencyFill(vertexCount);
+    std::vector<uint32_t> adjacency;
+    double maxCost = double(maxError) * maxError;
+
+    // Each pass collapses the cheapest edges whose neighbourhoods do not overlap, so the costs
+    // computed at the start of the pass stay exact for every collapse it makes.
+    while (triangles.size() > targetIndexCount) {
+        std::fill(border.begin(), border.end(), false);
+        for (const EdgeCount& edge : edges) {
+            if (edge.count == 1) {
+                border[getEdgeStart(edge.key)] = true;
+                border[getEdgeEnd(edge.key)] = true;
+            }
+        }
+
+        // Triangles around each vertex.
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (uint32_t index : triangles) {
+            adjacencyOffsets[index + 1]++;
+        }
+        for (uint32_t v = 0; v < vertexCount; v++) {
+            adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        }
+        adjacency.resize(triangles.size());
+        std::copy(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1, adjacencyFill.begin());
+        for (size_t i = 0; i < triangles.size(); i++) {
+            adjacency[adjacencyFill[triangles[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        collapses.clear();
+        for (const EdgeCount& edge : edges) {
+            for (uint32_t side = 0; side < 2; side++) {
+                uint32_t from = side == 0 ? getEdgeStart(edge.key) : getEdgeEnd(edge.key);
+                uint32_t to = side == 0 ? getEdgeEnd(edge.key) : getEdgeStart(edge.key);
+                // Border vertices may only slide along the border.
+                if (locked[from] || (border[from] && edge.count != 1)) {
+                    continue;
+                }
+                Quadric combined = quadrics[from];
+                addQuadric(combined, quadrics[to]);
+                double area = std::max(areas[from] + areas[to], 1e-12);
+                collapses.push_back({evaluateQuadric(combined, positions[to]) / area, from, to});
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(),
+                  [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+        for (uint32_t v = 0; v < vertexCount; v++) {
+            remap[v] = v;
+        }
+        std::fill(touched.begin(), touched.end(), false);
+        size_t remainingIndices = triangles.size();
+        uint32_t collapsed = 0;
+
+        for (const Collapse& collapse : collapses) {
+            if (remainingIndices <= targetIndexCount || collapse.cost > maxCost) {
+                break;
+            }
+            if (touched[collapse.from] || touched[collapse.to]) {
+                continue;
+            }
+
+            // Moving the vertex must not fold any remaining triangle over.
+            bool flips = false;
+            uint32_t removed = 0;
+            for (uint32_t a = adjacencyOffsets[collapse.from];
+                 a < adjacencyOffsets[collapse.from + 1] && !flips; a++) {
+                const uint32_t* corners = &triangles[size_t(adjacency[a]) * 3];
+                if (corners[0] == collapse.to || corners[1] == collapse.to
+                    || corners[2] == collapse.to) {
+                    removed++;
+                    continue;
+                }
+                std::array<glm::vec3, 3> moved;
+                for (uint32_t corner = 0; corner < 3; corner++) {
+                    moved[corner] = positions[corners[corner] == collapse.from ? collapse.to
+                                                                               : corners[corner]];
+                }
+                glm::vec3 before = getNormal(positions[corners[0]], positions[corners[1]],
+                                             positions[corners[2]]);
+                glm::vec3 after = getNormal(moved[0], moved[1], moved[2]);
+                flips = glm::dot(before, after) <= 0.0f;
+            }
+            if (flips) {
+                continue;
+            }
+
+            remap[collapse.from] = collapse.to;
+            addQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+            areas[collapse.to] += areas[collapse.from];
+            for (uint32_t a = adjacencyOffsets[collapse.from];
+                 a < adjacencyOffsets[collapse.from + 1]; a++) {
+                const uint32_t* corners = &triangles[size_t(adjacency[a]) * 3];
+                touched[corners[0]] = touched[corners[1]] = touched[corners[2]] = true;
+                // Triangles across the collapsed edge disappear, and with them one use of each
+                // of their edges.
+                if (corners[0] == collapse.to || corners[1] == collapse.to
+                    || corners[2] == collapse.to) {
+                    for (uint32_t corner = 0; corner < 3; corner++) {
+                        findEdge(edges, corners[corner], corners[(corner + 1) % 3]).count--;
+                    }
+                }
+            }
+            remainingIndices -= size_t(removed) * 3;
+            collapsed++;
+        }
+
+        if (collapsed == 0) {
+            break;
+        }
+
+        size_t kept = 0;
+        for (size_t t = 0; t < triangles.size(); t += 3) {
+            uint32_t a = remap[triangles[t]];
+            uint32_t b = remap[triangles[t + 1]];
+            uint32_t c = remap[triangles[t + 2]];
+            if (a != b && b != c && c != a) {
+                triangles[kept++] = a;
+                triangles[kept++] = b;
+                triangles[kept++] = c;
+            }
+        }
+        triangles.resize(kept);
+
+        // Every edge of a moved vertex now ends at its target, merging with the target's edge
+        // to the same neighbour.
+        for (EdgeCount& edge : edges) {
+            edge.key = makeEdgeKey(remap[getEdgeStart(edge.key)], remap[getEdgeEnd(edge.key)]);
+        }
+        mergeEdges(edges);
+    }
+
+    return std::vector<uint16_t>(triangles.begin(), triangles.end());
+}
+
+MeshLodChain buildMeshLods(const glm::vec3* positions, uint32_t vertexCount,
+                           const uint16_t* indices, uint32_t indexCount) {
+    MeshLodChain chain;
+    chain.indices.assign(indices, indices + indexCount);
+    chain.lodIndexCounts.push_back(indexCount);
+
+    glm::vec3 lower = vertexCount > 0 ? positions[0] : glm::vec3(0.0f);
+    glm::vec3 upper = lower;
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        lower = glm::min(lower, positions[v]);
+        upper = glm::max(upper, positions[v]);
+    }
+    glm::vec3 center = (lower + upper) * 0.5f;
+    float radius = 0.0f;
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        radius = std::max(radius, glm::distance(positions[v], center));
+    }
+    chain.boundingSphere = glm::vec4(center, radius);
+
+    std::vector<uint16_t> previous(indices, indices + indexCount);
+    float error = FIRST_LOD_ERROR * radius;
+    while (chain.lodIndexCounts.size() < MAX_MESH_LODS) {
+        uint32_t previousCount = static_cast<uint32_t>(previous.size());
+        uint32_t target = previousCount / 6 * 3;
+        std::vector<uint16_t> level
+            = simplifyMesh(positions, vertexCount, previous.data(), previousCount, target, error);
+        if (level.empty() || level.size() > previousCount * (1.0f - MIN_LOD_REDUCTION)) {
+            break;
+        }
+
+        chain.indices.insert(chain.indices.end(), level.begin(), level.end());
+        chain.lodIndexCounts.push_back(static_cast<uint32_t>(level.size()));
+        previous = std::move(level);
+        error *= 2.0f;
+    }
+
+    return chain;
+}
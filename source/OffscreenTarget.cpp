@@ -0,0 +1,106 @@
+#include "OffscreenTarget.h"
+
+#include "SceneResources.h"
+#include "ShaderRegistry.h"
+#include "VulkanDevice.h"
+
+void OffscreenTarget::create(const VulkanDevice& vulkanDevice, const SceneResources& scene,
+                             VkExtent2D extent, const RenderTargetOptions& options) {
+    this->vulkanDevice = &vulkanDevice;
+    this->scene = &scene;
+    this->extent = extent;
+    msaaSamples = vulkanDevice.getMaxUsableSampleCount(options.msaaSamples);
+    dynamicRendering = options.dynamicRendering && vulkanDevice.hasDynamicRendering();
+
+    vulkanDevice.createImage(extent.width, extent.height, VK_SAMPLE_COUNT_1_BIT, format,
+                             VK_IMAGE_TILING_OPTIMAL,
+                             VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory);
+    imageView = vulkanDevice.createImageView(image, format, VK_IMAGE_ASPECT_COLOR_BIT);
+
+    createRenderGraph();
+    createPipeline();
+    view.create(vulkanDevice, scene, 1, renderGraph.getImageView(shadowMap));
+}
+
+void OffscreenTarget::destroy() {
+    VkDevice device = vulkanDevice->getDevice();
+
+    view.destroy();
+    pipeline.destroy();
+    shadowPipeline.destroy();
+    renderGraph.destroy();
+    frameRendered = false;
+
+    vkDestroyImageView(device, imageView, nullptr);
+    vkDestroyImage(device, image, nullptr);
+    vkFreeMemory(device, imageMemory, nullptr);
+    imageView = VK_NULL_HANDLE;
+    image = VK_NULL_HANDLE;
+    imageMemory = VK_NULL_HANDLE;
+}
+
+void OffscreenTarget::renderFrame() {
+    view.updateUniformBuffer(0, extent);
+    view.updateInstances(0);
+
+    VkCommandBuffer commandBuffer = vulkanDevice->beginSingleTimeCommands();
+    renderGraph.execute(commandBuffer, 0);
+    vulkanDevice->endSingleTimeCommands(commandBuffer);
+    frameRendered = true;
+}
+
+bool OffscreenTarget::getLastFramePassTimes(std::vector<RenderGraphPassTime>& times) const {
+    return frameRendered && renderGraph.getPassTimes(0, times);
+}
+
+void OffscreenTarget::createRenderGraph() {
+    RenderGraphImageInfo outputInfo{};
+    outputInfo.format = format;
+    outputInfo.extent = extent;
+
+    // Previous contents are discarded; endSingleTimeCommands has already waited for any reader.
+    output = renderGraph.importImage(
+        "output", outputInfo,
+        {VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0},
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+    addLodPass(renderGraph).setExecute([this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        view.selectLods(commandBuffer, imageIndex);
+    });
+    shadowPass = &addShadowPass(renderGraph, vulkanDevice->findShadowMapFormat(), shadowMap);
+    shadowPass->setExecute([this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        view.drawShadowCasters(commandBuffer, shadowPipeline, imageIndex);
+    });
+
+    mainPass = &addScenePass(renderGraph, output, outputInfo, vulkanDevice->findDepthFormat(),
+                             msaaSamples, shadowMap);
+    mainPass->setExecute([this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        view.draw(commandBuffer, pipeline, imageIndex);
+    });
+
+    renderGraph.setDynamicRendering(dynamicRendering);
+    renderGraph.compile(vulkanDevice->getDevice(),
+                        vulkanDevice->getCapabilities().getMemoryProperties());
+    renderGraph.setImportedImage(output, image, imageView);
+    renderGraph.enableTimestamps(1, vulkanDevice->getTimestampPeriod());
+}
+
+void OffscreenTarget::createPipeline() {
+    GraphicsPipelineInfo info{};
+    info.vertexShader = getShaderCode("shader_depth_vert");
+    info.fragmentShader = getShaderCode("shader_depth_frag");
+    setPipelinePass(info, *mainPass);
+    info.descriptorSetLayout = scene->getDescriptorSetLayout();
+    info.samples = msaaSamples;
+
+    pipeline.create(*vulkanDevice, info);
+
+    GraphicsPipelineInfo shadowInfo{};
+    shadowInfo.vertexShader = getShaderCode("shadow_depth_vert");
+    shadowInfo.depthOnly = true;
+    setPipelinePass(shadowInfo, *shadowPass);
+    shadowInfo.descriptorSetLayout = scene->getDescriptorSetLayout();
+
+    shadowPipeline.create(*vulkanDevice, shadowInfo);
+}
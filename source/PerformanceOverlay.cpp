@@ -0,0 +1,421 @@
+#include "PerformanceOverlay.h"
+
+#include <backends/imgui_impl_glfw.h>
+#include <backends/imgui_impl_vulkan.h>
+#include <imgui.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+#include "SceneResources.h"
+#include "Swapchain.h"
+#include "VulkanDevice.h"
+#include "VulkanInstance.h"
+
+static const uint32_t MSAA_SAMPLE_COUNTS[] = {1, 2, 4, 8};
+
+static void checkImGuiResult(VkResult result) {
+    if (result < 0) {
+        throw std::runtime_error("failed to execute ImGui Vulkan backend call!");
+    }
+}
+
+static const char* getPresentModeName(VkPresentModeKHR presentMode) {
+    switch (presentMode) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR:
+            return "immediate";
+        case VK_PRESENT_MODE_MAILBOX_KHR:
+            return "mailbox";
+        case VK_PRESENT_MODE_FIFO_KHR:
+            return "fifo (vsync)";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+            return "fifo relaxed";
+        default:
+            return "other";
+    }
+}
+
+static double getMilliseconds(std::chrono::high_resolution_clock::time_point startTime,
+                              std::chrono::high_resolution_clock::time_point endTime) {
+    return std::chrono::duration<double, std::milli>(endTime - startTime).count();
+}
+
+void PerformanceOverlay::create(const VulkanInstance& instance, const VulkanDevice& vulkanDevice,
+                                GLFWwindow* window, VkFormat format, uint32_t imageCount) {
+    this->vulkanDevice = &vulkanDevice;
+    device = vulkanDevice.getDevice();
+
+    createRenderPass(format);
+    createDescriptorPool();
+    createCommandPool();
+
+    ImGui::CreateContext();
+    // Nothing about the overlay's layout is worth keeping between runs.
+    ImGui::GetIO().IniFilename = nullptr;
+    ImGui::StyleColorsDark();
+    ImGui_ImplGlfw_InitForVulkan(window, true);
+
+    // The backend cycles its vertex buffers per call rather than per image, so it needs one for
+    // every frame that can be in flight, whatever the swapchain's image count.
+    ImGui_ImplVulkan_InitInfo initInfo{};
+    initInfo.Instance = instance.getHandle();
+    initInfo.PhysicalDevice = vulkanDevice.getPhysicalDevice();
+    initInfo.Device = device;
+    initInfo.QueueFamily = vulkanDevice.getQueueFamily(QueueType::Graphics);
+    initInfo.Queue = vulkanDevice.getGraphicsQueue();
+    initInfo.PipelineCache = vulkanDevice.getPipelineCache();
+    initInfo.DescriptorPool = descriptorPool;
+    initInfo.MinImageCount = std::max(imageCount, 2u);
+    initInfo.ImageCount = std::max(imageCount, MAX_FRAMES_IN_FLIGHT);
+    initInfo.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
+    initInfo.CheckVkResultFn = checkImGuiResult;
+    if (!ImGui_ImplVulkan_Init(&initInfo, renderPass)) {
+        throw std::runtime_error("failed to initialize ImGui Vulkan backend!");
+    }
+
+    VkCommandBuffer commandBuffer = vulkanDevice.beginSingleTimeCommands();
+    ImGui_ImplVulkan_CreateFontsTexture(commandBuffer);
+    vulkanDevice.endSingleTimeCommands(commandBuffer);
+    ImGui_ImplVulkan_DestroyFontUploadObjects();
+
+    lastDrawTime = std::chrono::high_resolution_clock::now();
+}
+
+void PerformanceOverlay::destroy() {
+    destroySwapchainResources();
+
+    ImGui_ImplVulkan_Shutdown();
+    ImGui_ImplGlfw_Shutdown();
+    ImGui::DestroyContext();
+
+    vkDestroyCommandPool(device, commandPool, nullptr);
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    vkDestroyRenderPass(device, renderPass, nullptr);
+}
+
+void PerformanceOverlay::createRenderPass(VkFormat format) {
+    // Draws over the image the target left ready for presentation and leaves it that way.
+    VkAttachmentDescription colorAttachment{};
+    colorAttachment.format = format;
+    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    VkAttachmentReference colorAttachmentRef{};
+    colorAttachmentRef.attachment = 0;
+    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorAttachmentRef;
+
+    // The target's command buffer is submitted in the same batch, and whichever stage last wrote
+    // the image depends on its post-processing chain.
+    VkSubpassDependency dependency{};
+    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependency.dstSubpass = 0;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    dependency.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.dstAccessMask
+        = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &colorAttachment;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = 1;
+    renderPassInfo.pDependencies = &dependency;
+
+    if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create overlay render pass!");
+    }
+}
+
+void PerformanceOverlay::createDescriptorPool() {
+    // The font atlas is the only texture the overlay samples.
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSize.descriptorCount = 1;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = 1;
+
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create overlay descriptor pool!");
+    }
+}
+
+// Unlike the target's, the overlay's command buffers are recorded again every frame.
+void PerformanceOverlay::createCommandPool() {
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = vulkanDevice->getQueueFamily(QueueType::Graphics);
+
+    if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create overlay command pool!");
+    }
+}
+
+void PerformanceOverlay::createSwapchainResources(const Swapchain& swapchain) {
+    extent = swapchain.getExtent();
+    uint32_t imageCount = swapchain.getImageCount();
+
+    framebuffers.resize(imageCount);
+    for (uint32_t i = 0; i < imageCount; i++) {
+        VkImageView attachment = swapchain.getImageView(i);
+
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = renderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = &attachment;
+        framebufferInfo.width = extent.width;
+        framebufferInfo.height = extent.height;
+        framebufferInfo.layers = 1;
+
+        if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffers[i])
+            != VK_SUCCESS) {
+            throw std::runtime_error("failed to create overlay framebuffer!");
+        }
+    }
+
+    commandBuffers.resize(imageCount);
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = imageCount;
+
+    if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate overlay command buffers!");
+    }
+    imagesRecorded.assign(imageCount, 0);
+
+    if (vulkanDevice->getTimestampPeriod() > 0.0f) {
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = 2 * imageCount;
+
+        if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &timestampQueryPool)
+            != VK_SUCCESS) {
+            throw std::runtime_error("failed to create overlay timestamp query pool!");
+        }
+    }
+}
+
+void PerformanceOverlay::destroySwapchainResources() {
+    if (timestampQueryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device, timestampQueryPool, nullptr);
+        timestampQueryPool = VK_NULL_HANDLE;
+    }
+    if (!commandBuffers.empty()) {
+        vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()),
+                             commandBuffers.data());
+        commandBuffers.clear();
+    }
+    imagesRecorded.clear();
+    for (auto framebuffer : framebuffers) {
+        vkDestroyFramebuffer(device, framebuffer, nullptr);
+    }
+    framebuffers.clear();
+}
+
+bool PerformanceOverlay::draw(const RenderTarget& target, const SceneResources& scene,
+                              const std::vector<FramePhaseTime>& cpuPhases,
+                              RenderTargetOptions& options) {
+    auto startTime = std::chrono::high_resolution_clock::now();
+    cpuHistory[historyOffset] = static_cast<float>(getMilliseconds(lastDrawTime, startTime));
+    gpuHistory[historyOffset] = static_cast<float>(target.getRecentGpuTime());
+    historyOffset = (historyOffset + 1) % OVERLAY_HISTORY_FRAMES;
+    lastDrawTime = startTime;
+
+    ImGui_ImplVulkan_NewFrame();
+    ImGui_ImplGlfw_NewFrame();
+    ImGui::NewFrame();
+
+    ImGui::SetNextWindowPos(ImVec2(10.0f, 10.0f), ImGuiCond_Always);
+    ImGui::SetNextWindowBgAlpha(0.6f);
+    ImGui::Begin("performance", nullptr,
+                 ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize
+                     | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing
+                     | ImGuiWindowFlags_NoNav | ImGuiWindowFlags_NoMove);
+
+    // The newest sample is the one just before historyOffset.
+    uint32_t newest = (historyOffset + OVERLAY_HISTORY_FRAMES - 1) % OVERLAY_HISTORY_FRAMES;
+    ImGui::Text("%.1f fps", ImGui::GetIO().Framerate);
+    char latest[32];
+    std::snprintf(latest, sizeof(latest), "%.2f ms", cpuHistory[newest]);
+    ImGui::PlotLines("cpu", cpuHistory.data(), OVERLAY_HISTORY_FRAMES, historyOffset, latest,
+                     0.0f, FLT_MAX, ImVec2(0.0f, 40.0f));
+    std::snprintf(latest, sizeof(latest), "%.2f ms", gpuHistory[newest]);
+    ImGui::PlotLines("gpu", gpuHistory.data(), OVERLAY_HISTORY_FRAMES, historyOffset, latest,
+                     0.0f, FLT_MAX, ImVec2(0.0f, 40.0f));
+
+    if (ImGui::CollapsingHeader("cpu", ImGuiTreeNodeFlags_DefaultOpen)) {
+        for (const FramePhaseTime& phase : cpuPhases) {
+            ImGui::Text("%-12s %7.3f ms", phase.name.c_str(), phase.milliseconds);
+        }
+        // Last frame's, since this frame's is still being spent.
+        ImGui::Text("%-12s %7.3f ms", "overlay", cpuTime);
+    }
+
+    if (ImGui::CollapsingHeader("gpu", ImGuiTreeNodeFlags_DefaultOpen)) {
+        for (const RenderGraphPassTime& pass : target.getRecentPassTimes()) {
+            ImGui::Text("%-18s %7.3f ms", pass.name.c_str(), pass.milliseconds);
+        }
+        ImGui::Text("%-18s %7.3f ms", "overlay", gpuTime);
+    }
+
+    if (ImGui::CollapsingHeader("draws")) {
+        const RenderQueueStats& stats = target.getRenderQueueStats();
+        ImGui::Text("%u items, %u draws, %u draw calls", stats.items, stats.draws,
+                    stats.drawCalls);
+        ImGui::Text("binds: %u pipeline, %u descriptor set", stats.pipelineBinds,
+                    stats.descriptorSetBinds);
+        ImGui::Text("       %u vertex buffer, %u index buffer", stats.vertexBufferBinds,
+                    stats.indexBufferBinds);
+    }
+
+    if (ImGui::CollapsingHeader("memory")) {
+        const ResidencyStats& residency = scene.getResidency().getStats();
+        const RenderGraphStats& graphStats = target.getRenderGraphStats();
+        VirtualTextureStats textureStats = scene.getVirtualTexture().getStats();
+        ImGui::Text("device: %llu / %llu MiB", (unsigned long long)(residency.deviceUsage >> 20),
+                    (unsigned long long)(residency.deviceBudget >> 20));
+        ImGui::Text("textures: %llu / %llu MiB",
+                    (unsigned long long)(residency.residentBytes >> 20),
+                    (unsigned long long)(residency.budget >> 20));
+        ImGui::Text("attachments: %llu KiB, %llu KiB lazy",
+                    (unsigned long long)(graphStats.attachmentMemory >> 10),
+                    (unsigned long long)(graphStats.lazyAttachmentMemory >> 10));
+        ImGui::Text("tiles: %u / %u resident, %u pending uploads", textureStats.residentTiles,
+                    textureStats.residentLimit, textureStats.pendingLoads);
+    }
+
+    bool changed = false;
+    if (ImGui::CollapsingHeader("settings", ImGuiTreeNodeFlags_DefaultOpen)) {
+        const Swapchain& swapchain = target.getSwapchain();
+        if (ImGui::BeginCombo("present mode", getPresentModeName(swapchain.getPresentMode()))) {
+            for (VkPresentModeKHR presentMode : swapchain.getPresentModes()) {
+                bool selected = presentMode == swapchain.getPresentMode();
+                if (ImGui::Selectable(getPresentModeName(presentMode), selected) && !selected) {
+                    options.presentMode = presentMode;
+                    changed = true;
+                }
+                if (selected) {
+                    ImGui::SetItemDefaultFocus();
+                }
+            }
+            ImGui::EndCombo();
+        }
+
+        int framesInFlight = static_cast<int>(options.framesInFlight);
+        if (ImGui::SliderInt("frames in flight", &framesInFlight, 1, MAX_FRAMES_IN_FLIGHT)) {
+            options.framesInFlight = static_cast<uint32_t>(framesInFlight);
+            changed = true;
+        }
+
+        std::string preview = std::to_string(target.getSampleCount()) + "x";
+        if (ImGui::BeginCombo("msaa", preview.c_str())) {
+            for (uint32_t samples : MSAA_SAMPLE_COUNTS) {
+                if (vulkanDevice->getMaxUsableSampleCount(samples) != samples) {
+                    continue;
+                }
+                bool selected = samples == static_cast<uint32_t>(target.getSampleCount());
+                std::string label = std::to_string(samples) + "x";
+                if (ImGui::Selectable(label.c_str(), selected) && !selected) {
+                    options.msaaSamples = samples;
+                    changed = true;
+                }
+                if (selected) {
+                    ImGui::SetItemDefaultFocus();
+                }
+            }
+            ImGui::EndCombo();
+        }
+
+        if (vulkanDevice->hasDynamicRendering()
+            && ImGui::Checkbox("dynamic rendering", &options.dynamicRendering)) {
+            changed = true;
+        }
+    }
+
+    ImGui::End();
+    ImGui::Render();
+
+    cpuTime = getMilliseconds(startTime, std::chrono::high_resolution_clock::now());
+    return changed;
+}
+
+VkCommandBuffer PerformanceOverlay::record(uint32_t imageIndex) {
+    auto startTime = std::chrono::high_resolution_clock::now();
+    uint32_t firstQuery = 2 * imageIndex;
+
+    // The image's previous frame has finished, so its timestamps are ready without waiting.
+    uint64_t timestamps[2];
+    if (timestampQueryPool != VK_NULL_HANDLE && imagesRecorded[imageIndex]
+        && vkGetQueryPoolResults(device, timestampQueryPool, firstQuery, 2, sizeof(timestamps),
+                                 timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT)
+               == VK_SUCCESS) {
+        gpuTime = (timestamps[1] - timestamps[0]) * vulkanDevice->getTimestampPeriod() * 1e-6;
+    }
+
+    VkCommandBuffer commandBuffer = commandBuffers[imageIndex];
+    vkResetCommandBuffer(commandBuffer, 0);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording overlay command buffer!");
+    }
+
+    if (timestampQueryPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, timestampQueryPool, firstQuery, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool,
+                            firstQuery);
+    }
+
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = renderPass;
+    renderPassInfo.framebuffer = framebuffers[imageIndex];
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = extent;
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    // Nothing has been built before the first draw().
+    if (ImDrawData* drawData = ImGui::GetDrawData()) {
+        ImGui_ImplVulkan_RenderDrawData(drawData, commandBuffer);
+    }
+    vkCmdEndRenderPass(commandBuffer);
+
+    if (timestampQueryPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                            timestampQueryPool, firstQuery + 1);
+    }
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record overlay command buffer!");
+    }
+    imagesRecorded[imageIndex] = 1;
+
+    cpuTime += getMilliseconds(startTime, std::chrono::high_resolution_clock::now());
+    return commandBuffer;
+}
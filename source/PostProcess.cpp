@@ -0,0 +1,421 @@
+#include "PostProcess.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "GraphicsPipeline.h"
+#include "ShaderRegistry.h"
+#include "VulkanDevice.h"
+
+static const RenderGraphResource NO_RESOURCE = UINT32_MAX;
+
+static const uint32_t HISTOGRAM_BINS = 256;
+// Luminances from 2^-10 to 2^2 are told apart by the histogram.
+static const float MIN_LOG_LUMINANCE = -10.0f;
+static const float LOG_LUMINANCE_RANGE = 12.0f;
+// Fraction of the way to the measured luminance the exposure moves each frame.
+static const float EXPOSURE_ADAPTATION = 0.05f;
+// Size of the histogram bins followed by the adapted luminance and the exposure.
+static const VkDeviceSize EXPOSURE_STATE_SIZE = (HISTOGRAM_BINS + 2) * sizeof(uint32_t);
+
+static const uint32_t BLOOM_LEVELS = 6;
+// Exposed brightness above which pixels bloom.
+static const float BLOOM_THRESHOLD = 1.0f;
+static const float BLOOM_STRENGTH = 0.3f;
+
+static const char* const kernelShaders[] = {
+    "post_histogram_comp", "post_exposure_comp", "post_bloom_down_comp",
+    "post_bloom_up_comp",  "post_tonemap_comp",  "post_fxaa_comp",
+};
+
+static uint32_t getGroupCount(uint32_t size, uint32_t groupSize) {
+    return (size + groupSize - 1) / groupSize;
+}
+
+void PostProcessChain::create(const VulkanDevice& vulkanDevice) {
+    this->vulkanDevice = &vulkanDevice;
+    device = vulkanDevice.getDevice();
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    VkSampler sampler = vulkanDevice.getSampler(samplerInfo);
+
+    std::array<VkDescriptorSetLayoutBinding, 4> bindings{};
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    // Every input is sampled the same way, so the sampler is baked into the layout.
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].pImmutableSamplers = &sampler;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[1].pImmutableSamplers = &sampler;
+    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout)
+        != VK_SUCCESS) {
+        throw std::runtime_error("failed to create post-process descriptor set layout!");
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.size = sizeof(Dispatch::constants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout)
+        != VK_SUCCESS) {
+        throw std::runtime_error("failed to create post-process pipeline layout!");
+    }
+
+    createPipelines();
+    createExposureState();
+}
+
+void PostProcessChain::destroy() {
+    releaseDescriptors();
+    destroyPipelines();
+
+    vkDestroyBuffer(device, exposureState, nullptr);
+    vkFreeMemory(device, exposureStateMemory, nullptr);
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+
+    exposureState = VK_NULL_HANDLE;
+    exposureStateMemory = VK_NULL_HANDLE;
+    pipelineLayout = VK_NULL_HANDLE;
+    descriptorSetLayout = VK_NULL_HANDLE;
+    dispatches.clear();
+}
+
+void PostProcessChain::reloadPipelines() {
+    destroyPipelines();
+    createPipelines();
+}
+
+void PostProcessChain::createPipelines() {
+    for (uint32_t kernel = 0; kernel < KERNEL_COUNT; kernel++) {
+        VkShaderModule shaderModule
+            = createShaderModule(device, getShaderCode(kernelShaders[kernel]));
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = shaderModule;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = pipelineLayout;
+
+        VkResult result = vkCreateComputePipelines(device, vulkanDevice->getPipelineCache(), 1,
+                                                   &pipelineInfo, nullptr, &pipelines[kernel]);
+        vkDestroyShaderModule(device, shaderModule, nullptr);
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to create compute pipeline!");
+        }
+    }
+}
+
+void PostProcessChain::destroyPipelines() {
+    for (VkPipeline& pipeline : pipelines) {
+        vkDestroyPipeline(device, pipeline, nullptr);
+        pipeline = VK_NULL_HANDLE;
+    }
+}
+
+void PostProcessChain::createExposureState() {
+    vulkanDevice->createBuffer(
+        EXPOSURE_STATE_SIZE, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, exposureState, exposureStateMemory);
+
+    // A zero adapted luminance makes the first frame adopt its measured luminance directly.
+    VkCommandBuffer commandBuffer = vulkanDevice->beginSingleTimeCommands();
+    vkCmdFillBuffer(commandBuffer, exposureState, 0, EXPOSURE_STATE_SIZE, 0);
+    vulkanDevice->endSingleTimeCommands(commandBuffer);
+}
+
+void PostProcessChain::addPasses(RenderGraph& renderGraph, RenderGraphResource hdr,
+                                 RenderGraphResource output) {
+    dispatches.clear();
+    VkExtent2D extent = renderGraph.getImageInfo(hdr).extent;
+
+    addDispatch(renderGraph, "luminance histogram",
+                {Histogram,
+                 {hdr, NO_RESOURCE},
+                 NO_RESOURCE,
+                 {MIN_LOG_LUMINANCE, 1.0f / LOG_LUMINANCE_RANGE, 0.0f, 0.0f},
+                 getGroupCount(extent.width, 16),
+                 getGroupCount(extent.height, 16)})
+        .setSideEffects();
+    float pixelCount = static_cast<float>(extent.width) * extent.height;
+    addDispatch(renderGraph, "auto exposure",
+                {Exposure,
+                 {NO_RESOURCE, NO_RESOURCE},
+                 NO_RESOURCE,
+                 {MIN_LOG_LUMINANCE, LOG_LUMINANCE_RANGE, pixelCount, EXPOSURE_ADAPTATION}})
+        .setSideEffects();
+
+    // Every level halves the previous one, down to a few texels.
+    std::vector<RenderGraphResource> bloomLevels;
+    RenderGraphResource source = hdr;
+    VkExtent2D sourceExtent = extent;
+    for (uint32_t level = 0; level < BLOOM_LEVELS; level++) {
+        if (level > 0 && (sourceExtent.width < 4 || sourceExtent.height < 4)) {
+            break;
+        }
+
+        RenderGraphImageInfo info{};
+        info.format = HDR_COLOR_FORMAT;
+        info.extent = {std::max(sourceExtent.width / 2, 1u), std::max(sourceExtent.height / 2, 1u)};
+        std::string name = "bloom down " + std::to_string(level);
+        RenderGraphResource image = renderGraph.createImage(name, info);
+
+        float threshold = level == 0 ? BLOOM_THRESHOLD : 0.0f;
+        addDispatch(renderGraph, name,
+                    {BloomDown,
+                     {source, NO_RESOURCE},
+                     image,
+                     {1.0f / sourceExtent.width, 1.0f / sourceExtent.height, threshold, 0.0f},
+                     getGroupCount(info.extent.width, 8),
+                     getGroupCount(info.extent.height, 8)});
+
+        bloomLevels.push_back(image);
+        source = image;
+        sourceExtent = info.extent;
+    }
+
+    RenderGraphResource bloom = bloomLevels.back();
+    VkExtent2D bloomExtent = sourceExtent;
+    for (size_t level = bloomLevels.size() - 1; level-- > 0;) {
+        RenderGraphImageInfo info = renderGraph.getImageInfo(bloomLevels[level]);
+        std::string name = "bloom up " + std::to_string(level);
+        RenderGraphResource image = renderGraph.createImage(name, info);
+
+        addDispatch(renderGraph, name,
+                    {BloomUp,
+                     {bloom, bloomLevels[level]},
+                     image,
+                     {1.0f / bloomExtent.width, 1.0f / bloomExtent.height, 0.0f, 0.0f},
+                     getGroupCount(info.extent.width, 8),
+                     getGroupCount(info.extent.height, 8)});
+
+        bloom = image;
+        bloomExtent = info.extent;
+    }
+
+    RenderGraphImageInfo ldrInfo{};
+    ldrInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    ldrInfo.extent = extent;
+    RenderGraphResource ldr = renderGraph.createImage("ldr", ldrInfo);
+    addDispatch(renderGraph, "tonemap",
+                {Tonemap,
+                 {hdr, bloom},
+                 ldr,
+                 {BLOOM_STRENGTH, 0.0f, 0.0f, 0.0f},
+                 getGroupCount(extent.width, 8),
+                 getGroupCount(extent.height, 8)});
+
+    RenderGraphImageInfo finalInfo{};
+    finalInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    finalInfo.extent = extent;
+    RenderGraphResource final = renderGraph.createImage("antialiased", finalInfo);
+    addDispatch(renderGraph, "fxaa",
+                {Fxaa,
+                 {ldr, NO_RESOURCE},
+                 final,
+                 {1.0f / extent.width, 1.0f / extent.height, 0.0f, 0.0f},
+                 getGroupCount(extent.width, 8),
+                 getGroupCount(extent.height, 8)});
+
+    // The blit converts to the output's format, usually sRGB encoding on the way.
+    renderGraph.addPass("output blit")
+        .readTransfer(final)
+        .writeTransfer(output)
+        .setExecute([&renderGraph, final, output, extent](VkCommandBuffer commandBuffer,
+                                                          uint32_t) {
+            VkImageBlit region{};
+            region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+            region.srcOffsets[1] = {static_cast<int32_t>(extent.width),
+                                    static_cast<int32_t>(extent.height), 1};
+            region.dstSubresource = region.srcSubresource;
+            region.dstOffsets[1] = region.srcOffsets[1];
+            vkCmdBlitImage(commandBuffer, renderGraph.getImage(final),
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, renderGraph.getImage(output),
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_NEAREST);
+        });
+}
+
+RenderGraphPass& PostProcessChain::addDispatch(RenderGraph& renderGraph, const std::string& name,
+                                               Dispatch dispatch) {
+    RenderGraphPass& pass = renderGraph.addPass(name, VK_PIPELINE_BIND_POINT_COMPUTE);
+    for (RenderGraphResource input : dispatch.inputs) {
+        if (input != NO_RESOURCE) {
+            pass.readTexture(input, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        }
+    }
+    if (dispatch.output != NO_RESOURCE) {
+        pass.writeStorage(dispatch.output, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    }
+
+    size_t index = dispatches.size();
+    dispatches.push_back(dispatch);
+    return pass.setExecute([this, index](VkCommandBuffer commandBuffer, uint32_t) {
+        recordDispatch(commandBuffer, dispatches[index]);
+    });
+}
+
+void PostProcessChain::updateDescriptors(const RenderGraph& renderGraph) {
+    releaseDescriptors();
+
+    uint32_t setCount = static_cast<uint32_t>(dispatches.size());
+    std::array<VkDescriptorPoolSize, 3> poolSizes{};
+    poolSizes[0] = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2 * setCount};
+    poolSizes[1] = {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount};
+    poolSizes[2] = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, setCount};
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = setCount;
+
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create post-process descriptor pool!");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(setCount, descriptorSetLayout);
+    std::vector<VkDescriptorSet> sets(setCount);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = setCount;
+    allocInfo.pSetLayouts = layouts.data();
+
+    if (vkAllocateDescriptorSets(device, &allocInfo, sets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate post-process descriptor sets!");
+    }
+
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = exposureState;
+    bufferInfo.offset = 0;
+    bufferInfo.range = EXPOSURE_STATE_SIZE;
+
+    for (uint32_t i = 0; i < setCount; i++) {
+        Dispatch& dispatch = dispatches[i];
+        dispatch.descriptorSet = sets[i];
+
+        // Bindings the kernel does not use are left unwritten.
+        std::array<VkDescriptorImageInfo, 3> imageInfos{};
+        std::vector<VkWriteDescriptorSet> writes;
+        auto addWrite = [&](uint32_t binding, VkDescriptorType type) {
+            VkWriteDescriptorSet write{};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = dispatch.descriptorSet;
+            write.dstBinding = binding;
+            write.descriptorCount = 1;
+            write.descriptorType = type;
+            if (type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER) {
+                write.pBufferInfo = &bufferInfo;
+            } else {
+                write.pImageInfo = &imageInfos[binding];
+            }
+            writes.push_back(write);
+        };
+
+        for (uint32_t binding = 0; binding < dispatch.inputs.size(); binding++) {
+            if (dispatch.inputs[binding] != NO_RESOURCE) {
+                imageInfos[binding]
+                    = {VK_NULL_HANDLE, renderGraph.getImageView(dispatch.inputs[binding]),
+                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+                addWrite(binding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+            }
+        }
+        if (dispatch.output != NO_RESOURCE) {
+            imageInfos[2] = {VK_NULL_HANDLE, renderGraph.getImageView(dispatch.output),
+                             VK_IMAGE_LAYOUT_GENERAL};
+            addWrite(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+        }
+        addWrite(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0,
+                               nullptr);
+    }
+}
+
+void PostProcessChain::releaseDescriptors() {
+    if (descriptorPool != VK_NULL_HANDLE) {
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        descriptorPool = VK_NULL_HANDLE;
+    }
+    for (Dispatch& dispatch : dispatches) {
+        dispatch.descriptorSet = VK_NULL_HANDLE;
+    }
+}
+
+void PostProcessChain::recordDispatch(VkCommandBuffer commandBuffer,
+                                      const Dispatch& dispatch) const {
+    const VkPipelineStageFlags compute = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+    // The exposure state is shared by every frame in flight; queue order plus these barriers
+    // keep one frame's accesses from overlapping the next.
+    if (dispatch.kernel == Histogram) {
+        recordStateBarrier(commandBuffer, compute, VK_ACCESS_SHADER_WRITE_BIT,
+                           VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+        vkCmdFillBuffer(commandBuffer, exposureState, 0, HISTOGRAM_BINS * sizeof(uint32_t), 0);
+        recordStateBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           VK_ACCESS_TRANSFER_WRITE_BIT, compute,
+                           VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    } else if (dispatch.kernel == Exposure) {
+        recordStateBarrier(commandBuffer, compute, VK_ACCESS_SHADER_WRITE_BIT, compute,
+                           VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    }
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[dispatch.kernel]);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1,
+                            &dispatch.descriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(dispatch.constants), dispatch.constants.data());
+    vkCmdDispatch(commandBuffer, dispatch.groupsX, dispatch.groupsY, 1);
+
+    // Bloom and tonemapping read the new exposure.
+    if (dispatch.kernel == Exposure) {
+        recordStateBarrier(commandBuffer, compute, VK_ACCESS_SHADER_WRITE_BIT, compute,
+                           VK_ACCESS_SHADER_READ_BIT);
+    }
+}
+
+void PostProcessChain::recordStateBarrier(VkCommandBuffer commandBuffer,
+                                          VkPipelineStageFlags srcStages, VkAccessFlags srcAccess,
+                                          VkPipelineStageFlags dstStages,
+                                          VkAccessFlags dstAccess) const {
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = exposureState;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr, 1, &barrier, 0,
+                         nullptr);
+}
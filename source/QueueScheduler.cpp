@@ -0,0 +1,242 @@
+#include "QueueScheduler.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+void QueueScheduler::create(const VulkanDevice& vulkanDevice) {
+    this->vulkanDevice = &vulkanDevice;
+    device = vulkanDevice.getDevice();
+}
+
+void QueueScheduler::destroy() {
+    waitIdle();
+
+    // Submissions that were never flushed still own their command buffers.
+    for (const Submission& submission : submissions) {
+        if (submission.ownsCommandBuffer) {
+            vkFreeCommandBuffers(device, vulkanDevice->getCommandPool(submission.queueType), 1,
+                                 &submission.commandBuffer);
+        }
+        for (VkSemaphore semaphore : submission.waitSemaphores) {
+            freeSemaphores.push_back(semaphore);
+        }
+    }
+    submissions.clear();
+
+    for (const auto& begun : begunCommandBuffers) {
+        vkFreeCommandBuffers(device, vulkanDevice->getCommandPool(begun.first), 1, &begun.second);
+    }
+    begunCommandBuffers.clear();
+
+    for (VkSemaphore semaphore : freeSemaphores) {
+        vkDestroySemaphore(device, semaphore, nullptr);
+    }
+    freeSemaphores.clear();
+
+    for (VkFence fence : freeFences) {
+        vkDestroyFence(device, fence, nullptr);
+    }
+    freeFences.clear();
+}
+
+VkCommandBuffer QueueScheduler::beginCommands(QueueType queue) {
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = vulkanDevice->getCommandPool(queue);
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate command buffers!");
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    begunCommandBuffers.emplace_back(queue, commandBuffer);
+
+    return commandBuffer;
+}
+
+SubmissionHandle QueueScheduler::submit(QueueType queue, VkCommandBuffer commandBuffer,
+                                        const std::vector<SubmissionWait>& waits) {
+    Submission submission;
+    submission.queue = vulkanDevice->getQueue(queue);
+    submission.queueType = queue;
+    submission.commandBuffer = commandBuffer;
+
+    auto begun = std::find_if(begunCommandBuffers.begin(), begunCommandBuffers.end(),
+                              [commandBuffer](const std::pair<QueueType, VkCommandBuffer>& entry) {
+                                  return entry.second == commandBuffer;
+                              });
+    if (begun != begunCommandBuffers.end()) {
+        if (vulkanDevice->getQueueFamily(begun->first) != vulkanDevice->getQueueFamily(queue)) {
+            throw std::runtime_error("command buffer submitted to another queue family!");
+        }
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
+        }
+        submission.queueType = begun->first;
+        submission.ownsCommandBuffer = true;
+        begunCommandBuffers.erase(begun);
+    }
+
+    for (const SubmissionWait& wait : waits) {
+        if (wait.submission.flushIndex != flushIndex
+            || wait.submission.index >= submissions.size()) {
+            throw std::runtime_error("submission waits on work from an earlier flush!");
+        }
+
+        VkSemaphore semaphore = acquireSemaphore();
+        submissions[wait.submission.index].signalSemaphores.push_back(semaphore);
+        submission.waitSources.push_back(wait.submission.index);
+        submission.waitSemaphores.push_back(semaphore);
+        submission.waitStages.push_back(wait.stages);
+    }
+
+    submissions.push_back(std::move(submission));
+
+    return {static_cast<uint32_t>(submissions.size() - 1), flushIndex};
+}
+
+uint64_t QueueScheduler::flush() {
+    recycle(false);
+
+    // A binary semaphore wait must be submitted after its signal, so a batch another queue waits
+    // on is submitted as soon as the waiting submission is reached. Submissions are walked in the
+    // order they were made, which every wait follows, so this never reorders work on one queue.
+    for (size_t i = 0; i < submissions.size(); i++) {
+        for (uint32_t source : submissions[i].waitSources) {
+            if (!submissions[source].submitted
+                && submissions[source].queue != submissions[i].queue) {
+                submitQueue(submissions[source].queue, i);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < submissions.size(); i++) {
+        if (!submissions[i].submitted) {
+            submitQueue(submissions[i].queue, submissions.size());
+        }
+    }
+
+    submissions.clear();
+    return flushIndex++;
+}
+
+void QueueScheduler::waitIdle() { recycle(true); }
+
+bool QueueScheduler::isIdle() {
+    recycle(false);
+    return inFlight.empty();
+}
+
+bool QueueScheduler::isFlushFinished(uint64_t index) {
+    recycle(false);
+    return std::none_of(inFlight.begin(), inFlight.end(), [index](const InFlightBatch& batch) {
+        return batch.flushIndex <= index;
+    });
+}
+
+// Submits every pending submission for queue before end as one batch.
+void QueueScheduler::submitQueue(VkQueue queue, size_t end) {
+    InFlightBatch batch;
+    std::vector<VkSubmitInfo> submitInfos;
+
+    for (size_t i = 0; i < end; i++) {
+        Submission& submission = submissions[i];
+        if (submission.submitted || submission.queue != queue) {
+            continue;
+        }
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.waitSemaphoreCount = static_cast<uint32_t>(submission.waitSemaphores.size());
+        submitInfo.pWaitSemaphores = submission.waitSemaphores.data();
+        submitInfo.pWaitDstStageMask = submission.waitStages.data();
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &submission.commandBuffer;
+        submitInfo.signalSemaphoreCount = static_cast<uint32_t>(submission.signalSemaphores.size());
+        submitInfo.pSignalSemaphores = submission.signalSemaphores.data();
+        submitInfos.push_back(submitInfo);
+
+        // A semaphore can be reused once the submission waiting on it has finished.
+        batch.semaphores.insert(batch.semaphores.end(), submission.waitSemaphores.begin(),
+                                submission.waitSemaphores.end());
+        if (submission.ownsCommandBuffer) {
+            batch.commandBuffers.emplace_back(submission.queueType, submission.commandBuffer);
+        }
+        submission.submitted = true;
+    }
+
+    batch.fence = acquireFence();
+    batch.flushIndex = flushIndex;
+    if (vkQueueSubmit(queue, static_cast<uint32_t>(submitInfos.size()), submitInfos.data(),
+                      batch.fence)
+        != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit queue batch!");
+    }
+
+    inFlight.push_back(std::move(batch));
+}
+
+void QueueScheduler::recycle(bool wait) {
+    auto finished = std::stable_partition(
+        inFlight.begin(), inFlight.end(), [this, wait](const InFlightBatch& batch) {
+            if (wait) {
+                vkWaitForFences(device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+                return false;
+            }
+            return vkGetFenceStatus(device, batch.fence) != VK_SUCCESS;
+        });
+
+    for (auto it = finished; it != inFlight.end(); ++it) {
+        vkResetFences(device, 1, &it->fence);
+        freeFences.push_back(it->fence);
+        freeSemaphores.insert(freeSemaphores.end(), it->semaphores.begin(), it->semaphores.end());
+        for (const auto& commandBuffer : it->commandBuffers) {
+            vkFreeCommandBuffers(device, vulkanDevice->getCommandPool(commandBuffer.first), 1,
+                                 &commandBuffer.second);
+        }
+    }
+    inFlight.erase(finished, inFlight.end());
+}
+
+VkSemaphore QueueScheduler::acquireSemaphore() {
+    if (!freeSemaphores.empty()) {
+        VkSemaphore semaphore = freeSemaphores.back();
+        freeSemaphores.pop_back();
+        return semaphore;
+    }
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    VkSemaphore semaphore;
+    if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create semaphore!");
+    }
+
+    return semaphore;
+}
+
+VkFence QueueScheduler::acquireFence() {
+    if (!freeFences.empty()) {
+        VkFence fence = freeFences.back();
+        freeFences.pop_back();
+        return fence;
+    }
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    VkFence fence;
+    if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create fence!");
+    }
+
+    return fence;
+}
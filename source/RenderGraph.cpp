@@ -0,0 +1,1063 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+ImageSyncState getLayoutSyncState(VkImageLayout layout) {
+    switch (layout) {
+        case VK_IMAGE_LAYOUT_UNDEFINED:
+            return {layout, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0};
+        case VK_IMAGE_LAYOUT_GENERAL:
+            return {layout, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                    VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT};
+        case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+            return {layout, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT};
+        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+            return {layout,
+                    VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT
+                        | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT
+                        | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT};
+        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+            return {layout,
+                    VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT
+                        | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT
+                        | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_SHADER_READ_BIT};
+        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+            return {layout,
+                    VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                    VK_ACCESS_SHADER_READ_BIT};
+        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+            return {layout, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT};
+        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+            return {layout, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT};
+        case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+            return {layout, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0};
+        default:
+            throw std::runtime_error("unsupported layout transition!");
+    }
+}
+
+VkImageAspectFlags getImageAspectFlags(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT;
+        case VK_FORMAT_S8_UINT:
+            return VK_IMAGE_ASPECT_STENCIL_BIT;
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        default:
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+static bool findMemoryType(const VkPhysicalDeviceMemoryProperties& memProperties,
+                           uint32_t typeFilter, VkMemoryPropertyFlags properties,
+                           uint32_t& memoryTypeIndex) {
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i))
+            && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            memoryTypeIndex = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void RenderGraphPass::addAccess(RenderGraphResource resource, VkImageLayout layout,
+                                VkPipelineStageFlags stages, VkAccessFlags access,
+                                VkImageUsageFlags usage, bool read, bool write, bool discard) {
+    accesses.push_back({resource, {layout, stages, access}, usage, read, write, discard});
+}
+
+RenderGraphPass& RenderGraphPass::writeColor(RenderGraphResource resource,
+                                             VkAttachmentLoadOp loadOp, VkClearValue clearValue) {
+    bool load = loadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+    colorAttachments.push_back(
+        {resource, loadOp, clearValue, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+    if (!resolveAttachments.empty()) {
+        resolveAttachments.push_back({VK_ATTACHMENT_UNUSED, VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                                      VkClearValue{}, VK_IMAGE_LAYOUT_UNDEFINED});
+    }
+    addAccess(resource, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+              VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+              VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+                  | (load ? VK_ACCESS_COLOR_ATTACHMENT_READ_BIT : 0),
+              VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, load, true, !load);
+    return *this;
+}
+
+RenderGraphPass& RenderGraphPass::writeDepthStencil(RenderGraphResource resource,
+                                                    VkAttachmentLoadOp loadOp,
+                                                    VkClearValue clearValue) {
+    bool load = loadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+    depthAttachment.push_back(
+        {resource, loadOp, clearValue, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL});
+    addAccess(resource, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+              VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT
+                  | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+              VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT
+                  | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+              VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, load, true, !load);
+    return *this;
+}
+
+RenderGraphPass& RenderGraphPass::resolveColor(RenderGraphResource source,
+                                               RenderGraphResource target) {
+    auto it = std::find_if(colorAttachments.begin(), colorAttachments.end(),
+                           [source](const Attachment& attachment) {
+                               return attachment.resource == source;
+                           });
+    if (it == colorAttachments.end()) {
+        throw std::runtime_error("resolve source is not a colour attachment of the pass!");
+    }
+
+    resolveAttachments.resize(colorAttachments.size(),
+                              {VK_ATTACHMENT_UNUSED, VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                               VkClearValue{}, VK_IMAGE_LAYOUT_UNDEFINED});
+    resolveAttachments[it - colorAttachments.begin()]
+        = {target, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VkClearValue{},
+           VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    addAccess(target, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+              VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+              VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, false, true, true);
+    return *this;
+}
+
+RenderGraphPass& RenderGraphPass::readDepthStencil(RenderGraphResource resource) {
+    depthAttachment.push_back({resource, VK_ATTACHMENT_LOAD_OP_LOAD, VkClearValue{},
+                               VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL});
+    addAccess(resource, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+              VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT
+                  | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+              VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+              VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, true, false);
+    return *this;
+}
+
+RenderGraphPass& RenderGraphPass::readTexture(RenderGraphResource resource,
+                                              VkPipelineStageFlags stages) {
+    addAccess(resource, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, stages,
+              VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_USAGE_SAMPLED_BIT, true, false);
+    return *this;
+}
+
+RenderGraphPass& RenderGraphPass::readStorage(RenderGraphResource resource,
+                                              VkPipelineStageFlags stages) {
+    addAccess(resource, VK_IMAGE_LAYOUT_GENERAL, stages, VK_ACCESS_SHADER_READ_BIT,
+              VK_IMAGE_USAGE_STORAGE_BIT, true, false);
+    return *this;
+}
+
+RenderGraphPass& RenderGraphPass::writeStorage(RenderGraphResource resource,
+                                               VkPipelineStageFlags stages) {
+    addAccess(resource, VK_IMAGE_LAYOUT_GENERAL, stages, VK_ACCESS_SHADER_WRITE_BIT,
+              VK_IMAGE_USAGE_STORAGE_BIT, false, true);
+    return *this;
+}
+
+RenderGraphPass& RenderGraphPass::readTransfer(RenderGraphResource resource) {
+    addAccess(resource, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+              VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, true, false);
+    return *this;
+}
+
+RenderGraphPass& RenderGraphPass::writeTransfer(RenderGraphResource resource) {
+    addAccess(resource, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+              VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_USAGE_TRANSFER_DST_BIT, false, true);
+    return *this;
+}
+
+RenderGraphPass& RenderGraphPass::setViewMask(uint32_t mask) {
+    viewMask = mask;
+    return *this;
+}
+
+RenderGraphPass& RenderGraphPass::setSideEffects() {
+    sideEffects = true;
+    return *this;
+}
+
+RenderGraphPass& RenderGraphPass::setExecute(RenderGraphExecuteFn callback) {
+    execute = std::move(callback);
+    return *this;
+}
+
+RenderGraphResource RenderGraph::importImage(const std::string& name,
+                                             const RenderGraphImageInfo& info,
+                                             ImageSyncState initialState,
+                                             VkImageLayout finalLayout) {
+    ImageResource resource{};
+    resource.name = name;
+    resource.info = info;
+    resource.imported = true;
+    resource.initialState = initialState;
+    resource.finalLayout = finalLayout;
+    images.push_back(resource);
+    return static_cast<RenderGraphResource>(images.size() - 1);
+}
+
+RenderGraphResource RenderGraph::createImage(const std::string& name,
+                                             const RenderGraphImageInfo& info) {
+    ImageResource resource{};
+    resource.name = name;
+    resource.info = info;
+    images.push_back(resource);
+    return static_cast<RenderGraphResource>(images.size() - 1);
+}
+
+RenderGraphPass& RenderGraph::addPass(const std::string& name, VkPipelineBindPoint bindPoint) {
+    passes.push_back(std::unique_ptr<RenderGraphPass>(new RenderGraphPass(name, bindPoint)));
+    return *passes.back();
+}
+
+void RenderGraph::compile(VkDevice device, const VkPhysicalDeviceMemoryProperties& memProperties) {
+    this->device = device;
+    stats = {};
+    stats.declaredPasses = static_cast<uint32_t>(passes.size());
+
+    cullPasses();
+
+    for (auto& pass : passes) {
+        if (pass->culled) {
+            stats.culledPasses++;
+            continue;
+        }
+        CompiledPass compiledPass{};
+        compiledPass.pass = pass.get();
+        compiledPasses.push_back(std::move(compiledPass));
+    }
+
+    computeLifetimes();
+    allocateImages(memProperties);
+    buildBarriers();
+
+    if (dynamicRendering) {
+        cmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(
+            vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR"));
+        cmdEndRendering = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(
+            vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR"));
+        if (cmdBeginRendering == nullptr || cmdEndRendering == nullptr) {
+            throw std::runtime_error("failed to load dynamic rendering commands!");
+        }
+    }
+
+    for (auto& compiledPass : compiledPasses) {
+        compiledPass.rendering = compiledPass.pass->bindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS
+                                 && !compiledPass.attachmentResources.empty();
+        if (!compiledPass.rendering) {
+            continue;
+        }
+
+        checkResolves(*compiledPass.pass);
+        if (dynamicRendering) {
+            setRenderingFormats(compiledPass);
+        } else {
+            createRenderPass(compiledPass);
+        }
+    }
+}
+
+void RenderGraph::cullPasses() {
+    // Walk the passes backwards from the graph outputs. A pass survives when it writes something
+    // that is still needed later; a write that discards the previous contents ends the need for
+    // earlier writers of that image, and every read makes the image needed again.
+    std::vector<bool> needed(images.size(), false);
+    for (size_t i = 0; i < images.size(); i++) {
+        needed[i] = images[i].imported && images[i].finalLayout != VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+
+    for (auto it = passes.rbegin(); it != passes.rend(); ++it) {
+        RenderGraphPass& pass = **it;
+
+        bool alive = pass.sideEffects;
+        for (const auto& access : pass.accesses) {
+            if (access.write && needed[access.resource]) {
+                alive = true;
+            }
+        }
+
+        pass.culled = !alive;
+        if (!alive) {
+            continue;
+        }
+
+        // Attachment contents only have to reach memory when a later pass consumes them.
+        for (auto& attachment : pass.colorAttachments) {
+            attachment.store = needed[attachment.resource];
+            images[attachment.resource].stored |= attachment.store;
+        }
+        for (auto& attachment : pass.depthAttachment) {
+            attachment.store = needed[attachment.resource];
+            images[attachment.resource].stored |= attachment.store;
+        }
+        for (auto& attachment : pass.resolveAttachments) {
+            if (attachment.resource != VK_ATTACHMENT_UNUSED) {
+                images[attachment.resource].stored = true;
+            }
+        }
+
+        for (const auto& access : pass.accesses) {
+            if (access.write && access.discard) {
+                needed[access.resource] = false;
+            }
+        }
+        for (const auto& access : pass.accesses) {
+            if (access.read) {
+                needed[access.resource] = true;
+            }
+        }
+    }
+}
+
+void RenderGraph::computeLifetimes() {
+    for (uint32_t passIndex = 0; passIndex < compiledPasses.size(); passIndex++) {
+        CompiledPass& compiledPass = compiledPasses[passIndex];
+        for (const auto& access : compiledPass.pass->accesses) {
+            ImageResource& image = images[access.resource];
+            image.firstPass = std::min(image.firstPass, passIndex);
+            image.lastPass = std::max(image.lastPass, passIndex);
+            image.usage |= access.usage;
+        }
+
+        for (const auto& attachment : compiledPass.pass->colorAttachments) {
+            compiledPass.attachmentResources.push_back(attachment.resource);
+            compiledPass.clearValues.push_back(attachment.clearValue);
+        }
+        for (const auto& attachment : compiledPass.pass->depthAttachment) {
+            compiledPass.attachmentResources.push_back(attachment.resource);
+            compiledPass.clearValues.push_back(attachment.clearValue);
+        }
+        for (const auto& attachment : compiledPass.pass->resolveAttachments) {
+            if (attachment.resource != VK_ATTACHMENT_UNUSED) {
+                compiledPass.attachmentResources.push_back(attachment.resource);
+                compiledPass.clearValues.push_back(attachment.clearValue);
+            }
+        }
+        if (!compiledPass.attachmentResources.empty()) {
+            const RenderGraphImageInfo& info = images[compiledPass.attachmentResources[0]].info;
+            compiledPass.extent = info.extent;
+            // Multiview framebuffers have one layer; the view mask picks the attachment layers.
+            compiledPass.layers = compiledPass.pass->viewMask != 0 ? 1 : info.layers;
+        }
+    }
+}
+
+void RenderGraph::allocateImages(const VkPhysicalDeviceMemoryProperties& memProperties) {
+    std::vector<RenderGraphResource> ownedImages;
+    for (RenderGraphResource i = 0; i < images.size(); i++) {
+        ImageResource& resource = images[i];
+        if (resource.imported || resource.firstPass == UINT32_MAX) {
+            continue;
+        }
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = resource.info.extent.width;
+        imageInfo.extent.height = resource.info.extent.height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = resource.info.layers;
+        imageInfo.format = resource.info.format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = resource.usage;
+        imageInfo.samples = resource.info.samples;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        // Attachments whose contents never leave the render pass can live in tile memory.
+        const VkImageUsageFlags attachmentUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+                                                  | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+                                                  | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+        if (!resource.stored && (resource.usage & ~attachmentUsage) == 0) {
+            imageInfo.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+            resource.transient = true;
+        }
+
+        if (vkCreateImage(device, &imageInfo, nullptr, &resource.image) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create render graph image!");
+        }
+
+        vkGetImageMemoryRequirements(device, resource.image, &resource.memoryRequirements);
+        stats.unaliasedAttachmentMemory += resource.memoryRequirements.size;
+        ownedImages.push_back(i);
+    }
+
+    for (uint32_t passIndex = 0; passIndex < compiledPasses.size(); passIndex++) {
+        VkDeviceSize liveMemory = 0;
+        for (RenderGraphResource i : ownedImages) {
+            if (images[i].firstPass <= passIndex && passIndex <= images[i].lastPass) {
+                liveMemory += images[i].memoryRequirements.size;
+            }
+        }
+        stats.peakLiveAttachmentMemory = std::max(stats.peakLiveAttachmentMemory, liveMemory);
+    }
+
+    // Largest first, each image goes into the first memory slot whose current users are all
+    // dead before it starts or born after it ends.
+    std::sort(ownedImages.begin(), ownedImages.end(),
+              [this](RenderGraphResource a, RenderGraphResource b) {
+                  return images[a].memoryRequirements.size > images[b].memoryRequirements.size;
+              });
+
+    for (RenderGraphResource i : ownedImages) {
+        ImageResource& resource = images[i];
+        const VkMemoryRequirements& requirements = resource.memoryRequirements;
+
+        uint32_t memoryTypeIndex;
+        bool lazy = resource.transient
+                    && findMemoryType(memProperties, requirements.memoryTypeBits,
+                                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+                                          | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+                                      memoryTypeIndex);
+
+        uint32_t slotIndex = 0;
+        for (; slotIndex < memorySlots.size(); slotIndex++) {
+            const MemorySlot& slot = memorySlots[slotIndex];
+            if (slot.lazy != lazy
+                || !findMemoryType(memProperties, slot.memoryTypeBits & requirements.memoryTypeBits,
+                                   slot.properties, memoryTypeIndex)) {
+                continue;
+            }
+
+            bool overlaps = false;
+            for (RenderGraphResource other : slot.resources) {
+                if (!(resource.lastPass < images[other].firstPass
+                      || images[other].lastPass < resource.firstPass)) {
+                    overlaps = true;
+                    break;
+                }
+            }
+            if (!overlaps) {
+                break;
+            }
+        }
+
+        if (slotIndex == memorySlots.size()) {
+            MemorySlot slot{};
+            slot.lazy = lazy;
+            slot.properties = lazy ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+                                         | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT
+                                   : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            memorySlots.push_back(slot);
+        }
+
+        MemorySlot& slot = memorySlots[slotIndex];
+        slot.size = std::max(slot.size, requirements.size);
+        slot.alignment = std::max(slot.alignment, requirements.alignment);
+        slot.memoryTypeBits &= requirements.memoryTypeBits;
+        slot.resources.push_back(i);
+        resource.memorySlot = slotIndex;
+    }
+
+    for (auto& slot : memorySlots) {
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = slot.size;
+        if (!findMemoryType(memProperties, slot.memoryTypeBits, slot.properties,
+                            allocInfo.memoryTypeIndex)) {
+            throw std::runtime_error("failed to find suitable memory type!");
+        }
+
+        if (vkAllocateMemory(device, &allocInfo, nullptr, &slot.memory) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate render graph memory!");
+        }
+
+        // Lazily allocated memory is only committed on demand, usually never on tilers.
+        if (slot.lazy) {
+            stats.lazyAttachmentMemory += slot.size;
+        } else {
+            stats.attachmentMemory += slot.size;
+        }
+
+        for (RenderGraphResource i : slot.resources) {
+            vkBindImageMemory(device, images[i].image, slot.memory, 0);
+        }
+
+        std::sort(slot.resources.begin(), slot.resources.end(),
+                  [this](RenderGraphResource a, RenderGraphResource b) {
+                      return images[a].firstPass < images[b].firstPass;
+                  });
+    }
+
+    for (RenderGraphResource i : ownedImages) {
+        ImageResource& resource = images[i];
+
+        VkImageAspectFlags aspectFlags = getImageAspectFlags(resource.info.format);
+        if ((resource.usage & VK_IMAGE_USAGE_SAMPLED_BIT)
+            && (aspectFlags & VK_IMAGE_ASPECT_DEPTH_BIT)) {
+            aspectFlags = VK_IMAGE_ASPECT_DEPTH_BIT;
+        }
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = resource.image;
+        viewInfo.viewType
+            = resource.info.layers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = resource.info.format;
+        viewInfo.subresourceRange.aspectMask = aspectFlags;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = resource.info.layers;
+
+        if (vkCreateImageView(device, &viewInfo, nullptr, &resource.imageView) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create render graph image view!");
+        }
+    }
+}
+
+void RenderGraph::addBarrier(TrackedState& tracked, RenderGraphResource resource,
+                             const RenderGraphPass::Access& access, BarrierBatch& batch) {
+    const ImageSyncState& dst = access.state;
+    bool layoutChange = tracked.layout != dst.layout;
+
+    VkPipelineStageFlags srcStages;
+    VkAccessFlags srcAccess;
+    bool needed;
+    if (layoutChange || access.write) {
+        // Writes and transitions must wait for every earlier reader and writer.
+        srcStages = tracked.writeStages | tracked.readStages;
+        srcAccess = tracked.writeAccess;
+        needed = layoutChange || srcStages != 0;
+    } else {
+        // Reads in an unchanged layout only wait on the last write, and only once per stage.
+        bool covered = (tracked.readStages & dst.stages) == dst.stages
+                       && (tracked.readAccess & dst.access) == dst.access;
+        srcStages = tracked.writeStages;
+        srcAccess = tracked.writeAccess;
+        needed = !covered && srcStages != 0;
+    }
+
+    if (needed) {
+        if (srcStages != 0) {
+            batch.srcStages |= srcStages;
+        } else {
+            batch.srcStages |= VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        }
+        batch.dstStages |= dst.stages;
+
+        // Write-after-read in the same layout is an execution dependency only.
+        if (layoutChange || srcAccess != 0) {
+            const ImageResource& image = images[resource];
+
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.oldLayout = access.discard ? VK_IMAGE_LAYOUT_UNDEFINED : tracked.layout;
+            barrier.newLayout = dst.layout;
+            barrier.srcAccessMask = srcAccess;
+            barrier.dstAccessMask = dst.access;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = image.image;
+            barrier.subresourceRange.aspectMask = getImageAspectFlags(image.info.format);
+            barrier.subresourceRange.baseMipLevel = 0;
+            barrier.subresourceRange.levelCount = 1;
+            barrier.subresourceRange.baseArrayLayer = 0;
+            barrier.subresourceRange.layerCount = image.info.layers;
+
+            batch.imageBarriers.push_back(barrier);
+            batch.barrierResources.push_back(resource);
+        }
+    }
+
+    if (access.write) {
+        tracked = {dst.layout, dst.stages, dst.access, 0, 0};
+    } else if (layoutChange) {
+        tracked = {dst.layout, dst.stages, 0, dst.stages, dst.access};
+    } else {
+        tracked.readStages |= dst.stages;
+        tracked.readAccess |= dst.access;
+    }
+}
+
+void RenderGraph::buildBarriers() {
+    // The state a transient image is left in at the end of the frame is what the next user of
+    // its memory has to wait for: the following alias in the same slot, or the first user of the
+    // slot in the next frame.
+    std::vector<TrackedState> endStates(images.size());
+    for (auto& compiledPass : compiledPasses) {
+        for (const auto& access : compiledPass.pass->accesses) {
+            BarrierBatch scratch;
+            addBarrier(endStates[access.resource], access.resource, access, scratch);
+        }
+    }
+
+    std::vector<TrackedState> tracked(images.size());
+    for (size_t i = 0; i < images.size(); i++) {
+        if (images[i].imported) {
+            tracked[i].layout = images[i].initialState.layout;
+            tracked[i].writeStages = images[i].initialState.stages;
+            tracked[i].writeAccess = images[i].initialState.access;
+        }
+    }
+    for (const auto& slot : memorySlots) {
+        for (size_t i = 0; i < slot.resources.size(); i++) {
+            size_t previousIndex = (i + slot.resources.size() - 1) % slot.resources.size();
+            const TrackedState& previous = endStates[slot.resources[previousIndex]];
+            TrackedState& state = tracked[slot.resources[i]];
+            state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            state.writeStages = previous.writeStages | previous.readStages;
+            state.writeAccess = previous.writeAccess;
+        }
+    }
+
+    for (auto& compiledPass : compiledPasses) {
+        for (const auto& access : compiledPass.pass->accesses) {
+            addBarrier(tracked[access.resource], access.resource, access, compiledPass.barriers);
+        }
+        if (!compiledPass.barriers.empty()) {
+            stats.barrierBatches++;
+            stats.imageBarriers
+                += static_cast<uint32_t>(compiledPass.barriers.imageBarriers.size());
+        }
+    }
+
+    for (RenderGraphResource i = 0; i < images.size(); i++) {
+        if (!images[i].imported || images[i].finalLayout == VK_IMAGE_LAYOUT_UNDEFINED
+            || tracked[i].layout == images[i].finalLayout) {
+            continue;
+        }
+
+        RenderGraphPass::Access release{};
+        release.resource = i;
+        release.state = {images[i].finalLayout, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0};
+        release.read = true;
+        addBarrier(tracked[i], i, release, finalBarriers);
+    }
+    if (!finalBarriers.empty()) {
+        stats.barrierBatches++;
+        stats.imageBarriers += static_cast<uint32_t>(finalBarriers.imageBarriers.size());
+    }
+}
+
+void RenderGraph::checkResolves(const RenderGraphPass& pass) const {
+    for (size_t i = 0; i < pass.resolveAttachments.size(); i++) {
+        const RenderGraphPass::Attachment& attachment = pass.resolveAttachments[i];
+        if (attachment.resource == VK_ATTACHMENT_UNUSED) {
+            continue;
+        }
+
+        const RenderGraphImageInfo& source = images[pass.colorAttachments[i].resource].info;
+        const RenderGraphImageInfo& target = images[attachment.resource].info;
+        if (source.samples == VK_SAMPLE_COUNT_1_BIT || target.samples != VK_SAMPLE_COUNT_1_BIT
+            || source.format != target.format) {
+            throw std::runtime_error("failed to create render pass with invalid resolve!");
+        }
+    }
+}
+
+void RenderGraph::createRenderPass(CompiledPass& compiledPass) {
+    RenderGraphPass& pass = *compiledPass.pass;
+
+    std::vector<VkAttachmentDescription> attachments;
+    std::vector<VkAttachmentReference> colorRefs;
+    VkAttachmentReference depthRef{};
+
+    auto describe = [&](const RenderGraphPass::Attachment& attachment) {
+        const RenderGraphImageInfo& info = images[attachment.resource].info;
+        bool hasStencil = getImageAspectFlags(info.format) & VK_IMAGE_ASPECT_STENCIL_BIT;
+        VkAttachmentStoreOp storeOp
+            = attachment.store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+        // The graph has already moved the image into the subpass layout.
+        VkAttachmentDescription description{};
+        description.format = info.format;
+        description.samples = info.samples;
+        description.loadOp = attachment.loadOp;
+        description.storeOp = storeOp;
+        description.stencilLoadOp
+            = hasStencil ? attachment.loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        description.stencilStoreOp = hasStencil ? storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        description.initialLayout = attachment.layout;
+        description.finalLayout = attachment.layout;
+        attachments.push_back(description);
+
+        return VkAttachmentReference{static_cast<uint32_t>(attachments.size() - 1),
+                                     attachment.layout};
+    };
+
+    for (const auto& attachment : pass.colorAttachments) {
+        colorRefs.push_back(describe(attachment));
+    }
+    for (const auto& attachment : pass.depthAttachment) {
+        depthRef = describe(attachment);
+    }
+
+    // The multisampled data is resolved on chip and never has to be stored.
+    std::vector<VkAttachmentReference> resolveRefs;
+    for (const auto& attachment : pass.resolveAttachments) {
+        if (attachment.resource == VK_ATTACHMENT_UNUSED) {
+            resolveRefs.push_back({VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED});
+        } else {
+            resolveRefs.push_back(describe(attachment));
+        }
+    }
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = static_cast<uint32_t>(colorRefs.size());
+    subpass.pColorAttachments = colorRefs.data();
+    subpass.pResolveAttachments = resolveRefs.empty() ? nullptr : resolveRefs.data();
+    subpass.pDepthStencilAttachment = pass.depthAttachment.empty() ? nullptr : &depthRef;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderPassInfo.pAttachments = attachments.data();
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+
+    VkRenderPassMultiviewCreateInfo multiviewInfo{};
+    multiviewInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO;
+    multiviewInfo.subpassCount = 1;
+    multiviewInfo.pViewMasks = &pass.viewMask;
+    if (pass.viewMask != 0) {
+        renderPassInfo.pNext = &multiviewInfo;
+    }
+
+    if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &pass.renderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render pass!");
+    }
+}
+
+void RenderGraph::setRenderingFormats(CompiledPass& compiledPass) {
+    RenderGraphPass& pass = *compiledPass.pass;
+
+    pass.colorFormats.clear();
+    for (const auto& attachment : pass.colorAttachments) {
+        pass.colorFormats.push_back(images[attachment.resource].info.format);
+    }
+
+    pass.renderingInfo = {};
+    pass.renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+    pass.renderingInfo.viewMask = pass.viewMask;
+    pass.renderingInfo.colorAttachmentCount = static_cast<uint32_t>(pass.colorFormats.size());
+    pass.renderingInfo.pColorAttachmentFormats = pass.colorFormats.data();
+    for (const auto& attachment : pass.depthAttachment) {
+        VkFormat format = images[attachment.resource].info.format;
+        VkImageAspectFlags aspects = getImageAspectFlags(format);
+        if (aspects & VK_IMAGE_ASPECT_DEPTH_BIT) {
+            pass.renderingInfo.depthAttachmentFormat = format;
+        }
+        if (aspects & VK_IMAGE_ASPECT_STENCIL_BIT) {
+            pass.renderingInfo.stencilAttachmentFormat = format;
+        }
+    }
+}
+
+VkFramebuffer RenderGraph::getFramebuffer(CompiledPass& compiledPass) {
+    std::vector<VkImageView> views;
+    for (RenderGraphResource resource : compiledPass.attachmentResources) {
+        views.push_back(images[resource].imageView);
+    }
+
+    auto it = compiledPass.framebuffers.find(views);
+    if (it != compiledPass.framebuffers.end()) {
+        return it->second;
+    }
+
+    VkFramebufferCreateInfo framebufferInfo{};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = compiledPass.pass->renderPass;
+    framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+    framebufferInfo.pAttachments = views.data();
+    framebufferInfo.width = compiledPass.extent.width;
+    framebufferInfo.height = compiledPass.extent.height;
+    framebufferInfo.layers = compiledPass.layers;
+
+    VkFramebuffer framebuffer;
+    if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create framebuffer!");
+    }
+
+    compiledPass.framebuffers.emplace(views, framebuffer);
+    return framebuffer;
+}
+
+void RenderGraph::setImportedImage(RenderGraphResource resource, VkImage image,
+                                   VkImageView imageView) {
+    if (!images.at(resource).imported) {
+        throw std::runtime_error("render graph image is not imported!");
+    }
+
+    images[resource].image = image;
+    images[resource].imageView = imageView;
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, BarrierBatch& batch) {
+    if (batch.empty()) {
+        return;
+    }
+
+    // Imported images may be rebound between recordings.
+    for (size_t i = 0; i < batch.imageBarriers.size(); i++) {
+        batch.imageBarriers[i].image = images[batch.barrierResources[i]].image;
+    }
+
+    vkCmdPipelineBarrier(commandBuffer, batch.srcStages, batch.dstStages, 0, 0, nullptr, 0,
+                         nullptr, static_cast<uint32_t>(batch.imageBarriers.size()),
+                         batch.imageBarriers.data());
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+    uint32_t queryCount = static_cast<uint32_t>(compiledPasses.size()) + 1;
+    bool timed = timestampQueryPool != VK_NULL_HANDLE && imageIndex < timestampRecordings
+                 && queryCount == timestampQueryCount;
+    uint32_t query = imageIndex * queryCount;
+    if (timed) {
+        vkCmdResetQueryPool(commandBuffer, timestampQueryPool, query, queryCount);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool,
+                            query++);
+    }
+
+    for (auto& compiledPass : compiledPasses) {
+        RenderGraphPass& pass = *compiledPass.pass;
+
+        recordBarriers(commandBuffer, compiledPass.barriers);
+
+        if (!compiledPass.rendering) {
+            if (pass.execute) {
+                pass.execute(commandBuffer, imageIndex);
+            }
+        } else if (dynamicRendering) {
+            recordRendering(commandBuffer, compiledPass, imageIndex);
+        } else {
+            recordRenderPass(commandBuffer, compiledPass, imageIndex);
+        }
+
+        // A pass's time includes its barriers and ends when all of its work has completed.
+        if (timed) {
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                timestampQueryPool, query++);
+        }
+    }
+
+    recordBarriers(commandBuffer, finalBarriers);
+}
+
+// Pipelines leave the viewport and scissor dynamic, so they do not depend on the extent.
+static void setViewport(VkCommandBuffer commandBuffer, VkExtent2D extent) {
+    VkViewport viewport{};
+    viewport.width = static_cast<float>(extent.width);
+    viewport.height = static_cast<float>(extent.height);
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor{};
+    scissor.extent = extent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+void RenderGraph::recordRenderPass(VkCommandBuffer commandBuffer, CompiledPass& compiledPass,
+                                   uint32_t imageIndex) {
+    RenderGraphPass& pass = *compiledPass.pass;
+
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = pass.renderPass;
+    renderPassInfo.framebuffer = getFramebuffer(compiledPass);
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = compiledPass.extent;
+    renderPassInfo.clearValueCount = static_cast<uint32_t>(compiledPass.clearValues.size());
+    renderPassInfo.pClearValues = compiledPass.clearValues.data();
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    setViewport(commandBuffer, compiledPass.extent);
+
+    if (pass.execute) {
+        pass.execute(commandBuffer, imageIndex);
+    }
+
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+void RenderGraph::recordRendering(VkCommandBuffer commandBuffer, CompiledPass& compiledPass,
+                                  uint32_t imageIndex) {
+    RenderGraphPass& pass = *compiledPass.pass;
+
+    // Views are looked up at record time, as imported images may be rebound between recordings.
+    // The graph has already moved every attachment into the layout the pass renders in.
+    auto attach = [this](const RenderGraphPass::Attachment& attachment) {
+        VkRenderingAttachmentInfoKHR info{};
+        info.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+        info.imageView = images[attachment.resource].imageView;
+        info.imageLayout = attachment.layout;
+        info.loadOp = attachment.loadOp;
+        info.storeOp
+            = attachment.store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        info.clearValue = attachment.clearValue;
+        return info;
+    };
+
+    std::vector<VkRenderingAttachmentInfoKHR> colorAttachments;
+    for (size_t i = 0; i < pass.colorAttachments.size(); i++) {
+        VkRenderingAttachmentInfoKHR info = attach(pass.colorAttachments[i]);
+        if (i < pass.resolveAttachments.size()
+            && pass.resolveAttachments[i].resource != VK_ATTACHMENT_UNUSED) {
+            const RenderGraphPass::Attachment& resolve = pass.resolveAttachments[i];
+            info.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT_KHR;
+            info.resolveImageView = images[resolve.resource].imageView;
+            info.resolveImageLayout = resolve.layout;
+        }
+        colorAttachments.push_back(info);
+    }
+
+    // The depth attachment is bound to each aspect its format has; pStencilAttachment stays
+    // null for depth-only formats.
+    VkRenderingAttachmentInfoKHR depthAttachment{};
+    VkImageAspectFlags depthAspects = 0;
+    if (!pass.depthAttachment.empty()) {
+        depthAttachment = attach(pass.depthAttachment[0]);
+        depthAspects = getImageAspectFlags(images[pass.depthAttachment[0].resource].info.format);
+    }
+
+    VkRenderingInfoKHR renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+    renderingInfo.renderArea.offset = {0, 0};
+    renderingInfo.renderArea.extent = compiledPass.extent;
+    renderingInfo.layerCount = compiledPass.layers;
+    renderingInfo.viewMask = pass.viewMask;
+    renderingInfo.colorAttachmentCount = static_cast<uint32_t>(colorAttachments.size());
+    renderingInfo.pColorAttachments = colorAttachments.data();
+    renderingInfo.pDepthAttachment
+        = (depthAspects & VK_IMAGE_ASPECT_DEPTH_BIT) ? &depthAttachment : nullptr;
+    renderingInfo.pStencilAttachment
+        = (depthAspects & VK_IMAGE_ASPECT_STENCIL_BIT) ? &depthAttachment : nullptr;
+
+    cmdBeginRendering(commandBuffer, &renderingInfo);
+    setViewport(commandBuffer, compiledPass.extent);
+
+    if (pass.execute) {
+        pass.execute(commandBuffer, imageIndex);
+    }
+
+    cmdEndRendering(commandBuffer);
+}
+
+void RenderGraph::enableTimestamps(uint32_t recordingCount, float timestampPeriod) {
+    if (timestampPeriod <= 0.0f || recordingCount == 0) {
+        return;
+    }
+
+    // A pool kept by clear() has the same layout when the counts match, so the results of
+    // frames recorded before still read back correctly.
+    uint32_t queryCount = static_cast<uint32_t>(compiledPasses.size()) + 1;
+    if (timestampQueryPool != VK_NULL_HANDLE
+        && (recordingCount != timestampRecordings || queryCount != timestampQueryCount)) {
+        vkDestroyQueryPool(device, timestampQueryPool, nullptr);
+        timestampQueryPool = VK_NULL_HANDLE;
+    }
+
+    if (timestampQueryPool == VK_NULL_HANDLE) {
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = recordingCount * queryCount;
+
+        if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &timestampQueryPool)
+            != VK_SUCCESS) {
+            throw std::runtime_error("failed to create render graph timestamp query pool!");
+        }
+    }
+    timestampRecordings = recordingCount;
+    timestampQueryCount = queryCount;
+    this->timestampPeriod = timestampPeriod;
+}
+
+bool RenderGraph::getPassTimes(uint32_t imageIndex, std::vector<RenderGraphPassTime>& times,
+                               bool wait) const {
+    uint32_t queryCount = static_cast<uint32_t>(compiledPasses.size()) + 1;
+    if (timestampQueryPool == VK_NULL_HANDLE || imageIndex >= timestampRecordings
+        || queryCount != timestampQueryCount) {
+        return false;
+    }
+
+    std::vector<uint64_t> timestamps(queryCount);
+    if (vkGetQueryPoolResults(device, timestampQueryPool, imageIndex * queryCount, queryCount,
+                              timestamps.size() * sizeof(uint64_t), timestamps.data(),
+                              sizeof(uint64_t),
+                              VK_QUERY_RESULT_64_BIT | (wait ? VK_QUERY_RESULT_WAIT_BIT : 0))
+        != VK_SUCCESS) {
+        return false;
+    }
+
+    times.clear();
+    for (size_t i = 0; i < compiledPasses.size(); i++) {
+        double milliseconds = (timestamps[i + 1] - timestamps[i]) * timestampPeriod * 1e-6;
+        times.push_back({compiledPasses[i].pass->getName(), milliseconds});
+    }
+    return true;
+}
+
+void RenderGraph::destroy() {
+    if (timestampQueryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device, timestampQueryPool, nullptr);
+    }
+    timestampQueryPool = VK_NULL_HANDLE;
+    timestampRecordings = 0;
+    timestampQueryCount = 0;
+
+    clear();
+    device = VK_NULL_HANDLE;
+}
+
+// Keeps device, which the kept query pool is destroyed with.
+void RenderGraph::clear() {
+    if (device != VK_NULL_HANDLE) {
+        for (auto& compiledPass : compiledPasses) {
+            for (auto& framebuffer : compiledPass.framebuffers) {
+                vkDestroyFramebuffer(device, framebuffer.second, nullptr);
+            }
+        }
+
+        for (auto& pass : passes) {
+            if (pass->renderPass != VK_NULL_HANDLE) {
+                vkDestroyRenderPass(device, pass->renderPass, nullptr);
+            }
+        }
+
+        for (auto& image : images) {
+            if (image.imported) {
+                continue;
+            }
+            if (image.imageView != VK_NULL_HANDLE) {
+                vkDestroyImageView(device, image.imageView, nullptr);
+            }
+            if (image.image != VK_NULL_HANDLE) {
+                vkDestroyImage(device, image.image, nullptr);
+            }
+        }
+
+        for (auto& slot : memorySlots) {
+            vkFreeMemory(device, slot.memory, nullptr);
+        }
+    }
+
+    images.clear();
+    passes.clear();
+    compiledPasses.clear();
+    memorySlots.clear();
+    finalBarriers = {};
+    stats = {};
+}
+
+VkImage RenderGraph::getImage(RenderGraphResource resource) const {
+    return images.at(resource).image;
+}
+
+VkImageView RenderGraph::getImageView(RenderGraphResource resource) const {
+    return images.at(resource).imageView;
+}
+
+const RenderGraphImageInfo& RenderGraph::getImageInfo(RenderGraphResource resource) const {
+    return images.at(resource).info;
+}
@@ -0,0 +1,263 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+// Sort key layout, most significant first: pass, pipeline, material, mesh, depth.
+static const uint32_t PASS_BITS = 4;
+static const uint32_t PIPELINE_BITS = 12;
+static const uint32_t MATERIAL_BITS = 16;
+static const uint32_t MESH_BITS = 12;
+static const uint32_t DEPTH_BITS = 20;
+
+static const uint32_t DEPTH_SHIFT = 0;
+static const uint32_t MESH_SHIFT = DEPTH_SHIFT + DEPTH_BITS;
+static const uint32_t MATERIAL_SHIFT = MESH_SHIFT + MESH_BITS;
+static const uint32_t PIPELINE_SHIFT = MATERIAL_SHIFT + MATERIAL_BITS;
+static const uint32_t PASS_SHIFT = PIPELINE_SHIFT + PIPELINE_BITS;
+static_assert(PASS_SHIFT + PASS_BITS == 64, "sort key fields must fill 64 bits");
+
+static const uint32_t RADIX_BITS = 8;
+static const uint32_t RADIX_BUCKETS = 1u << RADIX_BITS;
+// Below this many items per thread a radix pass is cheaper on one thread.
+static const size_t MIN_ITEMS_PER_THREAD = 4096;
+
+// Runs work(0..count-1), with every index after the first on its own thread.
+template <typename Work>
+static void runParallel(size_t count, const Work& work) {
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < count; i++) {
+        workers.emplace_back(work, i);
+    }
+    work(0);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+static bool canMerge(const RenderQueueItem& first, const RenderQueueItem& next,
+                     uint32_t instanceCount) {
+    return next.pipeline == first.pipeline && next.pipelineLayout == first.pipelineLayout
+           && next.descriptorSet == first.descriptorSet && next.vertexBuffer == first.vertexBuffer
+           && next.instanceBuffer == first.instanceBuffer && next.indexBuffer == first.indexBuffer
+           && next.indexType == first.indexType && next.indexCount == first.indexCount
+           && next.firstIndex == first.firstIndex && next.vertexOffset == first.vertexOffset
+           && next.firstInstance == first.firstInstance + instanceCount;
+}
+
+template <typename Handle>
+uint32_t RenderQueue::getStateId(std::map<Handle, uint32_t>& ids, Handle handle, uint32_t limit,
+                                 const char* what) {
+    auto it = ids.find(handle);
+    if (it != ids.end()) {
+        return it->second;
+    }
+
+    if (ids.size() >= limit) {
+        throw std::runtime_error(std::string("too many ") + what + " in render queue!");
+    }
+    uint32_t id = static_cast<uint32_t>(ids.size());
+    ids.emplace(handle, id);
+    return id;
+}
+
+void RenderQueue::clear() {
+    items.clear();
+    entries.clear();
+    pipelineIds.clear();
+    materialIds.clear();
+    meshIds.clear();
+}
+
+void RenderQueue::add(const RenderQueueItem& item) {
+    if (item.pass >= (1u << PASS_BITS)) {
+        throw std::runtime_error("render queue pass out of range!");
+    }
+
+    uint64_t pipeline = getStateId(pipelineIds, item.pipeline, 1u << PIPELINE_BITS, "pipelines");
+    uint64_t material
+        = getStateId(materialIds, item.descriptorSet, 1u << MATERIAL_BITS, "materials");
+    uint64_t mesh = getStateId(meshIds, std::make_pair(item.vertexBuffer, item.indexBuffer),
+                               1u << MESH_BITS, "meshes");
+
+    float depth = std::min(std::max(item.depth, 0.0f), 1.0f);
+    uint64_t quantizedDepth = static_cast<uint64_t>(depth * ((1u << DEPTH_BITS) - 1));
+
+    uint64_t key = static_cast<uint64_t>(item.pass) << PASS_SHIFT | pipeline << PIPELINE_SHIFT
+                   | material << MATERIAL_SHIFT | mesh << MESH_SHIFT
+                   | quantizedDepth << DEPTH_SHIFT;
+
+    entries.push_back({key, static_cast<uint32_t>(items.size())});
+    items.push_back(item);
+}
+
+// Least significant digit radix sort, 8 bits per pass. Each thread counts its own slice, the
+// counts are turned into per-thread output offsets, and every thread scatters its slice in
+// order, which keeps the sort stable. Passes where every key has the same digit are skipped.
+void RenderQueue::sort(uint32_t threadCount) {
+    size_t count = entries.size();
+    if (count < 2) {
+        return;
+    }
+
+    size_t threads
+        = std::max<size_t>(1, std::min<size_t>(threadCount, count / MIN_ITEMS_PER_THREAD));
+    size_t chunk = (count + threads - 1) / threads;
+    std::vector<std::array<size_t, RADIX_BUCKETS>> offsets(threads);
+    scratch.resize(count);
+
+    for (uint32_t shift = 0; shift < 64; shift += RADIX_BITS) {
+        runParallel(threads, [&](size_t t) {
+            offsets[t].fill(0);
+            size_t end = std::min(count, (t + 1) * chunk);
+            for (size_t i = t * chunk; i < end; i++) {
+                offsets[t][(entries[i].key >> shift) & (RADIX_BUCKETS - 1)]++;
+            }
+        });
+
+        size_t total = 0;
+        bool sorted = false;
+        for (uint32_t bucket = 0; bucket < RADIX_BUCKETS && !sorted; bucket++) {
+            size_t bucketStart = total;
+            for (size_t t = 0; t < threads; t++) {
+                size_t bucketCount = offsets[t][bucket];
+                offsets[t][bucket] = total;
+                total += bucketCount;
+            }
+            sorted = total - bucketStart == count;
+        }
+        if (sorted) {
+            continue;
+        }
+
+        runParallel(threads, [&](size_t t) {
+            size_t end = std::min(count, (t + 1) * chunk);
+            for (size_t i = t * chunk; i < end; i++) {
+                size_t& offset = offsets[t][(entries[i].key >> shift) & (RADIX_BUCKETS - 1)];
+                scratch[offset++] = entries[i];
+            }
+        });
+        entries.swap(scratch);
+    }
+}
+
+void RenderQueue::record(VkCommandBuffer commandBuffer, const RenderQueueIndirectBuffer* indirect) {
+    stats = {};
+    stats.items = static_cast<uint32_t>(items.size());
+    indirectItems.clear();
+
+    VkPipeline boundPipeline = VK_NULL_HANDLE;
+    VkPipelineLayout boundLayout = VK_NULL_HANDLE;
+    VkDescriptorSet boundDescriptorSet = VK_NULL_HANDLE;
+    VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+    VkBuffer boundInstanceBuffer = VK_NULL_HANDLE;
+    VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+    VkIndexType boundIndexType = VK_INDEX_TYPE_UINT16;
+
+    // Indirect commands written since the last state change.
+    uint32_t indirectCount = 0;
+    uint32_t indirectFirst = 0;
+
+    for (size_t i = 0; i < entries.size();) {
+        const RenderQueueItem& item = items[entries[i].item];
+
+        uint32_t instanceCount = item.instanceCount;
+        size_t next = i + 1;
+        while (next < entries.size() && canMerge(item, items[entries[next].item], instanceCount)) {
+            instanceCount += items[entries[next].item].instanceCount;
+            next++;
+        }
+
+        bool stateChanged = item.pipeline != boundPipeline
+                            || item.descriptorSet != boundDescriptorSet
+                            || item.pipelineLayout != boundLayout
+                            || item.vertexBuffer != boundVertexBuffer
+                            || item.instanceBuffer != boundInstanceBuffer
+                            || item.indexBuffer != boundIndexBuffer
+                            || item.indexType != boundIndexType;
+        if (stateChanged && indirectCount > 0) {
+            recordIndirectDraws(commandBuffer, *indirect, indirectFirst, indirectCount);
+            indirectFirst += indirectCount;
+            indirectCount = 0;
+        }
+
+        if (item.pipeline != boundPipeline) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, item.pipeline);
+            boundPipeline = item.pipeline;
+            stats.pipelineBinds++;
+        }
+
+        // Sets bound through a different layout are not guaranteed to stay compatible.
+        if (item.descriptorSet != boundDescriptorSet || item.pipelineLayout != boundLayout) {
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                    item.pipelineLayout, 0, 1, &item.descriptorSet, 0, nullptr);
+            boundDescriptorSet = item.descriptorSet;
+            boundLayout = item.pipelineLayout;
+            stats.descriptorSetBinds++;
+        }
+
+        if (item.vertexBuffer != boundVertexBuffer || item.instanceBuffer != boundInstanceBuffer) {
+            VkBuffer vertexBuffers[] = {item.vertexBuffer, item.instanceBuffer};
+            VkDeviceSize offsets[] = {0, 0};
+            vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+            boundVertexBuffer = item.vertexBuffer;
+            boundInstanceBuffer = item.instanceBuffer;
+            stats.vertexBufferBinds++;
+        }
+
+        if (item.indexBuffer != boundIndexBuffer || item.indexType != boundIndexType) {
+            vkCmdBindIndexBuffer(commandBuffer, item.indexBuffer, 0, item.indexType);
+            boundIndexBuffer = item.indexBuffer;
+            boundIndexType = item.indexType;
+            stats.indexBufferBinds++;
+        }
+
+        if (indirect != nullptr && indirectFirst + indirectCount < indirect->capacity) {
+            VkDrawIndexedIndirectCommand& command
+                = indirect->commands[indirectFirst + indirectCount++];
+            command.indexCount = item.indexCount;
+            command.instanceCount = instanceCount;
+            command.firstIndex = item.firstIndex;
+            command.vertexOffset = item.vertexOffset;
+            command.firstInstance = item.firstInstance;
+            indirectItems.push_back(entries[i].item);
+        } else {
+            if (indirectCount > 0) {
+                recordIndirectDraws(commandBuffer, *indirect, indirectFirst, indirectCount);
+                indirectFirst += indirectCount;
+                indirectCount = 0;
+            }
+            vkCmdDrawIndexed(commandBuffer, item.indexCount, instanceCount, item.firstIndex,
+                             item.vertexOffset, item.firstInstance);
+            stats.drawCalls++;
+        }
+        stats.draws++;
+
+        i = next;
+    }
+
+    if (indirectCount > 0) {
+        recordIndirectDraws(commandBuffer, *indirect, indirectFirst, indirectCount);
+    }
+}
+
+void RenderQueue::recordIndirectDraws(VkCommandBuffer commandBuffer,
+                                      const RenderQueueIndirectBuffer& indirect, uint32_t first,
+                                      uint32_t count) {
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    if (indirect.multiDraw) {
+        vkCmdDrawIndexedIndirect(commandBuffer, indirect.buffer,
+                                 indirect.offset + VkDeviceSize(first) * stride, count, stride);
+        stats.drawCalls++;
+        return;
+    }
+
+    for (uint32_t i = first; i < first + count; i++) {
+        vkCmdDrawIndexedIndirect(commandBuffer, indirect.buffer,
+                                 indirect.offset + VkDeviceSize(i) * stride, 1, stride);
+        stats.drawCalls++;
+    }
+}
@@ -0,0 +1,371 @@
+#include "RenderTarget.h"
+
+#include <stdexcept>
+
+#include "Log.h"
+#include "PerformanceOverlay.h"
+#include "SceneResources.h"
+#include "ShaderRegistry.h"
+#include "VulkanDevice.h"
+
+void setPipelinePass(GraphicsPipelineInfo& info, const RenderGraphPass& pass) {
+    info.renderPass = pass.getRenderPass();
+    info.rendering = pass.getRenderingInfo();
+}
+
+RenderGraphPass& addLodPass(RenderGraph& renderGraph) {
+    // Its only outputs are the indirect draw buffers, which the graph does not track.
+    return renderGraph.addPass("lod selection", VK_PIPELINE_BIND_POINT_COMPUTE).setSideEffects();
+}
+
+RenderGraphPass& addShadowPass(RenderGraph& renderGraph, VkFormat format,
+                               RenderGraphResource& shadowMap) {
+    RenderGraphImageInfo info{};
+    info.format = format;
+    info.extent = {SHADOW_MAP_SIZE, SHADOW_MAP_SIZE};
+    info.layers = SHADOW_CASCADE_COUNT;
+    shadowMap = renderGraph.createImage("shadow map", info);
+
+    VkClearValue clearDepth{};
+    clearDepth.depthStencil = {1.0f, 0};
+
+    // One view per cascade, so the draws are recorded once however many cascades there are.
+    return renderGraph.addPass("shadow cascades")
+        .writeDepthStencil(shadowMap, VK_ATTACHMENT_LOAD_OP_CLEAR, clearDepth)
+        .setViewMask((1u << SHADOW_CASCADE_COUNT) - 1);
+}
+
+RenderGraphPass& addFeedbackPass(RenderGraph& renderGraph, VkExtent2D extent, VkFormat depthFormat,
+                                 RenderGraphResource& feedback) {
+    RenderGraphImageInfo info{};
+    info.format = VK_FORMAT_R32_UINT;
+    info.extent = VirtualTextureFeedback::getExtent(extent);
+    feedback = renderGraph.createImage("texture feedback", info);
+
+    RenderGraphImageInfo depthInfo{};
+    depthInfo.format = depthFormat;
+    depthInfo.extent = info.extent;
+    RenderGraphResource depth = renderGraph.createImage("feedback depth", depthInfo);
+
+    VkClearValue clearFeedback{};
+    clearFeedback.color.uint32[0] = VIRTUAL_TEXTURE_NO_FEEDBACK;
+    VkClearValue clearDepth{};
+    clearDepth.depthStencil = {1.0f, 0};
+
+    return renderGraph.addPass("texture feedback")
+        .writeColor(feedback, VK_ATTACHMENT_LOAD_OP_CLEAR, clearFeedback)
+        .writeDepthStencil(depth, VK_ATTACHMENT_LOAD_OP_CLEAR, clearDepth);
+}
+
+RenderGraphPass& addScenePass(RenderGraph& renderGraph, RenderGraphResource output,
+                              const RenderGraphImageInfo& outputInfo, VkFormat depthFormat,
+                              VkSampleCountFlagBits samples, RenderGraphResource shadowMap) {
+    RenderGraphImageInfo depthInfo{};
+    depthInfo.format = depthFormat;
+    depthInfo.extent = outputInfo.extent;
+    depthInfo.samples = samples;
+    RenderGraphResource depth = renderGraph.createImage("depth", depthInfo);
+
+    VkClearValue clearColor{};
+    clearColor.color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+    VkClearValue clearDepth{};
+    clearDepth.depthStencil = {1.0f, 0};
+
+    RenderGraphPass& pass = renderGraph.addPass("main");
+    pass.readTexture(shadowMap);
+    if (samples != VK_SAMPLE_COUNT_1_BIT) {
+        RenderGraphImageInfo colorInfo = outputInfo;
+        colorInfo.samples = samples;
+        RenderGraphResource color = renderGraph.createImage("color", colorInfo);
+
+        pass.writeColor(color, VK_ATTACHMENT_LOAD_OP_CLEAR, clearColor).resolveColor(color, output);
+    } else {
+        pass.writeColor(output, VK_ATTACHMENT_LOAD_OP_CLEAR, clearColor);
+    }
+
+    return pass.writeDepthStencil(depth, VK_ATTACHMENT_LOAD_OP_CLEAR, clearDepth);
+}
+
+void RenderTarget::create(const VulkanDevice& vulkanDevice, const SceneResources& scene,
+                          VkSurfaceKHR surface, VkExtent2D extent,
+                          const RenderTargetOptions& options) {
+    if (!vulkanDevice.supportsPresent(surface)) {
+        throw std::runtime_error("failed to find present support for render target surface!");
+    }
+
+    this->vulkanDevice = &vulkanDevice;
+    this->scene = &scene;
+    this->surface = surface;
+    this->options = options;
+    msaaSamples = vulkanDevice.getMaxUsableSampleCount(options.msaaSamples);
+    this->options.msaaSamples = msaaSamples;
+    this->options.dynamicRendering = options.dynamicRendering && vulkanDevice.hasDynamicRendering();
+
+    frames.create(vulkanDevice, options.framesInFlight);
+    this->options.framesInFlight = frames.getFramesInFlight();
+    post.create(vulkanDevice);
+    createSwapchainResources(extent);
+}
+
+void RenderTarget::destroy() {
+    frames.waitIdle();
+    destroySwapchainResources();
+    textureFeedback.destroy();
+    view.destroy();
+    renderGraph.destroy();
+    destroyPipeline();
+    post.destroy();
+    frames.destroy();
+}
+
+FrameStatus RenderTarget::renderFrame(uint64_t timeout) {
+    return frames.drawFrame(
+        swapchain, timeout,
+        [this](uint32_t imageIndex, std::vector<VkCommandBuffer>& commandBuffers) {
+            textureFeedback.collect(imageIndex);
+            view.updateUniformBuffer(imageIndex, swapchain.getExtent());
+            view.updateInstances(imageIndex);
+
+            // The image's previous frame has finished, so reading its timings cannot block.
+            if ((overlay != nullptr || collectTimings)
+                && frames.getImageGpuTime(imageIndex, recentGpuTime)) {
+                renderGraph.getPassTimes(imageIndex, recentPassTimes, false);
+            }
+            if (overlay != nullptr) {
+                commandBuffers.push_back(overlay->record(imageIndex));
+            }
+        });
+}
+
+// Pipelines created against render pass objects are rebuilt with them; dynamic rendering ones
+// only depend on the attachment formats and sample count, which a resize keeps.
+void RenderTarget::resize(VkExtent2D extent) {
+    rebuild(extent, options.dynamicRendering);
+}
+
+void RenderTarget::setSampleCount(uint32_t samples) {
+    msaaSamples = vulkanDevice->getMaxUsableSampleCount(samples);
+    options.msaaSamples = msaaSamples;
+    rebuild(swapchain.getExtent(), false);
+}
+
+void RenderTarget::setOptions(const RenderTargetOptions& newOptions) {
+    if (newOptions.framesInFlight != options.framesInFlight) {
+        frames.setFramesInFlight(newOptions.framesInFlight);
+    }
+
+    VkSampleCountFlagBits samples = vulkanDevice->getMaxUsableSampleCount(newOptions.msaaSamples);
+    bool dynamicRendering = newOptions.dynamicRendering && vulkanDevice->hasDynamicRendering();
+    bool pipelinesChanged = samples != msaaSamples || dynamicRendering != options.dynamicRendering;
+    bool presentModeChanged = newOptions.presentMode != options.presentMode;
+
+    options = newOptions;
+    options.msaaSamples = samples;
+    options.framesInFlight = frames.getFramesInFlight();
+    options.dynamicRendering = dynamicRendering;
+    if (pipelinesChanged || presentModeChanged) {
+        msaaSamples = samples;
+        rebuild(swapchain.getExtent(), !pipelinesChanged && dynamicRendering);
+    }
+}
+
+void RenderTarget::setOverlay(PerformanceOverlay* overlay) {
+    frames.waitIdle();
+    if (this->overlay != nullptr) {
+        this->overlay->destroySwapchainResources();
+    }
+    this->overlay = overlay;
+    if (overlay != nullptr) {
+        overlay->createSwapchainResources(swapchain);
+    }
+}
+
+void RenderTarget::reloadPipeline() {
+    frames.waitIdle();
+    frames.freeCommandBuffers();
+    destroyPipeline();
+    post.reloadPipelines();
+    view.reloadPipelines();
+
+    createPipeline();
+    recordCommandBuffers();
+}
+
+bool RenderTarget::getLastFramePassTimes(std::vector<RenderGraphPassTime>& times) const {
+    uint32_t imageIndex = frames.getSubmittedImage();
+    if (imageIndex == UINT32_MAX) {
+        return false;
+    }
+    return renderGraph.getPassTimes(imageIndex, times);
+}
+
+void RenderTarget::refreshCommands() {
+    frames.waitIdle();
+    frames.freeCommandBuffers();
+    recordCommandBuffers();
+}
+
+// Everything that depends on the swapchain images or their extent. The view's per-image buffers,
+// its LOD selection and the feedback readback only depend on the image count, so they are kept
+// while it stays the same and pointed at the new graph's images.
+void RenderTarget::createSwapchainResources(VkExtent2D extent) {
+    swapchain.create(*vulkanDevice, surface, extent, options.presentMode);
+
+    createRenderGraph();
+    if (pipeline.getHandle() == VK_NULL_HANDLE) {
+        createPipeline();
+    }
+    uint32_t imageCount = swapchain.getImageCount();
+    if (view.getImageCount() == imageCount) {
+        view.setShadowMap(renderGraph.getImageView(shadowMap));
+        textureFeedback.resize(extent);
+    } else {
+        if (view.getImageCount() > 0) {
+            textureFeedback.destroy();
+            view.destroy();
+        }
+        view.create(*vulkanDevice, *scene, imageCount, renderGraph.getImageView(shadowMap));
+        textureFeedback.create(*vulkanDevice, imageCount, extent);
+    }
+    recordCommandBuffers();
+    if (overlay != nullptr) {
+        overlay->createSwapchainResources(swapchain);
+    }
+}
+
+void RenderTarget::destroySwapchainResources() {
+    frames.releaseAcquiredImage();
+    if (overlay != nullptr) {
+        overlay->destroySwapchainResources();
+    }
+    frames.freeCommandBuffers();
+    post.releaseDescriptors();
+    renderGraph.clear();
+    swapchain.destroy();
+}
+
+void RenderTarget::rebuild(VkExtent2D extent, bool keepPipelines) {
+    frames.waitIdle();
+    destroySwapchainResources();
+    if (!keepPipelines) {
+        destroyPipeline();
+    }
+    createSwapchainResources(extent);
+}
+
+void RenderTarget::createRenderGraph() {
+    RenderGraphImageInfo backbufferInfo{};
+    backbufferInfo.format = swapchain.getImageFormat();
+    backbufferInfo.extent = swapchain.getExtent();
+
+    // drawFrame waits for the acquired image at the colour attachment output stage.
+    backbuffer = renderGraph.importImage(
+        "backbuffer", backbufferInfo,
+        {VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0},
+        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+    RenderGraphImageInfo hdrInfo{};
+    hdrInfo.format = HDR_COLOR_FORMAT;
+    hdrInfo.extent = backbufferInfo.extent;
+    RenderGraphResource hdr = renderGraph.createImage("hdr", hdrInfo);
+
+    addLodPass(renderGraph).setExecute([this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        view.selectLods(commandBuffer, imageIndex);
+    });
+    shadowPass = &addShadowPass(renderGraph, vulkanDevice->findShadowMapFormat(), shadowMap);
+    shadowPass->setExecute([this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        view.drawShadowCasters(commandBuffer, shadowPipeline, imageIndex);
+    });
+
+    // The feedback image is read back by the same frame; the CPU collects it once the frame's
+    // image comes round again.
+    feedbackPass = &addFeedbackPass(renderGraph, backbufferInfo.extent,
+                                    vulkanDevice->findDepthFormat(), feedback);
+    feedbackPass->setExecute([this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        view.drawFeedback(commandBuffer, feedbackPipeline, imageIndex);
+    });
+    renderGraph.addPass("feedback readback")
+        .readTransfer(feedback)
+        .setSideEffects()
+        .setExecute([this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+            textureFeedback.recordReadback(commandBuffer, renderGraph.getImage(feedback),
+                                           imageIndex);
+        });
+
+    mainPass = &addScenePass(renderGraph, hdr, hdrInfo, vulkanDevice->findDepthFormat(),
+                             msaaSamples, shadowMap);
+    mainPass->setExecute([this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        recordMainPass(commandBuffer, imageIndex);
+    });
+    post.addPasses(renderGraph, hdr, backbuffer);
+
+    renderGraph.setDynamicRendering(options.dynamicRendering);
+    renderGraph.compile(vulkanDevice->getDevice(),
+                        vulkanDevice->getCapabilities().getMemoryProperties());
+    post.updateDescriptors(renderGraph);
+    renderGraph.enableTimestamps(swapchain.getImageCount(), vulkanDevice->getTimestampPeriod());
+
+    const RenderGraphStats& stats = renderGraph.getStats();
+    LOG(Render, Info,
+        "render graph: " << stats.declaredPasses - stats.culledPasses << "/"
+                         << stats.declaredPasses << " passes, " << stats.imageBarriers
+                         << " image barriers in " << stats.barrierBatches << " batches");
+    LOG(Render, Info,
+        "attachment memory: " << stats.attachmentMemory / 1024 << " KiB allocated, "
+                              << stats.lazyAttachmentMemory / 1024
+                              << " KiB lazily allocated, peak live "
+                              << stats.peakLiveAttachmentMemory / 1024 << " KiB, unaliased "
+                              << stats.unaliasedAttachmentMemory / 1024 << " KiB");
+}
+
+void RenderTarget::createPipeline() {
+    GraphicsPipelineInfo info{};
+    info.vertexShader = getShaderCode("shader_depth_vert");
+    info.fragmentShader = getShaderCode("shader_depth_frag");
+    setPipelinePass(info, *mainPass);
+    info.descriptorSetLayout = scene->getDescriptorSetLayout();
+    info.samples = msaaSamples;
+
+    pipeline.create(*vulkanDevice, info);
+
+    GraphicsPipelineInfo shadowInfo{};
+    shadowInfo.vertexShader = getShaderCode("shadow_depth_vert");
+    shadowInfo.depthOnly = true;
+    setPipelinePass(shadowInfo, *shadowPass);
+    shadowInfo.descriptorSetLayout = scene->getDescriptorSetLayout();
+
+    shadowPipeline.create(*vulkanDevice, shadowInfo);
+
+    GraphicsPipelineInfo feedbackInfo{};
+    feedbackInfo.vertexShader = getShaderCode("shader_depth_vert");
+    feedbackInfo.fragmentShader = getShaderCode("vt_feedback_frag");
+    setPipelinePass(feedbackInfo, *feedbackPass);
+    feedbackInfo.descriptorSetLayout = scene->getDescriptorSetLayout();
+
+    feedbackPipeline.create(*vulkanDevice, feedbackInfo);
+}
+
+void RenderTarget::destroyPipeline() {
+    pipeline.destroy();
+    shadowPipeline.destroy();
+    feedbackPipeline.destroy();
+}
+
+void RenderTarget::recordCommandBuffers() {
+    frames.recordCommandBuffers(swapchain, [this](VkCommandBuffer commandBuffer, uint32_t i) {
+        renderGraph.setImportedImage(backbuffer, swapchain.getImage(i), swapchain.getImageView(i));
+        renderGraph.execute(commandBuffer, i);
+    });
+
+    const RenderQueueStats& stats = view.getRenderQueueStats();
+    LOG(Render, Info,
+        "render queue: " << stats.items << " items in " << stats.draws << " draws and "
+                         << stats.drawCalls << " draw calls, " << stats.pipelineBinds
+                         << " pipeline, " << stats.descriptorSetBinds << " descriptor set, "
+                         << stats.vertexBufferBinds << " vertex buffer and "
+                         << stats.indexBufferBinds << " index buffer binds per frame");
+}
+
+void RenderTarget::recordMainPass(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+    view.draw(commandBuffer, pipeline, imageIndex);
+}
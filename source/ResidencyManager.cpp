@@ -0,0 +1,114 @@
+#include "ResidencyManager.h"
+
+#include <algorithm>
+
+#include "VirtualTexture.h"
+#include "VulkanDevice.h"
+
+// Weight of the latest coverage in a texture's priority; smooths out single frames.
+static const double COVERAGE_SMOOTHING = 0.1;
+
+void ResidencyManager::create(const VulkanDevice& vulkanDevice, VkDeviceSize budget) {
+    this->vulkanDevice = &vulkanDevice;
+    configuredBudget = budget;
+    stats = ResidencyStats{};
+    pollBudget();
+}
+
+void ResidencyManager::destroy() {
+    textures.clear();
+    vulkanDevice = nullptr;
+}
+
+VkDeviceSize ResidencyManager::getBudget(const MemoryBudget& deviceBudget) const {
+    if (configuredBudget > 0) {
+        return configuredBudget;
+    }
+    return static_cast<VkDeviceSize>(deviceBudget.budget * TEXTURE_BUDGET_SHARE);
+}
+
+VkDeviceSize ResidencyManager::getAllocatedBytes() const {
+    VkDeviceSize allocated = 0;
+    for (const Texture& texture : textures) {
+        allocated += texture.texture->getSlotCount() * texture.texture->getTileBytes();
+    }
+    return allocated;
+}
+
+void ResidencyManager::pollBudget() {
+    MemoryBudget deviceBudget = vulkanDevice->getMemoryBudget();
+    stats.deviceBudget = deviceBudget.budget;
+    stats.deviceUsage = deviceBudget.usage;
+    polledUsage = deviceBudget.usage;
+    polledAllocated = getAllocatedBytes();
+    framesSincePoll = 0;
+}
+
+// Between polls only this process's own tile caches are accounted for; other allocations show
+// up at the next poll. Textures are never removed, so the allocated bytes only grow.
+MemoryBudget ResidencyManager::getDeviceBudget() const {
+    MemoryBudget deviceBudget;
+    deviceBudget.budget = stats.deviceBudget;
+    deviceBudget.usage = polledUsage;
+    if (vulkanDevice->hasMemoryBudget()) {
+        deviceBudget.usage += getAllocatedBytes() - polledAllocated;
+    }
+    return deviceBudget;
+}
+
+// Never more than the device has left, which only VK_EXT_memory_budget reports.
+VkDeviceSize ResidencyManager::getCacheBudget() const {
+    MemoryBudget deviceBudget = getDeviceBudget();
+    VkDeviceSize allocated = getAllocatedBytes();
+
+    VkDeviceSize budget = getBudget(deviceBudget);
+    VkDeviceSize available = budget > allocated ? budget - allocated : 0;
+    if (vulkanDevice->hasMemoryBudget()) {
+        VkDeviceSize headroom = deviceBudget.budget > deviceBudget.usage
+                                    ? deviceBudget.budget - deviceBudget.usage
+                                    : 0;
+        available = std::min(available, headroom);
+    }
+    return available;
+}
+
+void ResidencyManager::addTexture(VirtualTexture& texture) {
+    Texture added;
+    added.texture = &texture;
+    textures.push_back(added);
+    // Its tile cache has just been allocated.
+    framesSincePoll = BUDGET_POLL_INTERVAL;
+}
+
+// Pinned tiles are always kept, whatever the budget; the rest of it is split in proportion to
+// the textures' priorities, or evenly while nothing has been sampled.
+void ResidencyManager::update() {
+    if (++framesSincePoll >= BUDGET_POLL_INTERVAL) {
+        pollBudget();
+    }
+    MemoryBudget deviceBudget = getDeviceBudget();
+    stats.deviceUsage = deviceBudget.usage;
+    stats.budget = getBudget(deviceBudget);
+    stats.residentBytes = 0;
+
+    VkDeviceSize pinnedBytes = 0;
+    double totalPriority = 0.0;
+    for (Texture& texture : textures) {
+        VirtualTexture& streamed = *texture.texture;
+        double coverage = static_cast<double>(streamed.takeCoverage());
+        texture.priority += (coverage - texture.priority) * COVERAGE_SMOOTHING;
+        totalPriority += texture.priority;
+        pinnedBytes += streamed.getPinnedCount() * streamed.getTileBytes();
+        stats.residentBytes += streamed.getStats().residentTiles * streamed.getTileBytes();
+    }
+
+    VkDeviceSize shared = stats.budget > pinnedBytes ? stats.budget - pinnedBytes : 0;
+    for (Texture& texture : textures) {
+        VirtualTexture& streamed = *texture.texture;
+        double share = totalPriority > 0.0 ? texture.priority / totalPriority
+                                           : 1.0 / textures.size();
+        VkDeviceSize tiles = static_cast<VkDeviceSize>(shared * share) / streamed.getTileBytes();
+        tiles = std::min<VkDeviceSize>(tiles, streamed.getSlotCount());
+        streamed.setResidentLimit(streamed.getPinnedCount() + static_cast<uint32_t>(tiles));
+    }
+}
@@ -0,0 +1,102 @@
+#include "SamplerCache.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+
+static size_t combineHash(size_t seed, size_t value) {
+    return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
+
+static uint32_t getFloatBits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static bool usesBorder(const VkSamplerCreateInfo& info) {
+    return info.addressModeU == VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER
+           || info.addressModeV == VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER
+           || info.addressModeW == VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+}
+
+size_t SamplerInfoHash::operator()(const VkSamplerCreateInfo& info) const {
+    size_t hash = std::hash<uint32_t>()(info.flags);
+    for (uint32_t value :
+         {uint32_t(info.magFilter), uint32_t(info.minFilter), uint32_t(info.mipmapMode),
+          uint32_t(info.addressModeU), uint32_t(info.addressModeV), uint32_t(info.addressModeW),
+          getFloatBits(info.mipLodBias), info.anisotropyEnable, getFloatBits(info.maxAnisotropy),
+          info.compareEnable, uint32_t(info.compareOp), getFloatBits(info.minLod),
+          getFloatBits(info.maxLod), uint32_t(info.borderColor), info.unnormalizedCoordinates}) {
+        hash = combineHash(hash, std::hash<uint32_t>()(value));
+    }
+    return hash;
+}
+
+bool SamplerInfoEqual::operator()(const VkSamplerCreateInfo& a,
+                                  const VkSamplerCreateInfo& b) const {
+    return a.flags == b.flags && a.magFilter == b.magFilter && a.minFilter == b.minFilter
+           && a.mipmapMode == b.mipmapMode && a.addressModeU == b.addressModeU
+           && a.addressModeV == b.addressModeV && a.addressModeW == b.addressModeW
+           && a.mipLodBias == b.mipLodBias && a.anisotropyEnable == b.anisotropyEnable
+           && a.maxAnisotropy == b.maxAnisotropy && a.compareEnable == b.compareEnable
+           && a.compareOp == b.compareOp && a.minLod == b.minLod && a.maxLod == b.maxLod
+           && a.borderColor == b.borderColor
+           && a.unnormalizedCoordinates == b.unnormalizedCoordinates;
+}
+
+void SamplerCache::create(VkDevice device, const VkPhysicalDeviceLimits& limits,
+                          const VkPhysicalDeviceFeatures& enabledFeatures) {
+    this->device = device;
+    maxAnisotropy = limits.maxSamplerAnisotropy;
+    anisotropyEnabled = enabledFeatures.samplerAnisotropy == VK_TRUE;
+    maxSamplerCount = limits.maxSamplerAllocationCount;
+}
+
+void SamplerCache::destroy() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& sampler : samplers) {
+        vkDestroySampler(device, sampler.second, nullptr);
+    }
+    samplers.clear();
+}
+
+VkSampler SamplerCache::getSampler(const VkSamplerCreateInfo& info) {
+    if (info.pNext != nullptr) {
+        throw std::runtime_error("failed to cache sampler with extension structures!");
+    }
+
+    // Fields the rest of the state makes irrelevant are cleared, so they do not split the key.
+    VkSamplerCreateInfo key = info;
+    key.anisotropyEnable = info.anisotropyEnable && anisotropyEnabled ? VK_TRUE : VK_FALSE;
+    key.maxAnisotropy = key.anisotropyEnable ? std::min(info.maxAnisotropy, maxAnisotropy) : 0.0f;
+    if (!key.compareEnable) {
+        key.compareOp = VK_COMPARE_OP_NEVER;
+    }
+    if (!usesBorder(key)) {
+        key.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = samplers.find(key);
+    if (found != samplers.end()) {
+        return found->second;
+    }
+
+    if (samplers.size() >= maxSamplerCount) {
+        throw std::runtime_error("failed to create sampler: maxSamplerAllocationCount reached!");
+    }
+    VkSampler sampler;
+    if (vkCreateSampler(device, &key, nullptr, &sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create sampler!");
+    }
+    samplers.emplace(key, sampler);
+    return sampler;
+}
+
+size_t SamplerCache::getSamplerCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return samplers.size();
+}
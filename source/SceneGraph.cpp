@@ -0,0 +1,245 @@
+#include "SceneGraph.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#    include <xmmintrin.h>
+#    define SCENE_GRAPH_SSE
+#endif
+
+static const uint32_t NO_INDEX = UINT32_MAX;
+// Updates that a view can fall behind by before it has to copy every instance.
+static const size_t CHANGE_HISTORY = 8;
+// Below this many dirty nodes per thread a level is cheaper to update on one thread.
+static const size_t MIN_NODES_PER_THREAD = 1024;
+
+// result = a * b for column major matrices: each result column is a's columns weighted by the
+// matching column of b.
+static void multiplyTransforms(const glm::mat4& a, const glm::mat4& b, glm::mat4& result) {
+#ifdef SCENE_GRAPH_SSE
+    const float* left = glm::value_ptr(a);
+    const float* right = glm::value_ptr(b);
+    float* out = glm::value_ptr(result);
+
+    __m128 a0 = _mm_loadu_ps(left);
+    __m128 a1 = _mm_loadu_ps(left + 4);
+    __m128 a2 = _mm_loadu_ps(left + 8);
+    __m128 a3 = _mm_loadu_ps(left + 12);
+
+    for (int i = 0; i < 4; i++) {
+        const float* column = right + 4 * i;
+        __m128 sum = _mm_mul_ps(a0, _mm_set1_ps(column[0]));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a1, _mm_set1_ps(column[1])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a2, _mm_set1_ps(column[2])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a3, _mm_set1_ps(column[3])));
+        _mm_storeu_ps(out + 4 * i, sum);
+    }
+#else
+    result = a * b;
+#endif
+}
+
+SceneNode SceneGraph::createNode(SceneNode parent, const glm::mat4& localTransform) {
+    if (parent != NO_SCENE_NODE && parent >= indices.size()) {
+        throw std::runtime_error("scene node parent does not exist!");
+    }
+
+    SceneNode node = static_cast<SceneNode>(indices.size());
+    uint32_t parentIndex = parent == NO_SCENE_NODE ? NO_INDEX : indices[parent];
+    uint32_t depth = parent == NO_SCENE_NODE ? 0 : depths[parentIndex] + 1;
+
+    // Appended out of order; update() restores the depth sorted layout.
+    indices.push_back(static_cast<uint32_t>(nodes.size()));
+    nodes.push_back(node);
+    parents.push_back(parentIndex);
+    firstChildren.push_back(0);
+    childCounts.push_back(0);
+    depths.push_back(depth);
+    localTransforms.push_back(localTransform);
+    worldTransforms.push_back(localTransform);
+    dirty.push_back(0);
+
+    dirtyLevels.resize(std::max<size_t>(dirtyLevels.size(), depth + 1));
+    layoutChanged = true;
+
+    return node;
+}
+
+void SceneGraph::setLocalTransform(SceneNode node, const glm::mat4& localTransform) {
+    uint32_t index = indices.at(node);
+    localTransforms[index] = localTransform;
+    markDirty(index);
+}
+
+const glm::mat4& SceneGraph::getLocalTransform(SceneNode node) const {
+    return localTransforms[indices.at(node)];
+}
+
+const glm::mat4& SceneGraph::getWorldTransform(SceneNode node) const {
+    return worldTransforms[indices.at(node)];
+}
+
+void SceneGraph::markDirty(uint32_t index) {
+    // A pending relayout marks every node dirty anyway.
+    if (dirty[index] || layoutChanged) {
+        return;
+    }
+
+    dirty[index] = 1;
+    dirtyLevels[depths[index]].push_back(index);
+}
+
+void SceneGraph::update(uint32_t threadCount) {
+    bool renumbered = layoutChanged;
+    if (layoutChanged) {
+        rebuildLayout();
+    }
+
+    std::vector<uint32_t> changed;
+    for (size_t depth = 0; depth < dirtyLevels.size(); depth++) {
+        std::vector<uint32_t>& level = dirtyLevels[depth];
+        if (level.empty()) {
+            continue;
+        }
+
+        updateLevel(level, threadCount);
+
+        // Children of a dirty node are a contiguous range on the next level.
+        for (uint32_t index : level) {
+            uint32_t end = firstChildren[index] + childCounts[index];
+            for (uint32_t child = firstChildren[index]; child < end; child++) {
+                if (!dirty[child]) {
+                    dirty[child] = 1;
+                    dirtyLevels[depth + 1].push_back(child);
+                }
+            }
+            dirty[index] = 0;
+        }
+
+        changed.insert(changed.end(), level.begin(), level.end());
+        level.clear();
+    }
+
+    if (changed.empty() && !renumbered) {
+        return;
+    }
+
+    version++;
+    if (renumbered) {
+        renumberedVersion = version;
+    }
+    history.push_back({version, std::move(changed)});
+    if (history.size() > CHANGE_HISTORY) {
+        history.pop_front();
+    }
+}
+
+bool SceneGraph::getChangesSince(uint64_t since, std::vector<uint32_t>& instances) const {
+    if (since >= version) {
+        return true;
+    }
+    if (since < renumberedVersion || history.empty() || history.front().version > since + 1) {
+        return false;
+    }
+
+    for (const Change& change : history) {
+        if (change.version > since) {
+            instances.insert(instances.end(), change.instances.begin(), change.instances.end());
+        }
+    }
+
+    return true;
+}
+
+// Sorts the nodes breadth first, which orders them by depth and makes each node's children
+// contiguous, then marks everything dirty.
+void SceneGraph::rebuildLayout() {
+    size_t count = nodes.size();
+
+    std::vector<std::vector<uint32_t>> children(count);
+    std::vector<uint32_t> order;
+    order.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        if (parents[i] == NO_INDEX) {
+            order.push_back(i);
+        } else {
+            children[parents[i]].push_back(i);
+        }
+    }
+    for (size_t i = 0; i < order.size(); i++) {
+        order.insert(order.end(), children[order[i]].begin(), children[order[i]].end());
+    }
+
+    std::vector<uint32_t> newIndices(count);
+    for (uint32_t i = 0; i < count; i++) {
+        newIndices[order[i]] = i;
+    }
+
+    std::vector<uint32_t> newParents(count);
+    std::vector<uint32_t> newFirstChildren(count);
+    std::vector<uint32_t> newChildCounts(count);
+    std::vector<uint32_t> newDepths(count);
+    std::vector<glm::mat4> newLocalTransforms(count);
+    std::vector<SceneNode> newNodes(count);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t old = order[i];
+        newParents[i] = parents[old] == NO_INDEX ? NO_INDEX : newIndices[parents[old]];
+        newFirstChildren[i] = children[old].empty() ? 0 : newIndices[children[old].front()];
+        newChildCounts[i] = static_cast<uint32_t>(children[old].size());
+        newDepths[i] = depths[old];
+        newLocalTransforms[i] = localTransforms[old];
+        newNodes[i] = nodes[old];
+        indices[nodes[old]] = i;
+    }
+
+    parents.swap(newParents);
+    firstChildren.swap(newFirstChildren);
+    childCounts.swap(newChildCounts);
+    depths.swap(newDepths);
+    localTransforms.swap(newLocalTransforms);
+    nodes.swap(newNodes);
+
+    for (auto& level : dirtyLevels) {
+        level.clear();
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        dirty[i] = 1;
+        dirtyLevels[depths[i]].push_back(i);
+    }
+    layoutChanged = false;
+}
+
+void SceneGraph::updateLevel(const std::vector<uint32_t>& level, uint32_t threadCount) {
+    auto updateRange = [this, &level](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            uint32_t index = level[i];
+            if (parents[index] == NO_INDEX) {
+                worldTransforms[index] = localTransforms[index];
+            } else {
+                multiplyTransforms(worldTransforms[parents[index]], localTransforms[index],
+                                   worldTransforms[index]);
+            }
+        }
+    };
+
+    size_t threads = std::min<size_t>(threadCount, level.size() / MIN_NODES_PER_THREAD);
+    if (threads <= 1) {
+        updateRange(0, level.size());
+        return;
+    }
+
+    // Each thread writes its own nodes and reads parents finished on the previous level.
+    size_t chunk = (level.size() + threads - 1) / threads;
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < threads; t++) {
+        workers.emplace_back(updateRange, t * chunk, std::min(level.size(), (t + 1) * chunk));
+    }
+    updateRange(0, chunk);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
@@ -0,0 +1,358 @@
+#include "SceneResources.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+#include "QueueScheduler.h"
+#include "VulkanDevice.h"
+
+static const char* const SCENE_TEXTURE = "texture";
+
+static const uint32_t GEOMETRY_VERTEX_CAPACITY = 1 << 16;
+static const uint32_t GEOMETRY_INDEX_CAPACITY = 1 << 18;
+// Mesh positions are copied from the pack's float triples into the vec3 position stream.
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "position stream layout changed");
+
+static void recordBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStages,
+                          VkPipelineStageFlags dstStages, const VkBufferMemoryBarrier& barrier) {
+    vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr, 1, &barrier, 0,
+                         nullptr);
+}
+
+// Makes a copy recorded in transferCommands visible to graphics work at dstStages. Across queue
+// families this is a release on the transfer queue and a matching acquire on the graphics queue,
+// whose submission waits for the copies at the transfer stage.
+template <typename Barrier>
+static void recordHandOver(const VulkanDevice& vulkanDevice, VkCommandBuffer transferCommands,
+                           VkCommandBuffer graphicsCommands, Barrier barrier,
+                           VkPipelineStageFlags dstStages) {
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    if (graphicsCommands == VK_NULL_HANDLE) {
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        recordBarrier(transferCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStages, barrier);
+        return;
+    }
+
+    barrier.srcQueueFamilyIndex = vulkanDevice.getQueueFamily(QueueType::Transfer);
+    barrier.dstQueueFamilyIndex = vulkanDevice.getQueueFamily(QueueType::Graphics);
+
+    Barrier release = barrier;
+    release.dstAccessMask = 0;
+    recordBarrier(transferCommands, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                  VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, release);
+
+    Barrier acquire = barrier;
+    acquire.srcAccessMask = 0;
+    recordBarrier(graphicsCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStages, acquire);
+}
+
+VkVertexInputBindingDescription Vertex::getBindingDescription() {
+    VkVertexInputBindingDescription bindingDescription{};
+    bindingDescription.binding = 0;
+    bindingDescription.stride = sizeof(Vertex);
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    return bindingDescription;
+}
+
+std::array<VkVertexInputAttributeDescription, 3> Vertex::getAttributeDescriptions() {
+    std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
+
+    attributeDescriptions[0].binding = 0;
+    attributeDescriptions[0].location = 0;
+    attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[0].offset = offsetof(Vertex, pos);
+
+    attributeDescriptions[1].binding = 0;
+    attributeDescriptions[1].location = 1;
+    attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[1].offset = offsetof(Vertex, color);
+
+    attributeDescriptions[2].binding = 0;
+    attributeDescriptions[2].location = 2;
+    attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
+    attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
+
+    return attributeDescriptions;
+}
+
+VkVertexInputBindingDescription Vertex::getPositionBindingDescription() {
+    VkVertexInputBindingDescription bindingDescription{};
+    bindingDescription.binding = 0;
+    bindingDescription.stride = sizeof(glm::vec3);
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    return bindingDescription;
+}
+
+VkVertexInputAttributeDescription Vertex::getPositionAttributeDescription() {
+    VkVertexInputAttributeDescription attributeDescription{};
+    attributeDescription.binding = 0;
+    attributeDescription.location = 0;
+    attributeDescription.format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescription.offset = 0;
+
+    return attributeDescription;
+}
+
+VkVertexInputBindingDescription InstanceData::getBindingDescription() {
+    VkVertexInputBindingDescription bindingDescription{};
+    bindingDescription.binding = 1;
+    bindingDescription.stride = sizeof(InstanceData);
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+    return bindingDescription;
+}
+
+std::array<VkVertexInputAttributeDescription, 4> InstanceData::getAttributeDescriptions() {
+    std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions{};
+
+    for (uint32_t i = 0; i < attributeDescriptions.size(); i++) {
+        attributeDescriptions[i].binding = 1;
+        attributeDescriptions[i].location = 3 + i;
+        attributeDescriptions[i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        attributeDescriptions[i].offset = offsetof(InstanceData, model) + sizeof(glm::vec4) * i;
+    }
+
+    return attributeDescriptions;
+}
+
+void SceneResources::create(const VulkanDevice& vulkanDevice, VkDeviceSize textureBudget) {
+    this->vulkanDevice = &vulkanDevice;
+    device = vulkanDevice.getDevice();
+
+    createSceneGraph();
+    geometry.create(vulkanDevice, sizeof(Vertex), sizeof(glm::vec3), GEOMETRY_VERTEX_CAPACITY,
+                    GEOMETRY_INDEX_CAPACITY);
+
+    // Payloads are copied straight out of the mapped pack while the uploads are recorded. It
+    // stays mapped for the virtual texture to stream from.
+    assets.open(ASSET_PACK_PATH);
+
+    // All uploads go to the transfer queue as one submission instead of a queue wait per copy.
+    QueueScheduler scheduler;
+    scheduler.create(vulkanDevice);
+    stagingPool.create(vulkanDevice);
+
+    UploadBatch batch;
+    batch.transferCommands = scheduler.beginCommands(QueueType::Transfer);
+    if (vulkanDevice.getQueueFamily(QueueType::Transfer)
+        != vulkanDevice.getQueueFamily(QueueType::Graphics)) {
+        batch.graphicsCommands = scheduler.beginCommands(QueueType::Graphics);
+    }
+
+    for (uint32_t i = 0; i < assets.getEntryCount(); i++) {
+        const AssetPackEntry& entry = assets.getEntry(i);
+        if (entry.type != AssetType::Mesh) {
+            continue;
+        }
+        if (entry.vertexStride != sizeof(Vertex)) {
+            throw std::runtime_error("asset pack mesh has an unexpected vertex layout!");
+        }
+        uploadMesh(batch, entry, assets);
+    }
+
+    SubmissionHandle copies = scheduler.submit(QueueType::Transfer, batch.transferCommands);
+    if (batch.graphicsCommands != VK_NULL_HANDLE) {
+        scheduler.submit(QueueType::Graphics, batch.graphicsCommands,
+                         {{copies, VK_PIPELINE_STAGE_TRANSFER_BIT}});
+    }
+    stagingPool.retire(scheduler.flush());
+
+    // The samplers are created and the pinned texture tiles uploaded while the copies run.
+    createShadowSampler();
+    const AssetPackEntry* texture = assets.find(SCENE_TEXTURE, AssetType::VirtualTexture);
+    if (texture == nullptr) {
+        throw std::runtime_error("failed to load texture image!");
+    }
+    residency.create(vulkanDevice, textureBudget);
+    virtualTexture.create(vulkanDevice, assets, *texture, residency.getCacheBudget());
+    residency.addTexture(virtualTexture);
+    createDescriptorSetLayout();
+
+    // Later uploads stream through the virtual texture's own pool, so the scene's staging chunks
+    // are freed as soon as the copies have finished instead of staying mapped for the whole run.
+    scheduler.waitIdle();
+    stagingPool.destroy();
+    scheduler.destroy();
+}
+
+void SceneResources::destroy() {
+    stagingPool.destroy();
+
+    shadowSampler = VK_NULL_HANDLE;
+    residency.destroy();
+    virtualTexture.destroy();
+    assets.close();
+
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+
+    geometry.destroy();
+    meshes.clear();
+    meshLods.clear();
+
+    graph = SceneGraph();
+    rootNode = NO_SCENE_NODE;
+}
+
+void SceneResources::updateTextures() {
+    residency.update();
+    virtualTexture.update();
+}
+
+// Both samplers are fixed for the scene's lifetime, so they are baked into the layout as
+// immutable samplers and descriptor writes only supply the image views.
+void SceneResources::createDescriptorSetLayout() {
+    VkSampler cacheSampler = virtualTexture.getCacheSampler();
+
+    VkDescriptorSetLayoutBinding uboLayoutBinding{};
+    uboLayoutBinding.binding = 0;
+    uboLayoutBinding.descriptorCount = 1;
+    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    uboLayoutBinding.pImmutableSamplers = nullptr;
+    // The fragment shader reads the shadow cascades' matrices and splits.
+    uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutBinding samplerLayoutBinding{};
+    samplerLayoutBinding.binding = 1;
+    samplerLayoutBinding.descriptorCount = 1;
+    samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    samplerLayoutBinding.pImmutableSamplers = &cacheSampler;
+    samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutBinding shadowMapLayoutBinding{};
+    shadowMapLayoutBinding.binding = 2;
+    shadowMapLayoutBinding.descriptorCount = 1;
+    shadowMapLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    shadowMapLayoutBinding.pImmutableSamplers = &shadowSampler;
+    shadowMapLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutBinding pageTableLayoutBinding{};
+    pageTableLayoutBinding.binding = 3;
+    pageTableLayoutBinding.descriptorCount = 1;
+    pageTableLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    pageTableLayoutBinding.pImmutableSamplers = nullptr;
+    pageTableLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    std::array<VkDescriptorSetLayoutBinding, 4> bindings
+        = {uboLayoutBinding, samplerLayoutBinding, shadowMapLayoutBinding, pageTableLayoutBinding};
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout)
+        != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor set layout!");
+    }
+}
+
+void SceneResources::createShadowSampler() {
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    samplerInfo.compareEnable = VK_TRUE;
+    samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+
+    shadowSampler = vulkanDevice->getSampler(samplerInfo);
+}
+
+// With mappable device memory the arena is written directly; otherwise the data goes through
+// the staging pool and the transfer queue. Both copy straight out of the mapped pack, which
+// already holds the position stream for depth-only passes. Every level of detail shares the
+// mesh's vertices, and their indices follow each other in its index range.
+void SceneResources::uploadMesh(UploadBatch& batch, const AssetPackEntry& entry,
+                                const AssetPack& assets) {
+    const auto* meshVertices = static_cast<const Vertex*>(assets.getPayload(entry));
+    const float* meshPositions = assets.getPositions(entry);
+    const uint16_t* meshIndices = assets.getIndices(entry);
+    uint32_t vertexCount = entry.vertexCount;
+    uint32_t indexCount = entry.indexCount;
+
+    GeometryHandle mesh = geometry.allocate(vertexCount, indexCount);
+    meshes.push_back(mesh);
+
+    MeshLods lods;
+    lods.count = entry.lodCount;
+    uint32_t firstIndex = 0;
+    for (uint32_t lod = 0; lod < entry.lodCount; lod++) {
+        lods.firstIndex[lod] = firstIndex;
+        lods.indexCount[lod] = entry.lodIndexCounts[lod];
+        firstIndex += entry.lodIndexCounts[lod];
+    }
+    lods.boundingSphere = glm::vec4(entry.boundingSphere[0], entry.boundingSphere[1],
+                                    entry.boundingSphere[2], entry.boundingSphere[3]);
+    meshLods.push_back(lods);
+
+    VkDeviceSize vertexOffset = geometry.getVertexDataOffset(mesh);
+    VkDeviceSize positionOffset = geometry.getPositionDataOffset(mesh);
+    VkDeviceSize indexOffset = geometry.getIndexDataOffset(mesh);
+    if (geometry.getVertexMapping() != nullptr) {
+        memcpy(static_cast<char*>(geometry.getVertexMapping()) + vertexOffset, meshVertices,
+               sizeof(Vertex) * vertexCount);
+        memcpy(static_cast<char*>(geometry.getPositionMapping()) + positionOffset,
+               meshPositions, sizeof(glm::vec3) * vertexCount);
+        memcpy(static_cast<char*>(geometry.getIndexMapping()) + indexOffset, meshIndices,
+               sizeof(uint16_t) * indexCount);
+        return;
+    }
+
+    uploadBuffer(batch, meshVertices, sizeof(Vertex) * vertexCount, geometry.getVertexBuffer(),
+                 vertexOffset);
+    uploadBuffer(batch, meshPositions, sizeof(glm::vec3) * vertexCount,
+                 geometry.getPositionBuffer(), positionOffset);
+    uploadBuffer(batch, meshIndices, sizeof(uint16_t) * indexCount, geometry.getIndexBuffer(),
+                 indexOffset);
+}
+
+// Records a copy of contents into buffer at offset, split into pieces that fit a staging chunk.
+void SceneResources::uploadBuffer(UploadBatch& batch, const void* contents, VkDeviceSize size,
+                                  VkBuffer buffer, VkDeviceSize offset) {
+    const char* source = static_cast<const char*>(contents);
+    for (VkDeviceSize copied = 0; copied < size;) {
+        StagingAllocation staging
+            = stagingPool.allocate(std::min(size - copied, StagingPool::getMaxAllocationSize()));
+        memcpy(staging.data, source + copied, (size_t)staging.size);
+
+        VkBufferCopy copyRegion{};
+        copyRegion.srcOffset = staging.offset;
+        copyRegion.dstOffset = offset + copied;
+        copyRegion.size = staging.size;
+        vkCmdCopyBuffer(batch.transferCommands, staging.buffer, buffer, 1, &copyRegion);
+        copied += staging.size;
+    }
+
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+    barrier.buffer = buffer;
+    barrier.offset = offset;
+    barrier.size = size;
+    recordHandOver(*vulkanDevice, batch.transferCommands, batch.graphicsCommands, barrier,
+                   VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+}
+
+// The root carries the whole scene; four smaller copies sit around it and follow its transform.
+void SceneResources::createSceneGraph() {
+    rootNode = graph.createNode();
+
+    for (glm::vec3 offset : {glm::vec3(1.0f, 1.0f, 0.0f), glm::vec3(-1.0f, 1.0f, 0.0f),
+                             glm::vec3(-1.0f, -1.0f, 0.0f), glm::vec3(1.0f, -1.0f, 0.0f)}) {
+        glm::mat4 local = glm::translate(glm::mat4(1.0f), offset);
+        graph.createNode(rootNode, glm::scale(local, glm::vec3(0.35f)));
+    }
+
+    graph.update();
+}
@@ -0,0 +1,468 @@
+#include "SceneView.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#include "GraphicsPipeline.h"
+#include "SceneResources.h"
+#include "VulkanDevice.h"
+
+static const glm::vec3 EYE_POSITION(2.0f, 2.0f, 2.0f);
+static const float NEAR_PLANE = 0.1f;
+static const float FAR_PLANE = 10.0f;
+
+// Direction the light travels in.
+static const glm::vec3 LIGHT_DIRECTION(-0.4f, -0.3f, -1.0f);
+// Blend between logarithmic (1) and uniform (0) cascade splits.
+static const float CASCADE_SPLIT_LAMBDA = 0.75f;
+
+// Fits an orthographic light projection around each cascade's slice of the view frustum. Bounding
+// the slice with a sphere keeps the projection's size fixed while the camera turns, and snapping
+// its origin to whole shadow map texels keeps the shadow edges from shimmering as it moves.
+static void computeShadowCascades(const glm::mat4& view, const glm::mat4& proj,
+                                  UniformBufferObject& ubo) {
+    // The frustum's corners on the near and far planes.
+    glm::mat4 inverseViewProj = glm::inverse(proj * view);
+    std::array<glm::vec3, 8> corners;
+    for (uint32_t i = 0; i < corners.size(); i++) {
+        glm::vec4 corner = inverseViewProj
+                           * glm::vec4(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f,
+                                       i & 4 ? 1.0f : 0.0f, 1.0f);
+        corners[i] = glm::vec3(corner) / corner.w;
+    }
+
+    glm::vec3 lightDirection = glm::normalize(LIGHT_DIRECTION);
+    float sliceStart = NEAR_PLANE;
+    for (uint32_t cascade = 0; cascade < SHADOW_CASCADE_COUNT; cascade++) {
+        float fraction = (cascade + 1) / static_cast<float>(SHADOW_CASCADE_COUNT);
+        float logSplit = NEAR_PLANE * std::pow(FAR_PLANE / NEAR_PLANE, fraction);
+        float uniformSplit = NEAR_PLANE + (FAR_PLANE - NEAR_PLANE) * fraction;
+        float sliceEnd
+            = CASCADE_SPLIT_LAMBDA * logSplit + (1.0f - CASCADE_SPLIT_LAMBDA) * uniformSplit;
+
+        // View depth is linear along each edge from a near corner to its far corner.
+        std::array<glm::vec3, 8> sliceCorners;
+        glm::vec3 center(0.0f);
+        for (uint32_t i = 0; i < 4; i++) {
+            glm::vec3 edge = corners[i + 4] - corners[i];
+            sliceCorners[i]
+                = corners[i] + edge * ((sliceStart - NEAR_PLANE) / (FAR_PLANE - NEAR_PLANE));
+            sliceCorners[i + 4]
+                = corners[i] + edge * ((sliceEnd - NEAR_PLANE) / (FAR_PLANE - NEAR_PLANE));
+            center += sliceCorners[i] + sliceCorners[i + 4];
+        }
+        center /= 8.0f;
+
+        float radius = 0.0f;
+        for (const glm::vec3& corner : sliceCorners) {
+            radius = std::max(radius, glm::distance(corner, center));
+        }
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+
+        glm::mat4 lightView = glm::lookAt(center - lightDirection * radius, center,
+                                          glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 lightProj = glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius);
+
+        glm::vec4 origin = lightProj * lightView * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        glm::vec2 texels = glm::vec2(origin) * (SHADOW_MAP_SIZE / 2.0f);
+        glm::vec2 offset = (glm::round(texels) - texels) * (2.0f / SHADOW_MAP_SIZE);
+        lightProj[3][0] += offset.x;
+        lightProj[3][1] += offset.y;
+
+        ubo.lightViewProj[cascade] = lightProj * lightView;
+        ubo.cascadeSplits[cascade] = sliceEnd;
+        sliceStart = sliceEnd;
+    }
+}
+
+void SceneView::create(const VulkanDevice& vulkanDevice, const SceneResources& scene,
+                       uint32_t imageCount, VkImageView shadowMap) {
+    this->scene = &scene;
+    device = vulkanDevice.getDevice();
+
+    VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+
+    uniformBuffers.resize(imageCount);
+    uniformBuffersMemory.resize(imageCount);
+
+    for (size_t i = 0; i < imageCount; i++) {
+        vulkanDevice.createBuffer(
+            bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            uniformBuffers[i], uniformBuffersMemory[i]);
+    }
+
+    // Host visible so only the changed transforms are written, without a staging copy. LOD
+    // selection reads them as a storage buffer.
+    const SceneGraph& graph = scene.getGraph();
+    instanceCount = graph.getInstanceCount();
+    VkDeviceSize instanceBufferSize = sizeof(InstanceData) * instanceCount;
+
+    instanceBuffers.resize(imageCount);
+    instanceBuffersMemory.resize(imageCount);
+    instanceMappings.resize(imageCount);
+    instanceVersions.assign(imageCount, graph.getVersion());
+
+    for (size_t i = 0; i < imageCount; i++) {
+        vulkanDevice.createBuffer(
+            instanceBufferSize,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            instanceBuffers[i], instanceBuffersMemory[i]);
+
+        void* data;
+        vkMapMemory(device, instanceBuffersMemory[i], 0, instanceBufferSize, 0, &data);
+        instanceMappings[i] = static_cast<InstanceData*>(data);
+        memcpy(data, graph.getInstanceTransforms(), (size_t)instanceBufferSize);
+    }
+
+    // Indirect draws need a non-zero firstInstance, since each node draws its own instance.
+    const VkPhysicalDeviceFeatures& features = vulkanDevice.getEnabledFeatures();
+    if (features.drawIndirectFirstInstance) {
+        indirect.capacity = instanceCount * static_cast<uint32_t>(scene.getMeshes().size());
+        indirect.multiDraw = features.multiDrawIndirect == VK_TRUE;
+        shadowIndirect = indirect;
+        shadowIndirect.offset = sizeof(VkDrawIndexedIndirectCommand) * indirect.capacity;
+        feedbackIndirect = indirect;
+        feedbackIndirect.offset = 2 * shadowIndirect.offset;
+        VkDeviceSize indirectBufferSize = 3 * shadowIndirect.offset;
+
+        indirectBuffers.resize(imageCount);
+        indirectBuffersMemory.resize(imageCount);
+        indirectMappings.resize(imageCount);
+
+        for (size_t i = 0; i < imageCount; i++) {
+            vulkanDevice.createBuffer(
+                indirectBufferSize,
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                indirectBuffers[i], indirectBuffersMemory[i]);
+
+            void* data;
+            vkMapMemory(device, indirectBuffersMemory[i], 0, indirectBufferSize, 0, &data);
+            indirectMappings[i] = static_cast<VkDrawIndexedIndirectCommand*>(data);
+        }
+
+        lodSelector.create(vulkanDevice, uniformBuffers, instanceBuffers, indirectBuffers,
+                           3 * indirect.capacity);
+    }
+
+    createDescriptorPool(imageCount);
+    createDescriptorSets(imageCount, shadowMap);
+}
+
+void SceneView::destroy() {
+    for (size_t i = 0; i < uniformBuffers.size(); i++) {
+        vkDestroyBuffer(device, uniformBuffers[i], nullptr);
+        vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
+    }
+    uniformBuffers.clear();
+    uniformBuffersMemory.clear();
+
+    for (size_t i = 0; i < instanceBuffers.size(); i++) {
+        vkUnmapMemory(device, instanceBuffersMemory[i]);
+        vkDestroyBuffer(device, instanceBuffers[i], nullptr);
+        vkFreeMemory(device, instanceBuffersMemory[i], nullptr);
+    }
+    instanceBuffers.clear();
+
+    if (!indirectBuffers.empty()) {
+        lodSelector.destroy();
+    }
+    for (size_t i = 0; i < indirectBuffers.size(); i++) {
+        vkUnmapMemory(device, indirectBuffersMemory[i]);
+        vkDestroyBuffer(device, indirectBuffers[i], nullptr);
+        vkFreeMemory(device, indirectBuffersMemory[i], nullptr);
+    }
+    indirectBuffers.clear();
+    indirectBuffersMemory.clear();
+    indirectMappings.clear();
+    indirect = {};
+    shadowIndirect = {};
+    feedbackIndirect = {};
+    instanceBuffersMemory.clear();
+    instanceMappings.clear();
+    instanceVersions.clear();
+
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    descriptorPool = VK_NULL_HANDLE;
+    descriptorSets.clear();
+}
+
+void SceneView::createDescriptorPool(uint32_t imageCount) {
+    std::array<VkDescriptorPoolSize, 3> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[0].descriptorCount = imageCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[1].descriptorCount = 2 * imageCount;
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[2].descriptorCount = imageCount;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = imageCount;
+
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor pool!");
+    }
+}
+
+void SceneView::createDescriptorSets(uint32_t imageCount, VkImageView shadowMap) {
+    std::vector<VkDescriptorSetLayout> layouts(imageCount, scene->getDescriptorSetLayout());
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = imageCount;
+    allocInfo.pSetLayouts = layouts.data();
+
+    descriptorSets.resize(imageCount);
+    if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate descriptor sets!");
+    }
+
+    for (size_t i = 0; i < imageCount; i++) {
+        VkDescriptorBufferInfo bufferInfo{};
+        bufferInfo.buffer = uniformBuffers[i];
+        bufferInfo.offset = 0;
+        bufferInfo.range = sizeof(UniformBufferObject);
+
+        const VirtualTexture& virtualTexture = scene->getVirtualTexture();
+        // Both samplers are immutable in the scene's layout.
+        VkDescriptorImageInfo imageInfo{};
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfo.imageView = virtualTexture.getCacheImageView();
+
+        VkDescriptorImageInfo shadowMapInfo{};
+        shadowMapInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        shadowMapInfo.imageView = shadowMap;
+
+        VkDescriptorBufferInfo pageTableInfo{};
+        pageTableInfo.buffer = virtualTexture.getPageTable();
+        pageTableInfo.offset = 0;
+        pageTableInfo.range = VK_WHOLE_SIZE;
+
+        std::array<VkWriteDescriptorSet, 4> descriptorWrites{};
+
+        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[0].dstSet = descriptorSets[i];
+        descriptorWrites[0].dstBinding = 0;
+        descriptorWrites[0].dstArrayElement = 0;
+        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        descriptorWrites[0].descriptorCount = 1;
+        descriptorWrites[0].pBufferInfo = &bufferInfo;
+
+        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[1].dstSet = descriptorSets[i];
+        descriptorWrites[1].dstBinding = 1;
+        descriptorWrites[1].dstArrayElement = 0;
+        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[1].descriptorCount = 1;
+        descriptorWrites[1].pImageInfo = &imageInfo;
+
+        descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[2].dstSet = descriptorSets[i];
+        descriptorWrites[2].dstBinding = 2;
+        descriptorWrites[2].dstArrayElement = 0;
+        descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[2].descriptorCount = 1;
+        descriptorWrites[2].pImageInfo = &shadowMapInfo;
+
+        descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[3].dstSet = descriptorSets[i];
+        descriptorWrites[3].dstBinding = 3;
+        descriptorWrites[3].dstArrayElement = 0;
+        descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[3].descriptorCount = 1;
+        descriptorWrites[3].pBufferInfo = &pageTableInfo;
+
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()),
+                               descriptorWrites.data(), 0, nullptr);
+    }
+}
+
+void SceneView::setShadowMap(VkImageView shadowMap) {
+    VkDescriptorImageInfo shadowMapInfo{};
+    shadowMapInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    shadowMapInfo.imageView = shadowMap;
+
+    std::vector<VkWriteDescriptorSet> descriptorWrites(descriptorSets.size());
+    for (size_t i = 0; i < descriptorSets.size(); i++) {
+        descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[i].dstSet = descriptorSets[i];
+        descriptorWrites[i].dstBinding = 2;
+        descriptorWrites[i].dstArrayElement = 0;
+        descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[i].descriptorCount = 1;
+        descriptorWrites[i].pImageInfo = &shadowMapInfo;
+    }
+
+    vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()),
+                           descriptorWrites.data(), 0, nullptr);
+}
+
+void SceneView::updateUniformBuffer(uint32_t imageIndex, VkExtent2D extent) {
+    // Object motion comes from the scene graph's instance transforms.
+    UniformBufferObject ubo{};
+    ubo.model = glm::mat4(1.0f);
+    ubo.view = glm::lookAt(EYE_POSITION, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    ubo.proj = glm::perspective(glm::radians(45.0f), extent.width / (float)extent.height,
+                                NEAR_PLANE, FAR_PLANE);
+    ubo.proj[1][1] *= -1;
+    computeShadowCascades(ubo.view, ubo.proj, ubo);
+
+    const VirtualTexture& virtualTexture = scene->getVirtualTexture();
+    ubo.virtualTexture = glm::vec4(virtualTexture.getWidth(), virtualTexture.getHeight(),
+                                   virtualTexture.getLevelCount(), 0.0f);
+    ubo.virtualTextureTiles = glm::vec4(virtualTexture.getTileSize(),
+                                        virtualTexture.getTileBorder(),
+                                        virtualTexture.getCacheSize(), 0.0f);
+
+    void* data;
+    vkMapMemory(device, uniformBuffersMemory[imageIndex], 0, sizeof(ubo), 0, &data);
+    memcpy(data, &ubo, sizeof(ubo));
+    vkUnmapMemory(device, uniformBuffersMemory[imageIndex]);
+}
+
+void SceneView::updateInstances(uint32_t imageIndex) {
+    const SceneGraph& graph = scene->getGraph();
+    if (instanceVersions[imageIndex] == graph.getVersion()) {
+        return;
+    }
+
+    const glm::mat4* transforms = graph.getInstanceTransforms();
+    InstanceData* instances = instanceMappings[imageIndex];
+
+    changedInstances.clear();
+    if (graph.getChangesSince(instanceVersions[imageIndex], changedInstances)) {
+        // The history can repeat an instance; copying it twice is cheaper than deduplicating.
+        for (uint32_t instance : changedInstances) {
+            if (instance < instanceCount) {
+                instances[instance].model = transforms[instance];
+            }
+        }
+    } else {
+        uint32_t count = std::min(instanceCount, graph.getInstanceCount());
+        memcpy(static_cast<void*>(instances), transforms, sizeof(InstanceData) * count);
+    }
+
+    instanceVersions[imageIndex] = graph.getVersion();
+}
+
+void SceneView::draw(VkCommandBuffer commandBuffer, const GraphicsPipeline& pipeline,
+                     uint32_t imageIndex) {
+    queueDraws(renderQueue, pipeline, scene->getGeometry().getVertexBuffer(), imageIndex);
+    recordQueue(renderQueue, indirect, commandBuffer, imageIndex);
+}
+
+void SceneView::drawShadowCasters(VkCommandBuffer commandBuffer, const GraphicsPipeline& pipeline,
+                                  uint32_t imageIndex) {
+    queueDraws(shadowQueue, pipeline, scene->getGeometry().getPositionBuffer(), imageIndex);
+    recordQueue(shadowQueue, shadowIndirect, commandBuffer, imageIndex);
+}
+
+void SceneView::drawFeedback(VkCommandBuffer commandBuffer, const GraphicsPipeline& pipeline,
+                             uint32_t imageIndex) {
+    queueDraws(feedbackQueue, pipeline, scene->getGeometry().getVertexBuffer(), imageIndex);
+    recordQueue(feedbackQueue, feedbackIndirect, commandBuffer, imageIndex);
+}
+
+void SceneView::selectLods(VkCommandBuffer commandBuffer, uint32_t imageIndex) const {
+    if (!indirectBuffers.empty()) {
+        lodSelector.record(commandBuffer, imageIndex);
+    }
+}
+
+void SceneView::reloadPipelines() {
+    if (!indirectBuffers.empty()) {
+        lodSelector.reloadPipeline();
+    }
+}
+
+void SceneView::queueDraws(RenderQueue& queue, const GraphicsPipeline& pipeline,
+                           VkBuffer vertexBuffer, uint32_t imageIndex) {
+    const SceneGraph& graph = scene->getGraph();
+    const glm::mat4* transforms = graph.getInstanceTransforms();
+    const GeometryArena& geometry = scene->getGeometry();
+
+    RenderQueueItem item{};
+    item.pipeline = pipeline.getHandle();
+    item.pipelineLayout = pipeline.getLayout();
+    item.descriptorSet = descriptorSets[imageIndex];
+    item.vertexBuffer = vertexBuffer;
+    item.instanceBuffer = instanceBuffers[imageIndex];
+    item.indexBuffer = geometry.getIndexBuffer();
+    item.indexType = geometry.getIndexType();
+
+    // Depth is taken when the commands are recorded, which is enough for a front to back order
+    // of opaque geometry.
+    // Draws are recorded with the finest level of detail; selectLods() patches indirect draws
+    // to the level each needs.
+    const std::vector<GeometryHandle>& meshes = scene->getMeshes();
+    queue.clear();
+    for (uint32_t instance = 0; instance < instanceCount; instance++) {
+        float distance = glm::distance(glm::vec3(transforms[instance][3]), EYE_POSITION);
+        item.depth = (distance - NEAR_PLANE) / (FAR_PLANE - NEAR_PLANE);
+        item.firstInstance = instance;
+
+        for (uint32_t mesh = 0; mesh < meshes.size(); mesh++) {
+            const GeometryRange& range = geometry.getRange(meshes[mesh]);
+            const MeshLods& lods = scene->getMeshLods()[mesh];
+            item.indexCount = lods.indexCount[0];
+            item.firstIndex = range.firstIndex + lods.firstIndex[0];
+            item.vertexOffset = range.vertexOffset;
+            item.userData = mesh;
+            queue.add(item);
+        }
+    }
+
+    queue.sort(std::thread::hardware_concurrency());
+}
+
+// The commands are written while the image's previous frame is no longer in flight.
+void SceneView::recordQueue(RenderQueue& queue, RenderQueueIndirectBuffer& queueIndirect,
+                            VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+    if (indirectBuffers.empty()) {
+        queue.record(commandBuffer);
+        return;
+    }
+
+    uint32_t firstCommand
+        = static_cast<uint32_t>(queueIndirect.offset / sizeof(VkDrawIndexedIndirectCommand));
+    queueIndirect.buffer = indirectBuffers[imageIndex];
+    queueIndirect.commands = indirectMappings[imageIndex] + firstCommand;
+    queue.record(commandBuffer, &queueIndirect);
+
+    // Tell the LOD selection which mesh and instances each command draws; the rest of the
+    // queue's commands are unused.
+    const GeometryArena& geometry = scene->getGeometry();
+    const std::vector<uint32_t>& commandItems = queue.getIndirectItems();
+    LodDraw* draws = lodSelector.getDraws(imageIndex) + firstCommand;
+    for (uint32_t i = 0; i < queueIndirect.capacity; i++) {
+        LodDraw draw{};
+        if (i < commandItems.size()) {
+            uint32_t mesh = queue.getItem(commandItems[i]).userData;
+            const MeshLods& lods = scene->getMeshLods()[mesh];
+            const GeometryRange& range = geometry.getRange(scene->getMeshes()[mesh]);
+
+            draw.firstInstance = queueIndirect.commands[i].firstInstance;
+            draw.instanceCount = queueIndirect.commands[i].instanceCount;
+            draw.lodCount = lods.count;
+            for (uint32_t lod = 0; lod < lods.count; lod++) {
+                draw.firstIndex[lod] = range.firstIndex + lods.firstIndex[lod];
+                draw.indexCount[lod] = lods.indexCount[lod];
+            }
+            for (uint32_t c = 0; c < 4; c++) {
+                draw.boundingSphere[c] = lods.boundingSphere[c];
+            }
+        }
+        draws[i] = draw;
+    }
+}
@@ -0,0 +1,268 @@
+#include "ShaderHotReload.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <stdexcept>
+
+#ifdef __linux__
+#    include <poll.h>
+#    include <sys/inotify.h>
+#    include <unistd.h>
+#endif
+
+#include "Log.h"
+
+static const std::set<std::string> shaderExtensions
+    = {".vert", ".frag", ".comp", ".geom", ".tesc", ".tese"};
+// Files shaders #include; a change to one recompiles every shader in the directory.
+static const std::set<std::string> includeExtensions = {".glsl", ".h", ".inc"};
+
+static bool readFile(const std::string& path, std::vector<unsigned char>& contents) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// Appends the contents of every file source #includes, recursively, so that an edit to an
+// included file changes the hash of each shader using it. Includes are looked up next to the
+// including file, then in the shader directory; missing ones are left for glslc to report.
+static void appendIncludes(const std::filesystem::path& directory,
+                           const std::string& shaderDirectory,
+                           const std::vector<unsigned char>& source,
+                           std::set<std::string>& visited, std::vector<unsigned char>& sources) {
+    std::string text(source.begin(), source.end());
+    size_t lineStart = 0;
+    while (lineStart < text.size()) {
+        size_t lineEnd = text.find('\n', lineStart);
+        if (lineEnd == std::string::npos) {
+            lineEnd = text.size();
+        }
+        std::string line = text.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+
+        size_t directive = line.find_first_not_of(" \t");
+        if (directive == std::string::npos || line[directive] != '#') {
+            continue;
+        }
+        size_t keyword = line.find_first_not_of(" \t", directive + 1);
+        if (keyword == std::string::npos || line.compare(keyword, 7, "include") != 0) {
+            continue;
+        }
+        size_t open = line.find_first_of("\"<", keyword + 7);
+        if (open == std::string::npos) {
+            continue;
+        }
+        size_t close = line.find(line[open] == '"' ? '"' : '>', open + 1);
+        if (close == std::string::npos) {
+            continue;
+        }
+        std::string name = line.substr(open + 1, close - open - 1);
+
+        std::filesystem::path includePath = directory / name;
+        std::error_code error;
+        if (!std::filesystem::exists(includePath, error)) {
+            includePath = std::filesystem::path(shaderDirectory) / name;
+        }
+        std::string key = includePath.lexically_normal().string();
+        std::vector<unsigned char> contents;
+        if (!visited.insert(key).second || !readFile(key, contents)) {
+            continue;
+        }
+
+        sources.insert(sources.end(), key.begin(), key.end());
+        sources.insert(sources.end(), contents.begin(), contents.end());
+        appendIncludes(includePath.parent_path(), shaderDirectory, contents, visited, sources);
+    }
+}
+
+// 64-bit FNV-1a, seeded with the extension because glslc derives the shader stage from it.
+// sources are the shader's own source followed by its includes.
+static uint64_t hashShaderSource(const std::string& extension,
+                                 const std::vector<unsigned char>& sources) {
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](unsigned char byte) {
+        hash ^= byte;
+        hash *= 1099511628211ull;
+    };
+
+    std::for_each(extension.begin(), extension.end(), mix);
+    std::for_each(sources.begin(), sources.end(), mix);
+    return hash;
+}
+
+ShaderHotReloader::ShaderHotReloader(std::string shaderDirectory, std::string cacheDirectory,
+                                     std::string compiler)
+    : shaderDirectory(std::move(shaderDirectory)),
+      cacheDirectory(std::move(cacheDirectory)),
+      compiler(std::move(compiler)) {}
+
+ShaderHotReloader::~ShaderHotReloader() { stop(); }
+
+void ShaderHotReloader::start() {
+#ifdef __linux__
+    // Without a cache directory every reload fails to compile, which is logged; the app runs on.
+    std::error_code error;
+    std::filesystem::create_directories(cacheDirectory, error);
+    if (error) {
+        LOG(Shaders, Error,
+            "failed to create shader cache " << cacheDirectory << ": " << error.message());
+    }
+
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0) {
+        throw std::runtime_error("failed to initialize inotify!");
+    }
+
+    // Editors either rewrite the file in place or move a temporary file over it.
+    if (inotify_add_watch(inotifyFd, shaderDirectory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        close(inotifyFd);
+        inotifyFd = -1;
+        throw std::runtime_error("failed to watch shader directory!");
+    }
+
+    running = true;
+    watcher = std::thread(&ShaderHotReloader::watch, this);
+#else
+    throw std::runtime_error("shader hot reload requires inotify!");
+#endif
+}
+
+void ShaderHotReloader::stop() {
+    running = false;
+    if (watcher.joinable()) {
+        watcher.join();
+    }
+
+#ifdef __linux__
+    if (inotifyFd >= 0) {
+        close(inotifyFd);
+        inotifyFd = -1;
+    }
+#endif
+}
+
+std::vector<ShaderUpdate> ShaderHotReloader::takeUpdates() {
+    std::vector<ShaderUpdate> result;
+    std::lock_guard<std::mutex> lock(updatesMutex);
+    result.swap(updates);
+    return result;
+}
+
+void ShaderHotReloader::watch() {
+#ifdef __linux__
+    alignas(inotify_event) char buffer[4096];
+    pollfd pollInfo{inotifyFd, POLLIN, 0};
+
+    while (running) {
+        // Wake up regularly so stop() does not have to wait for a file event.
+        if (poll(&pollInfo, 1, 100) <= 0) {
+            continue;
+        }
+
+        ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            continue;
+        }
+
+        // A single save often produces several events for the same file.
+        std::set<std::string> changed;
+        bool includeChanged = false;
+        for (char* it = buffer; it < buffer + length;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(it);
+            if (event->len > 0) {
+                std::string extension = std::filesystem::path(event->name).extension().string();
+                if (shaderExtensions.count(extension)) {
+                    changed.insert(event->name);
+                }
+                includeChanged |= includeExtensions.count(extension) > 0;
+            }
+            it += sizeof(inotify_event) + event->len;
+        }
+
+        // Shaders that do not use the changed file hash as before and come from the cache.
+        if (includeChanged) {
+            std::error_code error;
+            for (const auto& entry : std::filesystem::directory_iterator(shaderDirectory, error)) {
+                if (shaderExtensions.count(entry.path().extension().string())) {
+                    changed.insert(entry.path().filename().string());
+                }
+            }
+        }
+
+        for (const std::string& fileName : changed) {
+            ShaderUpdate update;
+            if (!compile(fileName, update.code)) {
+                continue;
+            }
+
+            update.name = fileName;
+            std::replace(update.name.begin(), update.name.end(), '.', '_');
+
+            std::lock_guard<std::mutex> lock(updatesMutex);
+            updates.push_back(std::move(update));
+        }
+    }
+#endif
+}
+
+bool ShaderHotReloader::compile(const std::string& fileName, std::vector<uint32_t>& code) {
+    std::string sourcePath = shaderDirectory + "/" + fileName;
+
+    std::vector<unsigned char> source;
+    if (!readFile(sourcePath, source)) {
+        LOG(Shaders, Error, "failed to read shader " << sourcePath << "!");
+        return false;
+    }
+
+    std::vector<unsigned char> sources = source;
+    std::set<std::string> visited;
+    appendIncludes(std::filesystem::path(sourcePath).parent_path(), shaderDirectory, source,
+                   visited, sources);
+
+    char hashName[32];
+    std::snprintf(hashName, sizeof(hashName), "%016llx.spv",
+                  static_cast<unsigned long long>(hashShaderSource(
+                      std::filesystem::path(fileName).extension().string(), sources)));
+    std::string cachePath = cacheDirectory + "/" + hashName;
+
+    // Runs on the watcher thread, so filesystem failures skip this reload instead of throwing.
+    std::error_code error;
+    if (!std::filesystem::exists(cachePath, error)) {
+        // Compile to a temporary file so a failed or interrupted build never poisons the cache.
+        std::string outputPath = cachePath + ".tmp";
+        std::string command = compiler + " \"" + sourcePath + "\" -o \"" + outputPath + "\"";
+        if (std::system(command.c_str()) != 0) {
+            LOG(Shaders, Error, "failed to compile shader " << fileName << "!");
+            return false;
+        }
+        std::filesystem::rename(outputPath, cachePath, error);
+        if (error) {
+            LOG(Shaders, Error,
+                "failed to store shader " << fileName << " in the cache: " << error.message());
+            std::filesystem::remove(outputPath, error);
+            return false;
+        }
+    }
+
+    // Copied into uint32_t storage so the words are aligned for vkCreateShaderModule.
+    std::vector<unsigned char> bytes;
+    if (!readFile(cachePath, bytes) || bytes.empty() || bytes.size() % sizeof(uint32_t) != 0) {
+        LOG(Shaders, Error, "failed to read shader cache " << cachePath << "!");
+        return false;
+    }
+    code.resize(bytes.size() / sizeof(uint32_t));
+    std::memcpy(code.data(), bytes.data(), bytes.size());
+
+    LOG(Shaders, Info, "reloaded shader " << fileName);
+    return true;
+}
@@ -0,0 +1,82 @@
+#include "ShaderRegistry.h"
+
+#include <map>
+#include <stdexcept>
+
+// The generated shader headers are only included here, so every blob is in the binary once.
+#include <base_frag.h>
+#include <base_vert.h>
+#include <vertexbuffer_frag.h>
+#include <vertexbuffer_vert.h>
+#include <shader_ubo_frag.h>
+#include <shader_ubo_vert.h>
+#include <shader_textures_frag.h>
+#include <shader_textures_vert.h>
+#include <shader_depth_frag.h>
+#include <shader_depth_vert.h>
+#include <shadow_depth_vert.h>
+#include <vt_feedback_frag.h>
+#include <lod_select_comp.h>
+#include <post_histogram_comp.h>
+#include <post_exposure_comp.h>
+#include <post_bloom_down_comp.h>
+#include <post_bloom_up_comp.h>
+#include <post_tonemap_comp.h>
+#include <post_fxaa_comp.h>
+
+struct EmbeddedShader {
+    std::string_view name;
+    ShaderCode code;
+};
+
+template <size_t N>
+static constexpr EmbeddedShader embed(std::string_view name, const uint32_t (&code)[N]) {
+    return {name, {code, N}};
+}
+
+static constexpr EmbeddedShader embeddedShaders[] = {
+    embed("base_frag", BASE_FRAG),
+    embed("base_vert", BASE_VERT),
+    embed("vertexbuffer_frag", VERTEXBUFFER_FRAG),
+    embed("vertexbuffer_vert", VERTEXBUFFER_VERT),
+    embed("shader_ubo_frag", SHADER_UBO_FRAG),
+    embed("shader_ubo_vert", SHADER_UBO_VERT),
+    embed("shader_textures_frag", SHADER_TEXTURES_FRAG),
+    embed("shader_textures_vert", SHADER_TEXTURES_VERT),
+    embed("shader_depth_frag", SHADER_DEPTH_FRAG),
+    embed("shader_depth_vert", SHADER_DEPTH_VERT),
+    embed("shadow_depth_vert", SHADOW_DEPTH_VERT),
+    embed("vt_feedback_frag", VT_FEEDBACK_FRAG),
+    embed("lod_select_comp", LOD_SELECT_COMP),
+    embed("post_histogram_comp", POST_HISTOGRAM_COMP),
+    embed("post_exposure_comp", POST_EXPOSURE_COMP),
+    embed("post_bloom_down_comp", POST_BLOOM_DOWN_COMP),
+    embed("post_bloom_up_comp", POST_BLOOM_UP_COMP),
+    embed("post_tonemap_comp", POST_TONEMAP_COMP),
+    embed("post_fxaa_comp", POST_FXAA_COMP),
+};
+
+ShaderCode getEmbeddedShader(std::string_view name) {
+    for (const EmbeddedShader& shader : embeddedShaders) {
+        if (shader.name == name) {
+            return shader.code;
+        }
+    }
+
+    throw std::runtime_error("unknown embedded shader " + std::string(name) + "!");
+}
+
+static std::map<std::string, std::vector<uint32_t>, std::less<>> shaderOverrides;
+
+void setShaderOverride(std::string name, std::vector<uint32_t> code) {
+    shaderOverrides[std::move(name)] = std::move(code);
+}
+
+ShaderCode getShaderCode(std::string_view name) {
+    auto it = shaderOverrides.find(name);
+    if (it != shaderOverrides.end()) {
+        return {it->second.data(), it->second.size()};
+    }
+
+    return getEmbeddedShader(name);
+}
@@ -0,0 +1,120 @@
+#include "StagingPool.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "QueueScheduler.h"
+#include "VulkanDevice.h"
+
+static const VkDeviceSize MIN_CHUNK_SIZE = 1 << 20;
+static const VkDeviceSize MAX_CHUNK_SIZE = 64 << 20;
+// A free chunk is released after this many recycle() calls without being written.
+static const uint32_t IDLE_RECYCLES_BEFORE_RELEASE = 120;
+
+void StagingPool::create(const VulkanDevice& vulkanDevice) {
+    this->vulkanDevice = &vulkanDevice;
+    device = vulkanDevice.getDevice();
+    nextChunkSize = MIN_CHUNK_SIZE;
+}
+
+void StagingPool::destroy() {
+    for (Chunk& chunk : chunks) {
+        destroyChunk(chunk);
+    }
+    chunks.clear();
+}
+
+void StagingPool::destroyChunk(Chunk& chunk) {
+    vkUnmapMemory(device, chunk.memory);
+    vkDestroyBuffer(device, chunk.buffer, nullptr);
+    vkFreeMemory(device, chunk.memory, nullptr);
+}
+
+VkDeviceSize StagingPool::getMaxAllocationSize() { return MAX_CHUNK_SIZE; }
+
+StagingAllocation StagingPool::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+    if (size > MAX_CHUNK_SIZE) {
+        throw std::runtime_error("staging allocation exceeds the chunk size!");
+    }
+
+    // Chunks already being written come first, so one upload batch fills as few as possible.
+    Chunk* target = nullptr;
+    VkDeviceSize offset = 0;
+    for (bool written : {true, false}) {
+        for (Chunk& chunk : chunks) {
+            if (chunk.retired || (chunk.used > 0) != written) {
+                continue;
+            }
+            VkDeviceSize aligned = (chunk.used + alignment - 1) & ~(alignment - 1);
+            if (aligned + size <= chunk.size) {
+                target = &chunk;
+                offset = aligned;
+                break;
+            }
+        }
+        if (target != nullptr) {
+            break;
+        }
+    }
+
+    if (target == nullptr) {
+        // Running out while chunks are still in flight means uploads outpace the pool.
+        bool busy = std::any_of(chunks.begin(), chunks.end(),
+                                [](const Chunk& chunk) { return chunk.retired; });
+        if (busy) {
+            nextChunkSize = std::min(nextChunkSize * 2, MAX_CHUNK_SIZE);
+        }
+
+        Chunk chunk;
+        chunk.size = std::max(nextChunkSize, size);
+        vulkanDevice->createBuffer(
+            chunk.size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            chunk.buffer, chunk.memory);
+        vkMapMemory(device, chunk.memory, 0, chunk.size, 0, &chunk.data);
+
+        chunks.push_back(chunk);
+        target = &chunks.back();
+    }
+
+    target->used = offset + size;
+    target->idleRecycles = 0;
+
+    StagingAllocation allocation;
+    allocation.buffer = target->buffer;
+    allocation.offset = offset;
+    allocation.size = size;
+    allocation.data = static_cast<char*>(target->data) + offset;
+    return allocation;
+}
+
+void StagingPool::retire(uint64_t flushIndex) {
+    for (Chunk& chunk : chunks) {
+        if (!chunk.retired && chunk.used > 0) {
+            chunk.retired = true;
+            chunk.flushIndex = flushIndex;
+        }
+    }
+}
+
+void StagingPool::recycle(QueueScheduler& scheduler) {
+    for (Chunk& chunk : chunks) {
+        if (chunk.retired && scheduler.isFlushFinished(chunk.flushIndex)) {
+            chunk.retired = false;
+            chunk.used = 0;
+        } else if (!chunk.retired && chunk.used == 0) {
+            chunk.idleRecycles++;
+        }
+    }
+
+    auto idle = std::stable_partition(chunks.begin(), chunks.end(), [](const Chunk& chunk) {
+        return chunk.idleRecycles < IDLE_RECYCLES_BEFORE_RELEASE;
+    });
+    if (idle != chunks.end()) {
+        for (auto it = idle; it != chunks.end(); ++it) {
+            destroyChunk(*it);
+        }
+        chunks.erase(idle, chunks.end());
+        nextChunkSize = std::max(nextChunkSize / 2, MIN_CHUNK_SIZE);
+    }
+}
@@ -0,0 +1,33 @@
+#include "ValidationFilter.h"
+
+#include "Log.h"
+
+bool ValidationFilter::accept(int64_t messageId, uint32_t& repeats) {
+    auto now = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    MessageCount& count = messages[messageId];
+    if (count.reports >= VALIDATION_MAX_REPORTS
+        || (count.reports > 0 && now - count.lastReport < VALIDATION_REPEAT_INTERVAL)) {
+        count.suppressed++;
+        return false;
+    }
+
+    repeats = count.suppressed;
+    count.reports++;
+    count.suppressed = 0;
+    count.lastReport = now;
+    return true;
+}
+
+void ValidationFilter::reportSuppressed() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& message : messages) {
+        if (message.second.suppressed > 0) {
+            LOG(Validation, Info, "message " << message.first << " repeated "
+                                             << message.second.suppressed
+                                             << " more times");
+        }
+    }
+    messages.clear();
+}
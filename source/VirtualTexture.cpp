@@ -0,0 +1,682 @@
+#include "VirtualTexture.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "VulkanDevice.h"
+
+static const uint32_t NO_SLOT = UINT32_MAX;
+// Resolved level of a page with nothing resident above it; only seen before create() finishes.
+static const uint32_t NO_LEVEL = 0xff;
+// Tiles in the loader's queue or waiting for upload. Bounds the tiles uploaded per update() and
+// the memory they occupy in between.
+static const uint32_t MAX_PENDING_LOADS = 32;
+// The coarsest levels are pinned while they fit in this fraction of the cache.
+static const uint32_t PINNED_SLOT_DIVISOR = 4;
+// Slots per side of the smallest cache, whose one pinned slot holds the coarsest level.
+static const uint32_t MIN_CACHE_SLOTS = 2;
+// Updates without dropped tiles before the next finer level is streamed back in.
+static const uint32_t STREAM_IN_DELAY = 60;
+
+static uint32_t getEntryLevel(uint32_t pageEntry) {
+    return (pageEntry >> 16) & 0xff;
+}
+
+void VirtualTexture::create(const VulkanDevice& vulkanDevice, const AssetPack& assets,
+                            const AssetPackEntry& entry, VkDeviceSize cacheBudget) {
+    this->vulkanDevice = &vulkanDevice;
+    device = vulkanDevice.getDevice();
+    this->assets = &assets;
+    this->entry = &entry;
+
+    width = entry.width;
+    height = entry.height;
+    tileSize = entry.tileSize;
+    tileBorder = entry.tileBorder;
+    tileStride = tileSize + 2 * tileBorder;
+    format = static_cast<VkFormat>(entry.format);
+    cacheSlots = VIRTUAL_TEXTURE_CACHE_SLOTS;
+    while (cacheSlots > MIN_CACHE_SLOTS
+           && VkDeviceSize(cacheSlots) * cacheSlots * getTileBytes() > cacheBudget) {
+        cacheSlots--;
+    }
+    if (getCacheSize() > vulkanDevice.getProperties().limits.maxImageDimension2D) {
+        throw std::runtime_error("failed to fit virtual texture tile cache!");
+    }
+
+    uint32_t pageCount = 0;
+    for (uint32_t level = 0; level < entry.levelCount; level++) {
+        Level info;
+        info.pagesX = getVirtualPageCount(width, tileSize, level);
+        info.pagesY = getVirtualPageCount(height, tileSize, level);
+        info.firstPage = pageCount;
+        levels.push_back(info);
+        pageCount += info.pagesX * info.pagesY;
+    }
+    pageEntries.assign(pageCount, NO_LEVEL << 16);
+    pageSlots.assign(pageCount, NO_SLOT);
+    pagePending.assign(pageCount, false);
+    pageRequested.assign(pageCount, 0);
+
+    slots.resize(cacheSlots * cacheSlots);
+    residentLimit = getSlotCount();
+    for (uint32_t slot = static_cast<uint32_t>(slots.size()); slot > 0; slot--) {
+        freeSlots.push_back(slot - 1);
+    }
+
+    assets.adviseRandomAccess(entry);
+    scheduler.create(vulkanDevice);
+    stagingPool.create(vulkanDevice);
+
+    createCache();
+    createSampler();
+    createPageTable();
+    loadPinnedLevels();
+    startLoader();
+}
+
+void VirtualTexture::destroy() {
+    stopLoader();
+    scheduler.destroy();
+    stagingPool.destroy();
+
+    vkDestroyImageView(device, cacheImageView, nullptr);
+    vkDestroyImage(device, cacheImage, nullptr);
+    vkFreeMemory(device, cacheImageMemory, nullptr);
+    vkDestroyBuffer(device, pageTable, nullptr);
+    vkFreeMemory(device, pageTableMemory, nullptr);
+    cacheSampler = VK_NULL_HANDLE;
+    cacheImageView = VK_NULL_HANDLE;
+    cacheImage = VK_NULL_HANDLE;
+    cacheImageMemory = VK_NULL_HANDLE;
+    pageTable = VK_NULL_HANDLE;
+    pageTableMemory = VK_NULL_HANDLE;
+
+    levels.clear();
+    pageEntries.clear();
+    slots.clear();
+    freeSlots.clear();
+    pageSlots.clear();
+    pagePending.clear();
+    requestedPages.clear();
+    pageRequested.clear();
+    pendingLoads = 0;
+    pinnedCount = 0;
+    residentLimit = 0;
+    finestLevel = 0;
+    updatesWithoutDrops = 0;
+    coverage = 0;
+    cacheSlots = 0;
+    assets = nullptr;
+    entry = nullptr;
+}
+
+void VirtualTexture::createCache() {
+    vulkanDevice->createImage(getCacheSize(), getCacheSize(), VK_SAMPLE_COUNT_1_BIT, format,
+                              VK_IMAGE_TILING_OPTIMAL,
+                              VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, cacheImage, cacheImageMemory);
+    cacheImageView = vulkanDevice->createImageView(cacheImage, format, VK_IMAGE_ASPECT_COLOR_BIT);
+}
+
+// Tiles are sampled from a single level of the cache; their borders keep bilinear filtering
+// inside each slot, and the shader blends between levels itself.
+void VirtualTexture::createSampler() {
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+
+    cacheSampler = vulkanDevice->getSampler(samplerInfo);
+}
+
+void VirtualTexture::createPageTable() {
+    vulkanDevice->createBuffer(sizeof(uint32_t) * pageEntries.size(),
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                                   | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pageTable, pageTableMemory);
+}
+
+// Pinned tiles are never evicted, so every page resolves to at least the coarsest level.
+void VirtualTexture::loadPinnedLevels() {
+    uint32_t firstPinned = getLevelCount() - 1;
+    uint32_t pinnedPages = levels[firstPinned].pagesX * levels[firstPinned].pagesY;
+    while (firstPinned > 0) {
+        const Level& finer = levels[firstPinned - 1];
+        if (pinnedPages + finer.pagesX * finer.pagesY > slots.size() / PINNED_SLOT_DIVISOR) {
+            break;
+        }
+        pinnedPages += finer.pagesX * finer.pagesY;
+        firstPinned--;
+    }
+    pinnedCount = pinnedPages;
+
+    VkCommandBuffer commandBuffer = scheduler.beginCommands(QueueType::Graphics);
+    recordCacheBarrier(commandBuffer, VK_IMAGE_LAYOUT_UNDEFINED,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    // Coarse levels first, so each finer tile overrides the ancestor its subtree resolved to.
+    const auto* payload = static_cast<const unsigned char*>(assets->getPayload(*entry));
+    uint64_t stride = getVirtualTileStride(*entry);
+    for (uint32_t level = getLevelCount(); level-- > firstPinned;) {
+        uint32_t pageCount = levels[level].pagesX * levels[level].pagesY;
+        for (uint32_t page = levels[level].firstPage; page < levels[level].firstPage + pageCount;
+             page++) {
+            uint32_t slot = acquireSlot();
+            slots[slot].pinned = true;
+            recordTileUpload(commandBuffer, slot, payload + stride * page);
+            makeResident(page, slot);
+        }
+    }
+
+    recordPageTableUpload(commandBuffer);
+    recordCacheBarrier(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    scheduler.submit(QueueType::Graphics, commandBuffer);
+    stagingPool.retire(scheduler.flush());
+    scheduler.waitIdle();
+    stagingPool.recycle(scheduler);
+}
+
+void VirtualTexture::startLoader() {
+    loaderStopping = false;
+    loader = std::thread(&VirtualTexture::runLoader, this);
+}
+
+void VirtualTexture::stopLoader() {
+    {
+        std::lock_guard<std::mutex> lock(loaderMutex);
+        loaderStopping = true;
+        loadQueue.clear();
+        loadedTiles.clear();
+    }
+    loadAvailable.notify_all();
+    if (loader.joinable()) {
+        loader.join();
+    }
+}
+
+// Reading a tile out of the mapping is what faults its pages in from disk, so it happens here
+// rather than on the thread recording the uploads.
+void VirtualTexture::runLoader() {
+    const auto* payload = static_cast<const unsigned char*>(assets->getPayload(*entry));
+    uint64_t stride = getVirtualTileStride(*entry);
+    size_t tileBytes = static_cast<size_t>(getTileBytes());
+
+    std::unique_lock<std::mutex> lock(loaderMutex);
+    while (true) {
+        loadAvailable.wait(lock, [this] { return loaderStopping || !loadQueue.empty(); });
+        if (loaderStopping) {
+            return;
+        }
+        LoadedTile tile;
+        tile.page = loadQueue.front();
+        loadQueue.pop_front();
+        lock.unlock();
+
+        const unsigned char* source = payload + stride * tile.page;
+        tile.texels.assign(source, source + tileBytes);
+
+        lock.lock();
+        loadedTiles.push_back(std::move(tile));
+    }
+}
+
+void VirtualTexture::addFeedback(const std::vector<uint32_t>& feedback) {
+    for (uint32_t texel : feedback) {
+        uint32_t level = texel >> 24;
+        uint32_t pageY = (texel >> 12) & 0xfff;
+        uint32_t pageX = texel & 0xfff;
+        if (texel == VIRTUAL_TEXTURE_NO_FEEDBACK || level >= levels.size()
+            || pageX >= levels[level].pagesX || pageY >= levels[level].pagesY) {
+            continue;
+        }
+        uint32_t page = levels[level].firstPage + pageY * levels[level].pagesX + pageX;
+        coverage++;
+
+        // The tile the page resolves to was sampled, whether or not it is the page itself.
+        uint32_t pageEntry = pageEntries[page];
+        uint32_t slotY = (pageEntry >> 8) & 0xff;
+        slots[slotY * cacheSlots + (pageEntry & 0xff)].lastUsed = updateCount;
+
+        // Levels streamed out ask for their ancestor at the finest level streamed instead.
+        if (level < finestLevel) {
+            uint32_t shift = finestLevel - level;
+            const Level& finest = levels[finestLevel];
+            page = finest.firstPage + std::min(pageY >> shift, finest.pagesY - 1) * finest.pagesX
+                   + std::min(pageX >> shift, finest.pagesX - 1);
+        }
+
+        if (pageSlots[page] == NO_SLOT && pageRequested[page] != updateCount) {
+            pageRequested[page] = updateCount;
+            requestedPages.push_back(page);
+        }
+    }
+}
+
+uint64_t VirtualTexture::takeCoverage() {
+    uint64_t texels = coverage;
+    coverage = 0;
+    return texels;
+}
+
+void VirtualTexture::setResidentLimit(uint32_t tiles) {
+    residentLimit = std::min(std::max(tiles, pinnedCount), getSlotCount());
+}
+
+void VirtualTexture::update() {
+    stagingPool.recycle(scheduler);
+
+    // A lowered limit takes effect before anything new is uploaded.
+    while (getResidentCount() > residentLimit && evictOldest(UINT64_MAX)) {
+    }
+
+    std::vector<LoadedTile> tiles;
+    {
+        std::lock_guard<std::mutex> lock(loaderMutex);
+        tiles.swap(loadedTiles);
+    }
+
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    uint32_t droppedTiles = 0;
+    for (const LoadedTile& tile : tiles) {
+        pagePending[tile.page] = false;
+        pendingLoads--;
+        if (pageSlots[tile.page] != NO_SLOT || getPageLevel(tile.page) < finestLevel) {
+            continue;
+        }
+        // Without a slot to spare the tile is dropped; feedback asks for it again if it is
+        // still needed.
+        uint32_t slot = acquireSlot();
+        if (slot == NO_SLOT) {
+            droppedTiles++;
+            continue;
+        }
+
+        if (commandBuffer == VK_NULL_HANDLE) {
+            commandBuffer = scheduler.beginCommands(QueueType::Graphics);
+            recordCacheBarrier(commandBuffer, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        }
+        recordTileUpload(commandBuffer, slot, tile.texels.data());
+        makeResident(tile.page, slot);
+    }
+
+    if (commandBuffer != VK_NULL_HANDLE) {
+        recordCacheBarrier(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+
+    // Evictions alone only change the page table.
+    adjustFinestLevel(droppedTiles);
+    if (dirtyBegin < dirtyEnd) {
+        if (commandBuffer == VK_NULL_HANDLE) {
+            commandBuffer = scheduler.beginCommands(QueueType::Graphics);
+        }
+        recordPageTableUpload(commandBuffer);
+    }
+    if (commandBuffer != VK_NULL_HANDLE) {
+        scheduler.submit(QueueType::Graphics, commandBuffer);
+        stagingPool.retire(scheduler.flush());
+    }
+
+    // Coarser tiles first: they improve more of the screen and their descendants fall back to
+    // them.
+    std::stable_sort(requestedPages.begin(), requestedPages.end(),
+                     [this](uint32_t a, uint32_t b) { return getPageLevel(a) > getPageLevel(b); });
+    {
+        std::lock_guard<std::mutex> lock(loaderMutex);
+        for (uint32_t page : requestedPages) {
+            if (pendingLoads == MAX_PENDING_LOADS) {
+                break;
+            }
+            if (pageSlots[page] == NO_SLOT && !pagePending[page]
+                && getPageLevel(page) >= finestLevel) {
+                pagePending[page] = true;
+                pendingLoads++;
+                loadQueue.push_back(page);
+            }
+        }
+    }
+    loadAvailable.notify_one();
+    requestedPages.clear();
+
+    updateCount++;
+}
+
+VirtualTextureStats VirtualTexture::getStats() const {
+    VirtualTextureStats stats;
+    stats.residentTiles = getResidentCount();
+    stats.residentLimit = residentLimit;
+    stats.cacheSlots = getSlotCount();
+    stats.finestLevel = finestLevel;
+    stats.pendingLoads = pendingLoads;
+    stats.uploadedTiles = uploadedTiles;
+    stats.evictedTiles = evictedTiles;
+    return stats;
+}
+
+uint32_t VirtualTexture::getPageLevel(uint32_t page) const {
+    uint32_t level = 0;
+    while (level + 1 < levels.size() && levels[level + 1].firstPage <= page) {
+        level++;
+    }
+    return level;
+}
+
+uint32_t VirtualTexture::getResidentCount() const {
+    return static_cast<uint32_t>(slots.size() - freeSlots.size());
+}
+
+// A free slot below the resident limit, or the least recently used unpinned one. Tiles sampled
+// since the last update are kept, so a cache too small for the view stops streaming instead of
+// thrashing.
+uint32_t VirtualTexture::acquireSlot() {
+    // The limit never exceeds the slots, so below it there is always a free one.
+    if (getResidentCount() >= residentLimit && !evictOldest(updateCount)) {
+        return NO_SLOT;
+    }
+
+    uint32_t slot = freeSlots.back();
+    freeSlots.pop_back();
+    return slot;
+}
+
+bool VirtualTexture::evictOldest(uint64_t usedBefore) {
+    uint32_t oldest = NO_SLOT;
+    for (uint32_t slot = 0; slot < slots.size(); slot++) {
+        if (!slots[slot].pinned && slots[slot].page != UINT32_MAX
+            && (oldest == NO_SLOT || slots[slot].lastUsed < slots[oldest].lastUsed)) {
+            oldest = slot;
+        }
+    }
+    if (oldest == NO_SLOT || slots[oldest].lastUsed >= usedBefore) {
+        return false;
+    }
+
+    evict(oldest);
+    return true;
+}
+
+// Dropped tiles mean the views sample more than the limit holds. Streaming out the finest level
+// frees the most slots for the least detail; it comes back once the resident tiles would still
+// fit after growing fourfold, as one level finer does.
+void VirtualTexture::adjustFinestLevel(uint32_t droppedTiles) {
+    if (droppedTiles > 0) {
+        updatesWithoutDrops = 0;
+        if (finestLevel + 1 < getLevelCount()) {
+            finestLevel++;
+            for (uint32_t slot = 0; slot < slots.size(); slot++) {
+                if (!slots[slot].pinned && slots[slot].page != UINT32_MAX
+                    && getPageLevel(slots[slot].page) < finestLevel) {
+                    evict(slot);
+                }
+            }
+        }
+        return;
+    }
+
+    updatesWithoutDrops++;
+    if (finestLevel > 0 && updatesWithoutDrops >= STREAM_IN_DELAY
+        && getResidentCount() * 4 <= residentLimit) {
+        finestLevel--;
+        updatesWithoutDrops = 0;
+    }
+}
+
+void VirtualTexture::recordTileUpload(VkCommandBuffer commandBuffer, uint32_t slot,
+                                      const void* texels) {
+    StagingAllocation staging = stagingPool.allocate(getTileBytes());
+    memcpy(staging.data, texels, (size_t)getTileBytes());
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = staging.offset;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {static_cast<int32_t>(slot % cacheSlots * tileStride),
+                          static_cast<int32_t>(slot / cacheSlots * tileStride), 0};
+    region.imageExtent = {tileStride, tileStride, 1};
+    vkCmdCopyBufferToImage(commandBuffer, staging.buffer, cacheImage,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    uploadedTiles++;
+}
+
+void VirtualTexture::makeResident(uint32_t page, uint32_t slot) {
+    uint32_t level = getPageLevel(page);
+    slots[slot].page = page;
+    slots[slot].lastUsed = updateCount;
+    pageSlots[page] = slot;
+
+    uint32_t pageEntry = slot % cacheSlots | (slot / cacheSlots) << 8 | level << 16;
+    fillSubtree(page, pageEntry, level + 1);
+}
+
+// The page's subtree falls back to whatever its parent resolves to. The coarsest level is
+// pinned, so an evicted page always has a parent.
+void VirtualTexture::evict(uint32_t slot) {
+    uint32_t page = slots[slot].page;
+    uint32_t level = getPageLevel(page);
+    uint32_t pageX = (page - levels[level].firstPage) % levels[level].pagesX;
+    uint32_t pageY = (page - levels[level].firstPage) / levels[level].pagesX;
+
+    const Level& parentLevel = levels[level + 1];
+    uint32_t parent = parentLevel.firstPage
+                      + std::min(pageY / 2, parentLevel.pagesY - 1) * parentLevel.pagesX
+                      + std::min(pageX / 2, parentLevel.pagesX - 1);
+    fillSubtree(page, pageEntries[parent], level);
+
+    pageSlots[page] = NO_SLOT;
+    slots[slot] = Slot{};
+    freeSlots.push_back(slot);
+    evictedTiles++;
+}
+
+void VirtualTexture::fillSubtree(uint32_t page, uint32_t pageEntry, uint32_t fromLevel) {
+    uint32_t level = getPageLevel(page);
+    uint32_t pageX = (page - levels[level].firstPage) % levels[level].pagesX;
+    uint32_t pageY = (page - levels[level].firstPage) / levels[level].pagesX;
+
+    // Each level down doubles the pages the subtree covers along both axes, up to the level's
+    // page count along an axis that has stopped shrinking.
+    for (uint32_t finer = level + 1; finer-- > 0;) {
+        const Level& info = levels[finer];
+        uint32_t shift = level - finer;
+        uint32_t beginX = std::min(pageX << shift, info.pagesX - 1);
+        uint32_t endX = std::min((pageX + 1) << shift, info.pagesX);
+        uint32_t beginY = std::min(pageY << shift, info.pagesY - 1);
+        uint32_t endY = std::min((pageY + 1) << shift, info.pagesY);
+
+        for (uint32_t y = beginY; y < endY; y++) {
+            for (uint32_t x = beginX; x < endX; x++) {
+                uint32_t index = info.firstPage + y * info.pagesX + x;
+                if (getEntryLevel(pageEntries[index]) >= fromLevel) {
+                    pageEntries[index] = pageEntry;
+                    dirtyBegin = std::min(dirtyBegin, index);
+                    dirtyEnd = std::max(dirtyEnd, index + 1);
+                }
+            }
+        }
+    }
+}
+
+void VirtualTexture::recordPageTableUpload(VkCommandBuffer commandBuffer) {
+    if (dirtyBegin >= dirtyEnd) {
+        return;
+    }
+
+    VkDeviceSize offset = sizeof(uint32_t) * dirtyBegin;
+    VkDeviceSize size = sizeof(uint32_t) * (dirtyEnd - dirtyBegin);
+    StagingAllocation staging = stagingPool.allocate(size);
+    memcpy(staging.data, &pageEntries[dirtyBegin], (size_t)size);
+
+    // Frames already submitted finish reading the old entries first.
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = pageTable;
+    barrier.offset = offset;
+    barrier.size = size;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+    VkBufferCopy copyRegion{};
+    copyRegion.srcOffset = staging.offset;
+    copyRegion.dstOffset = offset;
+    copyRegion.size = size;
+    vkCmdCopyBuffer(commandBuffer, staging.buffer, pageTable, 1, &copyRegion);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 1, &barrier, 0,
+                         nullptr);
+
+    dirtyBegin = UINT32_MAX;
+    dirtyEnd = 0;
+}
+
+// Transitions of the whole cache keep the slots that are not written; only transitions from
+// UNDEFINED discard them, at create.
+void VirtualTexture::recordCacheBarrier(VkCommandBuffer commandBuffer, VkImageLayout oldLayout,
+                                        VkImageLayout newLayout) const {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = cacheImage;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+    VkPipelineStageFlags srcStages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    VkPipelineStageFlags dstStages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    if (newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+        // Frames already submitted finish sampling the slots being replaced first.
+        srcStages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        dstStages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    } else {
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    }
+    vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr, 0, nullptr, 1,
+                         &barrier);
+}
+
+VkExtent2D VirtualTextureFeedback::getExtent(VkExtent2D targetExtent) {
+    return {std::max(1u, targetExtent.width / VIRTUAL_TEXTURE_FEEDBACK_SCALE),
+            std::max(1u, targetExtent.height / VIRTUAL_TEXTURE_FEEDBACK_SCALE)};
+}
+
+void VirtualTextureFeedback::create(const VulkanDevice& vulkanDevice, uint32_t imageCount,
+                                    VkExtent2D targetExtent) {
+    this->vulkanDevice = &vulkanDevice;
+    device = vulkanDevice.getDevice();
+    extent = getExtent(targetExtent);
+    bufferSize = sizeof(uint32_t) * extent.width * extent.height;
+    createBuffers(imageCount);
+}
+
+void VirtualTextureFeedback::destroy() {
+    destroyBuffers();
+    collected.clear();
+}
+
+// What was collected so far is kept; it refers to tiles, not texels.
+void VirtualTextureFeedback::resize(VkExtent2D targetExtent) {
+    extent = getExtent(targetExtent);
+    VkDeviceSize neededSize = sizeof(uint32_t) * extent.width * extent.height;
+    if (neededSize > bufferSize) {
+        uint32_t imageCount = static_cast<uint32_t>(buffers.size());
+        destroyBuffers();
+        bufferSize = neededSize;
+        createBuffers(imageCount);
+        return;
+    }
+
+    // Texels of the old extent would otherwise be collected once more.
+    for (uint32_t* mapping : mappings) {
+        memset(mapping, 0xff, (size_t)bufferSize);
+    }
+}
+
+void VirtualTextureFeedback::createBuffers(uint32_t imageCount) {
+    buffers.resize(imageCount);
+    buffersMemory.resize(imageCount);
+    mappings.resize(imageCount);
+    for (uint32_t i = 0; i < imageCount; i++) {
+        vulkanDevice->createBuffer(
+            bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            buffers[i], buffersMemory[i]);
+
+        // An image's first collect() comes before anything was copied.
+        void* data;
+        vkMapMemory(device, buffersMemory[i], 0, bufferSize, 0, &data);
+        memset(data, 0xff, (size_t)bufferSize);
+        mappings[i] = static_cast<uint32_t*>(data);
+    }
+}
+
+void VirtualTextureFeedback::destroyBuffers() {
+    for (size_t i = 0; i < buffers.size(); i++) {
+        vkUnmapMemory(device, buffersMemory[i]);
+        vkDestroyBuffer(device, buffers[i], nullptr);
+        vkFreeMemory(device, buffersMemory[i], nullptr);
+    }
+    buffers.clear();
+    buffersMemory.clear();
+    mappings.clear();
+}
+
+void VirtualTextureFeedback::recordReadback(VkCommandBuffer commandBuffer, VkImage feedback,
+                                            uint32_t imageIndex) const {
+    VkBufferImageCopy region{};
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent = {extent.width, extent.height, 1};
+    vkCmdCopyImageToBuffer(commandBuffer, feedback, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           buffers[imageIndex], 1, &region);
+
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = buffers[imageIndex];
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+// Neighbouring texels mostly sample the same tile, so runs of one value are kept once.
+void VirtualTextureFeedback::collect(uint32_t imageIndex) {
+    const uint32_t* texels = mappings[imageIndex];
+    uint32_t previous = VIRTUAL_TEXTURE_NO_FEEDBACK;
+    for (size_t i = 0; i < size_t(extent.width) * extent.height; i++) {
+        if (texels[i] != previous) {
+            previous = texels[i];
+            if (previous != VIRTUAL_TEXTURE_NO_FEEDBACK) {
+                collected.push_back(previous);
+            }
+        }
+    }
+}
+
+std::vector<uint32_t> VirtualTextureFeedback::take() {
+    std::vector<uint32_t> feedback;
+    feedback.swap(collected);
+    return feedback;
+}
@@ -1 +1,487 @@
-#include "VulkanApp.h"
\ No newline at end of file
+#include "VulkanApp.h"
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+#include "AssetPack.h"
+#include "DeviceGroup.h"
+#include "Log.h"
+#include "OffscreenTarget.h"
+#include "ShaderRegistry.h"
+
+static const uint32_t WIDTH = 800;
+static const uint32_t HEIGHT = 600;
+
+static const uint32_t BENCHMARK_WARMUP_FRAMES = 60;
+static const uint32_t BENCHMARK_FRAMES = 600;
+
+void HelloTriangleApplication::run() {
+    if (options.headlessJobs > 0) {
+        runHeadlessJobs();
+        return;
+    }
+
+    if (options.coldStart) {
+        AssetPack::evictFromPageCache(SceneResources::ASSET_PACK_PATH);
+    }
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+    initWindows();
+    initVulkan();
+    auto endTime = std::chrono::high_resolution_clock::now();
+
+    std::cout << (options.coldStart ? "cold" : "warm") << " startup: "
+              << std::chrono::duration<double, std::milli>(endTime - startTime).count()
+              << " ms, scene assets " << sceneLoadTime << " ms" << std::endl;
+
+    if (options.startupOnly) {
+        vkDeviceWaitIdle(device.getDevice());
+    } else if (options.benchmarkMsaa) {
+        benchmarkMsaa();
+    } else {
+        mainLoop();
+    }
+    cleanup();
+}
+
+void HelloTriangleApplication::initWindows() {
+    glfwInit();
+
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+
+    for (uint32_t i = 0; i < options.views; i++) {
+        auto view = std::make_unique<View>();
+        view->window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
+        glfwSetWindowUserPointer(view->window, view.get());
+        glfwSetFramebufferSizeCallback(view->window, framebufferResizeCallback);
+        views.push_back(std::move(view));
+    }
+}
+
+void HelloTriangleApplication::framebufferResizeCallback(GLFWwindow* window, int width,
+                                                         int height) {
+    auto view = reinterpret_cast<View*>(glfwGetWindowUserPointer(window));
+    view->framebufferResized = true;
+}
+
+void HelloTriangleApplication::initVulkan() {
+    uint32_t glfwExtensionCount = 0;
+    const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    instance.create(
+        std::vector<const char*>(glfwExtensions, glfwExtensions + glfwExtensionCount));
+
+    for (auto& view : views) {
+        if (glfwCreateWindowSurface(instance.getHandle(), view->window, nullptr, &view->surface)
+            != VK_SUCCESS) {
+            throw std::runtime_error("failed to create window surface!");
+        }
+    }
+
+    // The device is picked for the first window; the other targets check they can present.
+    VkSurfaceKHR surface = views.front()->surface;
+    PhysicalDeviceCandidate selected = selectPhysicalDevice(instance, surface, options.gpu);
+    device.createDevice(instance, selected, surface);
+    if (!options.capabilitiesPath.empty()) {
+        device.getCapabilities().writeJson(options.capabilitiesPath);
+        LOG(Device, Info, "device capabilities written to " << options.capabilitiesPath);
+    }
+
+    auto sceneStartTime = std::chrono::high_resolution_clock::now();
+    scene.create(device, VkDeviceSize(options.textureBudget) << 20);
+    auto sceneEndTime = std::chrono::high_resolution_clock::now();
+    sceneLoadTime
+        = std::chrono::duration<double, std::milli>(sceneEndTime - sceneStartTime).count();
+    LOG(Streaming, Info,
+        "texture cache: " << scene.getVirtualTexture().getSlotCount() << " tiles, memory "
+                          << (device.hasMemoryBudget() ? "budget from the driver"
+                                                       : "budget estimated"));
+
+    RenderTargetOptions targetOptions{};
+    targetOptions.msaaSamples = options.msaaSamples;
+    targetOptions.dynamicRendering = options.dynamicRendering;
+    for (auto& view : views) {
+        view->target.create(device, scene, view->surface, getFramebufferExtent(view->window),
+                            targetOptions);
+    }
+
+    // ImGui keeps one context, so the overlay only draws over the first window.
+    if (options.overlay) {
+        View& view = *views.front();
+        const Swapchain& swapchain = view.target.getSwapchain();
+        overlay.create(instance, device, view.window, swapchain.getImageFormat(),
+                       swapchain.getImageCount());
+        view.target.setOverlay(&overlay);
+    }
+
+#ifdef SHADER_HOT_RELOAD
+    shaderReloader.start();
+#endif
+}
+
+void HelloTriangleApplication::mainLoop() {
+    if (!options.capturePath.empty()) {
+        startCapture();
+    }
+
+    using Clock = std::chrono::high_resolution_clock;
+    std::vector<FramePhaseTime> currentPhases;
+    Clock::time_point phaseStart;
+    auto endPhase = [&](const char* name) {
+        Clock::time_point phaseEnd = Clock::now();
+        currentPhases.push_back(
+            {name, std::chrono::duration<double, std::milli>(phaseEnd - phaseStart).count()});
+        phaseStart = phaseEnd;
+    };
+
+    uint64_t frame = 0;
+    while (!shouldClose()) {
+        setLogFrame(++frame);
+        currentPhases.clear();
+        phaseStart = Clock::now();
+        glfwPollEvents();
+#ifdef SHADER_HOT_RELOAD
+        reloadShaders();
+#endif
+        endPhase("events");
+        animateScene();
+        endPhase("animation");
+        updateGeometry();
+        endPhase("geometry");
+        scene.updateTextures();
+        endPhase("textures");
+        if (options.overlay) {
+            // The overlay reports its own cost.
+            drawOverlay();
+            phaseStart = Clock::now();
+        }
+
+        // Views are rendered without blocking so a slow one does not hold up the others.
+        bool presented = false;
+        bool capturedViewPresented = false;
+        for (size_t i = 0; i < views.size(); i++) {
+            bool viewPresented = renderView(*views[i], 0);
+            capturedViewPresented |= i == 0 && viewPresented;
+            presented |= viewPresented;
+        }
+        endPhase("render");
+        if (capturedViewPresented && capture.isOpen()) {
+            captureFrame(currentPhases);
+        }
+        if (!presented) {
+            glfwWaitEventsTimeout(0.001);
+        }
+        phaseTimes.swap(currentPhases);
+    }
+
+    vkDeviceWaitIdle(device.getDevice());
+}
+
+void HelloTriangleApplication::benchmarkMsaa() {
+    View& view = *views.front();
+
+    for (uint32_t samples : {1, 2, 4, 8}) {
+        if (device.getMaxUsableSampleCount(samples) != samples) {
+            std::cout << "msaa " << samples << "x: not supported" << std::endl;
+            continue;
+        }
+
+        view.target.setSampleCount(samples);
+
+        for (uint32_t i = 0; i < BENCHMARK_WARMUP_FRAMES; i++) {
+            glfwPollEvents();
+            animateScene();
+            scene.updateTextures();
+            renderView(view, UINT64_MAX);
+        }
+
+        // Each frame is waited on so its GPU timestamps can be read back immediately.
+        double gpuTime = 0.0;
+        uint32_t gpuFrames = 0;
+        std::vector<RenderGraphPassTime> passTimes;
+        std::vector<RenderGraphPassTime> passTotals;
+        uint32_t passFrames = 0;
+        // Frames that came back OutOfDate or NotReady were not rendered and are not counted.
+        uint32_t presentedFrames = 0;
+        auto startTime = std::chrono::high_resolution_clock::now();
+        for (uint32_t i = 0; i < BENCHMARK_FRAMES && !shouldClose(); i++) {
+            glfwPollEvents();
+            animateScene();
+            scene.updateTextures();
+            if (!renderView(view, UINT64_MAX)) {
+                continue;
+            }
+            presentedFrames++;
+
+            double frameGpuTime;
+            if (view.target.getLastFrameGpuTime(frameGpuTime)) {
+                gpuTime += frameGpuTime;
+                gpuFrames++;
+            }
+            if (view.target.getLastFramePassTimes(passTimes)) {
+                if (passTotals.empty()) {
+                    passTotals = passTimes;
+                    passFrames = 1;
+                } else if (passTimes.size() == passTotals.size()) {
+                    for (size_t pass = 0; pass < passTimes.size(); pass++) {
+                        passTotals[pass].milliseconds += passTimes[pass].milliseconds;
+                    }
+                    passFrames++;
+                }
+            }
+        }
+        vkDeviceWaitIdle(device.getDevice());
+        auto endTime = std::chrono::high_resolution_clock::now();
+
+        if (presentedFrames == 0) {
+            std::cout << "msaa " << samples << "x: no frames presented" << std::endl;
+            continue;
+        }
+        double frameTime = std::chrono::duration<double, std::milli>(endTime - startTime).count()
+                           / presentedFrames;
+        std::cout << "msaa " << samples << "x: " << frameTime << " ms/frame";
+        if (gpuFrames > 0) {
+            std::cout << ", gpu " << gpuTime / gpuFrames << " ms/frame";
+        }
+        std::cout << std::endl;
+        for (const RenderGraphPassTime& pass : passTotals) {
+            if (passFrames > 0) {
+                std::cout << "  " << pass.name << ": " << pass.milliseconds / passFrames << " ms"
+                          << std::endl;
+            }
+        }
+    }
+}
+
+// Every suitable GPU gets its own scene and offscreen target; frames are queued as jobs and
+// taken by whichever GPU is free.
+void HelloTriangleApplication::runHeadlessJobs() {
+    instance.create({});
+
+    DeviceGroup group;
+    group.create(instance);
+
+    RenderTargetOptions targetOptions{};
+    targetOptions.msaaSamples = options.msaaSamples;
+    targetOptions.dynamicRendering = options.dynamicRendering;
+
+    std::vector<std::unique_ptr<SceneResources>> scenes;
+    std::vector<std::unique_ptr<OffscreenTarget>> targets;
+    for (uint32_t i = 0; i < group.getDeviceCount(); i++) {
+        scenes.push_back(std::make_unique<SceneResources>());
+        scenes.back()->create(group.getDevice(i), VkDeviceSize(options.textureBudget) << 20);
+        targets.push_back(std::make_unique<OffscreenTarget>());
+        targets.back()->create(group.getDevice(i), *scenes.back(), {WIDTH, HEIGHT}, targetOptions);
+    }
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+    for (uint32_t i = 0; i < options.headlessJobs; i++) {
+        group.submit([&targets](const VulkanDevice&, uint32_t deviceIndex) {
+            targets[deviceIndex]->renderFrame();
+        });
+    }
+    group.wait();
+    auto endTime = std::chrono::high_resolution_clock::now();
+
+    std::vector<uint32_t> completedJobs = group.getCompletedJobs();
+    for (uint32_t i = 0; i < group.getDeviceCount(); i++) {
+        std::cout << "gpu " << group.getDevice(i).getProperties().deviceName << ": "
+                  << completedJobs[i] << " frames" << std::endl;
+    }
+    std::cout << options.headlessJobs << " headless frames in "
+              << std::chrono::duration<double, std::milli>(endTime - startTime).count() << " ms"
+              << std::endl;
+
+    for (uint32_t i = 0; i < group.getDeviceCount(); i++) {
+        targets[i]->destroy();
+        scenes[i]->destroy();
+    }
+    group.destroy();
+    instance.destroy();
+}
+
+#ifdef SHADER_HOT_RELOAD
+// Shaders that RenderTarget builds its pipelines from.
+static bool isTargetShader(const std::string& name) {
+    return name == "shader_depth_vert" || name == "shader_depth_frag"
+           || name == "shadow_depth_vert" || name == "lod_select_comp"
+           || name == "vt_feedback_frag"
+           || name.rfind("post_", 0) == 0;
+}
+
+// Runs between frames; pipelines built from a changed shader are rebuilt and the command
+// buffers re-recorded once the targets are idle.
+void HelloTriangleApplication::reloadShaders() {
+    bool pipelineChanged = false;
+    for (ShaderUpdate& update : shaderReloader.takeUpdates()) {
+        pipelineChanged |= isTargetShader(update.name);
+        setShaderOverride(std::move(update.name), std::move(update.code));
+    }
+
+    if (!pipelineChanged) {
+        return;
+    }
+
+    for (auto& view : views) {
+        view->target.reloadPipeline();
+    }
+}
+#endif
+
+void HelloTriangleApplication::cleanup() {
+#ifdef SHADER_HOT_RELOAD
+    shaderReloader.stop();
+#endif
+    capture.close();
+    for (auto& view : views) {
+        view->target.destroy();
+    }
+    if (options.overlay) {
+        overlay.destroy();
+    }
+
+    scene.destroy();
+
+    for (auto& view : views) {
+        vkDestroySurfaceKHR(instance.getHandle(), view->surface, nullptr);
+    }
+    device.destroy();
+    instance.destroy();
+
+    for (auto& view : views) {
+        glfwDestroyWindow(view->window);
+    }
+    views.clear();
+
+    glfwTerminate();
+}
+
+bool HelloTriangleApplication::shouldClose() const {
+    for (const auto& view : views) {
+        if (glfwWindowShouldClose(view->window)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Spins the scene graph's root; the views pick up the changed instances when they next render.
+void HelloTriangleApplication::animateScene() {
+    static auto startTime = std::chrono::high_resolution_clock::now();
+
+    auto currentTime = std::chrono::high_resolution_clock::now();
+    float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime)
+                     .count();
+
+    SceneGraph& graph = scene.getGraph();
+    graph.setLocalTransform(scene.getRootNode(),
+                            glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f),
+                                        glm::vec3(0.0f, 0.0f, 1.0f)));
+    graph.update(std::thread::hardware_concurrency());
+}
+
+// Picks up a finished background compaction of the scene's geometry arena. Every target is
+// re-recorded against the new buffers before the old ones are freed.
+void HelloTriangleApplication::updateGeometry() {
+    if (!scene.getGeometry().update()) {
+        return;
+    }
+
+    for (auto& view : views) {
+        view->target.refreshCommands();
+    }
+    scene.getGeometry().releaseRetiredBuffers();
+}
+
+// Returns whether a frame was presented; an out of date or resized target is rebuilt. The
+// texture tiles the view's finished frames sampled go to the scene's virtual texture, which
+// streams them in on its next update.
+bool HelloTriangleApplication::renderView(View& view, uint64_t timeout) {
+    FrameStatus status = view.target.renderFrame(timeout);
+    std::vector<uint32_t> feedback = view.target.takeTextureFeedback();
+    if (capture.isOpen()) {
+        capturedFeedback.insert(capturedFeedback.end(), feedback.begin(), feedback.end());
+    }
+    scene.getVirtualTexture().addFeedback(feedback);
+
+    if (status == FrameStatus::OutOfDate || view.framebufferResized) {
+        view.framebufferResized = false;
+        view.target.resize(getFramebufferExtent(view.window));
+        if (capture.isOpen() && &view == views.front().get()) {
+            capture.writeResize(view.target.getSwapchain().getExtent());
+        }
+    }
+
+    return status == FrameStatus::Presented;
+}
+
+// Builds the overlay's UI for the first view, whose next frame records it, and applies the
+// settings changed through it.
+void HelloTriangleApplication::drawOverlay() {
+    RenderTarget& target = views.front()->target;
+    RenderTargetOptions targetOptions = target.getOptions();
+    if (overlay.draw(target, scene, phaseTimes, targetOptions)) {
+        target.setOptions(targetOptions);
+        if (capture.isOpen()) {
+            capture.writeOptions(target.getOptions());
+        }
+    }
+}
+
+// Records the first view's frames from here on, with what the replay needs to recreate the
+// scene and target it starts from.
+void HelloTriangleApplication::startCapture() {
+    const RenderTarget& target = views.front()->target;
+    const VkPhysicalDeviceProperties& properties = device.getProperties();
+
+    CaptureSession session;
+    std::strncpy(session.deviceName, properties.deviceName, sizeof(session.deviceName) - 1);
+    session.vendorId = properties.vendorID;
+    session.deviceId = properties.deviceID;
+    session.driverVersion = properties.driverVersion;
+    session.apiVersion = properties.apiVersion;
+    hashAssetPack(SceneResources::ASSET_PACK_PATH, session.assetPackSize, session.assetPackHash);
+    session.textureBudget = VkDeviceSize(options.textureBudget) << 20;
+    session.extent = target.getSwapchain().getExtent();
+    session.options = toCaptureOptions(target.getOptions());
+
+    capture.open(options.capturePath, session);
+    views.front()->target.setCollectTimings(true);
+    LOG(App, Info, "capturing frames to " << options.capturePath);
+}
+
+// Called once the first view presented a frame: the scene state it was rendered with and the
+// texture feedback the views returned since the last captured frame.
+void HelloTriangleApplication::captureFrame(const std::vector<FramePhaseTime>& phases) {
+    CaptureFrame frame;
+    const glm::mat4& transform = scene.getGraph().getLocalTransform(scene.getRootNode());
+    std::memcpy(frame.rootTransform, glm::value_ptr(transform), sizeof(frame.rootTransform));
+    for (const FramePhaseTime& phase : phases) {
+        frame.cpuTime += static_cast<float>(phase.milliseconds);
+    }
+    frame.gpuTime = static_cast<float>(views.front()->target.getRecentGpuTime());
+
+    capture.writeFrame(frame, capturedFeedback);
+    capturedFeedback.clear();
+}
+
+// Waits while the window is minimized, since a swapchain cannot have a zero extent.
+VkExtent2D HelloTriangleApplication::getFramebufferExtent(GLFWwindow* window) {
+    int width = 0, height = 0;
+    glfwGetFramebufferSize(window, &width, &height);
+    while (width == 0 || height == 0) {
+        glfwGetFramebufferSize(window, &width, &height);
+        glfwWaitEvents();
+    }
+
+    return {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+}
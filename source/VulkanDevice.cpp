@@ -0,0 +1,468 @@
+#include "VulkanDevice.h"
+
+#include <algorithm>
+#include <set>
+#include <stdexcept>
+
+#include "RenderGraph.h"
+#include "VulkanInstance.h"
+
+// Share of the device local heaps assumed to be available without VK_EXT_memory_budget; the
+// rest is left to the desktop and other processes.
+static const float UNTRACKED_BUDGET_SHARE = 0.8f;
+
+void VulkanDevice::createDevice(const VulkanInstance& instance,
+                                const PhysicalDeviceCandidate& candidate, VkSurfaceKHR surface) {
+    physicalDevice = candidate.physicalDevice;
+    capabilities = candidate.capabilities;
+    queueFamilies = findQueueFamilies(physicalDevice, surface);
+
+    uint32_t graphicsFamily = queueFamilies.graphicsFamily.value();
+    queueFamilyIndices[static_cast<size_t>(QueueType::Graphics)] = graphicsFamily;
+    queueFamilyIndices[static_cast<size_t>(QueueType::Compute)]
+        = queueFamilies.computeFamily.value_or(graphicsFamily);
+    queueFamilyIndices[static_cast<size_t>(QueueType::Transfer)]
+        = queueFamilies.transferFamily.value_or(graphicsFamily);
+
+    createLogicalDevice(instance.getEnabledLayers());
+    createCommandPools();
+    createPipelineCache();
+    samplerCache.create(device, capabilities->getLimits(), enabledFeatures);
+}
+
+void VulkanDevice::createLogicalDevice(const std::vector<const char*>& layers) {
+    std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+    std::set<uint32_t> uniqueQueueFamilies(queueFamilyIndices.begin(), queueFamilyIndices.end());
+    if (queueFamilies.presentFamily.has_value()) {
+        uniqueQueueFamilies.insert(queueFamilies.presentFamily.value());
+    }
+
+    float queuePriority = 1.0f;
+    for (uint32_t queueFamily : uniqueQueueFamilies) {
+        VkDeviceQueueCreateInfo queueCreateInfo{};
+        queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueCreateInfo.queueFamilyIndex = queueFamily;
+        queueCreateInfo.queueCount = 1;
+        queueCreateInfo.pQueuePriorities = &queuePriority;
+        queueCreateInfos.push_back(queueCreateInfo);
+    }
+
+    const VkPhysicalDeviceFeatures& supportedFeatures = capabilities->getFeatures();
+
+    // Indirect draws are used when available; the render queue falls back to direct draws.
+    VkPhysicalDeviceFeatures deviceFeatures{};
+    deviceFeatures.samplerAnisotropy = VK_TRUE;
+    deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+    deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+    deviceFeatures.depthClamp = supportedFeatures.depthClamp;
+
+    // Device selection only accepts devices that render all shadow cascades in one multiview pass.
+    VkPhysicalDeviceMultiviewFeatures multiviewFeatures{};
+    multiviewFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES;
+    multiviewFeatures.multiview = VK_TRUE;
+
+    // Optional; render targets fall back to render pass objects without it.
+    bool dynamicRendering = capabilities->supportsDynamicRendering();
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+    dynamicRenderingFeatures.sType
+        = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+    dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+    if (dynamicRendering) {
+        multiviewFeatures.pNext = &dynamicRenderingFeatures;
+    }
+
+    VkDeviceCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = &multiviewFeatures;
+
+    createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
+    createInfo.pQueueCreateInfos = queueCreateInfos.data();
+
+    createInfo.pEnabledFeatures = &deviceFeatures;
+
+    std::vector<const char*> deviceExtensions
+        = getRequiredDeviceExtensions(queueFamilies.presentFamily.has_value());
+    // Optional; without it the residency manager assumes a fixed share of the heaps.
+    bool memoryBudget = capabilities->hasExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (memoryBudget) {
+        deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+    if (dynamicRendering) {
+        for (const char* extension : getDynamicRenderingExtensions()) {
+            deviceExtensions.push_back(extension);
+        }
+    }
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+
+    createInfo.enabledLayerCount = static_cast<uint32_t>(layers.size());
+    createInfo.ppEnabledLayerNames = layers.data();
+
+    if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &device) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create logical device!");
+    }
+    enabledFeatures = deviceFeatures;
+    memoryBudgetEnabled = memoryBudget;
+    dynamicRenderingEnabled = dynamicRendering;
+
+    for (size_t i = 0; i < queues.size(); i++) {
+        vkGetDeviceQueue(device, queueFamilyIndices[i], 0, &queues[i]);
+    }
+    if (queueFamilies.presentFamily.has_value()) {
+        vkGetDeviceQueue(device, queueFamilies.presentFamily.value(), 0, &presentQueue);
+    }
+}
+
+void VulkanDevice::createCommandPools() {
+    for (size_t i = 0; i < commandPools.size(); i++) {
+        for (size_t j = 0; j < i; j++) {
+            if (queueFamilyIndices[j] == queueFamilyIndices[i]) {
+                commandPools[i] = commandPools[j];
+                break;
+            }
+        }
+        if (commandPools[i] != VK_NULL_HANDLE) {
+            continue;
+        }
+
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = queueFamilyIndices[i];
+
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPools[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create command pool!");
+        }
+    }
+}
+
+void VulkanDevice::createPipelineCache() {
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+    if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline cache!");
+    }
+}
+
+void VulkanDevice::destroy() {
+    if (device != VK_NULL_HANDLE) {
+        samplerCache.destroy();
+        vkDestroyPipelineCache(device, pipelineCache, nullptr);
+        std::set<VkCommandPool> uniqueCommandPools(commandPools.begin(), commandPools.end());
+        for (VkCommandPool commandPool : uniqueCommandPools) {
+            vkDestroyCommandPool(device, commandPool, nullptr);
+        }
+        commandPools = {};
+        queues = {};
+        presentQueue = VK_NULL_HANDLE;
+        vkDestroyDevice(device, nullptr);
+        device = VK_NULL_HANDLE;
+    }
+}
+
+bool VulkanDevice::supportsPresent(VkSurfaceKHR surface) const {
+    if (!queueFamilies.presentFamily.has_value()) {
+        return false;
+    }
+
+    VkBool32 presentSupport = false;
+    vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, queueFamilies.presentFamily.value(),
+                                         surface, &presentSupport);
+    return presentSupport;
+}
+
+float VulkanDevice::getTimestampPeriod() const {
+    const VkPhysicalDeviceLimits& limits = capabilities->getLimits();
+    return limits.timestampComputeAndGraphics ? limits.timestampPeriod : 0.0f;
+}
+
+VkSampleCountFlagBits VulkanDevice::getMaxUsableSampleCount(uint32_t requestedSamples) const {
+    const VkPhysicalDeviceLimits& limits = capabilities->getLimits();
+    VkSampleCountFlags counts
+        = limits.framebufferColorSampleCounts & limits.framebufferDepthSampleCounts;
+    for (uint32_t samples = VK_SAMPLE_COUNT_64_BIT; samples > VK_SAMPLE_COUNT_1_BIT;
+         samples >>= 1) {
+        if (samples <= requestedSamples && (counts & samples)) {
+            return static_cast<VkSampleCountFlagBits>(samples);
+        }
+    }
+
+    return VK_SAMPLE_COUNT_1_BIT;
+}
+
+uint32_t VulkanDevice::findMemoryType(uint32_t typeFilter,
+                                      VkMemoryPropertyFlags properties) const {
+    uint32_t memoryType = capabilities->findMemoryType(typeFilter, properties);
+    if (memoryType == NO_MEMORY_TYPE) {
+        throw std::runtime_error("failed to find suitable memory type!");
+    }
+
+    return memoryType;
+}
+
+bool VulkanDevice::hasMappableDeviceMemory() const {
+    const VkPhysicalDeviceMemoryProperties& memProperties = capabilities->getMemoryProperties();
+
+    VkDeviceSize largestDeviceHeap = 0;
+    for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++) {
+        if (memProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            largestDeviceHeap = std::max(largestDeviceHeap, memProperties.memoryHeaps[i].size);
+        }
+    }
+
+    // Without resizable BAR the mappable window is a small heap of its own.
+    VkMemoryPropertyFlags mappable = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+                                     | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                                     | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        const VkMemoryType& type = memProperties.memoryTypes[i];
+        if ((type.propertyFlags & mappable) == mappable
+            && memProperties.memoryHeaps[type.heapIndex].size >= largestDeviceHeap) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+MemoryBudget VulkanDevice::getMemoryBudget() const {
+    MemoryBudget budget;
+    if (!memoryBudgetEnabled) {
+        const VkPhysicalDeviceMemoryProperties& heaps = capabilities->getMemoryProperties();
+        for (uint32_t i = 0; i < heaps.memoryHeapCount; i++) {
+            if (heaps.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+                budget.budget += static_cast<VkDeviceSize>(heaps.memoryHeaps[i].size
+                                                           * UNTRACKED_BUDGET_SHARE);
+            }
+        }
+        return budget;
+    }
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+    VkPhysicalDeviceMemoryProperties2 memProperties{};
+    memProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    memProperties.pNext = &budgetProperties;
+    vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memProperties);
+
+    const VkPhysicalDeviceMemoryProperties& heaps = memProperties.memoryProperties;
+    for (uint32_t i = 0; i < heaps.memoryHeapCount; i++) {
+        if (heaps.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            budget.budget += budgetProperties.heapBudget[i];
+            budget.usage += budgetProperties.heapUsage[i];
+        }
+    }
+
+    return budget;
+}
+
+VkFormat VulkanDevice::findSupportedFormat(const std::vector<VkFormat>& candidates,
+                                           VkImageTiling tiling,
+                                           VkFormatFeatureFlags features) const {
+    for (VkFormat format : candidates) {
+        VkFormatProperties props = capabilities->getFormatProperties(format);
+
+        if (tiling == VK_IMAGE_TILING_LINEAR
+            && (props.linearTilingFeatures & features) == features) {
+            return format;
+        } else if (tiling == VK_IMAGE_TILING_OPTIMAL
+                   && (props.optimalTilingFeatures & features) == features) {
+            return format;
+        }
+    }
+
+    throw std::runtime_error("failed to find supported format!");
+}
+
+VkFormat VulkanDevice::findDepthFormat() const {
+    return findSupportedFormat(
+        {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
+        VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+}
+
+VkFormat VulkanDevice::findShadowMapFormat() const {
+    return findSupportedFormat({VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM}, VK_IMAGE_TILING_OPTIMAL,
+                               VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
+                                   | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+}
+
+void VulkanDevice::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                                VkMemoryPropertyFlags properties, VkBuffer& buffer,
+                                VkDeviceMemory& bufferMemory) const {
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create buffer!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate buffer memory!");
+    }
+
+    vkBindBufferMemory(device, buffer, bufferMemory, 0);
+}
+
+void VulkanDevice::createImage(uint32_t width, uint32_t height, VkSampleCountFlagBits numSamples,
+                               VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
+                               VkMemoryPropertyFlags properties, VkImage& image,
+                               VkDeviceMemory& imageMemory) const {
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = width;
+    imageInfo.extent.height = height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = format;
+    imageInfo.tiling = tiling;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage;
+    imageInfo.samples = numSamples;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate image memory!");
+    }
+
+    vkBindImageMemory(device, image, imageMemory, 0);
+}
+
+VkImageView VulkanDevice::createImageView(VkImage image, VkFormat format,
+                                          VkImageAspectFlags aspectFlags) const {
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange.aspectMask = aspectFlags;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    VkImageView imageView;
+    if (vkCreateImageView(device, &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create texture image view!");
+    }
+
+    return imageView;
+}
+
+VkCommandBuffer VulkanDevice::beginSingleTimeCommands(QueueType type) const {
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = getCommandPool(type);
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+    return commandBuffer;
+}
+
+void VulkanDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer, QueueType type) const {
+    vkEndCommandBuffer(commandBuffer);
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+
+    vkQueueSubmit(getQueue(type), 1, &submitInfo, VK_NULL_HANDLE);
+    vkQueueWaitIdle(getQueue(type));
+
+    vkFreeCommandBuffers(device, getCommandPool(type), 1, &commandBuffer);
+}
+
+void VulkanDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) const {
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+
+    VkBufferCopy copyRegion{};
+    copyRegion.size = size;
+    vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+
+    endSingleTimeCommands(commandBuffer);
+}
+
+void VulkanDevice::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width,
+                                     uint32_t height) const {
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {width, height, 1};
+
+    vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                           &region);
+
+    endSingleTimeCommands(commandBuffer);
+}
+
+void VulkanDevice::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout,
+                                         VkImageLayout newLayout) const {
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = getImageAspectFlags(format);
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    ImageSyncState source = getLayoutSyncState(oldLayout);
+    ImageSyncState destination = getLayoutSyncState(newLayout);
+
+    barrier.srcAccessMask = source.access;
+    barrier.dstAccessMask = destination.access;
+
+    vkCmdPipelineBarrier(commandBuffer, source.stages, destination.stages, 0, 0, nullptr, 0,
+                         nullptr, 1, &barrier);
+
+    endSingleTimeCommands(commandBuffer);
+}
@@ -0,0 +1,206 @@
+// Cooks the demo scene into the asset pack that SceneResources loads: the two quads as raw
+// Vertex and index data with their simplified levels of detail, and the texture decoded to RGBA8
+// with its full mip chain, cut into the tiles the virtual texture streams.
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "AssetPack.h"
+#include "MeshSimplifier.h"
+#include "SceneResources.h"
+
+static const std::vector<Vertex> vertices
+    = {{{-0.5f, -0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}, {1.0f, 0.0f}},
+       {{0.5f, -0.5f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},
+       {{0.5f, 0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f}},
+       {{-0.5f, 0.5f, 0.0f}, {1.0f, 1.0f, 1.0f}, {1.0f, 1.0f}},
+
+       {{-0.5f, -0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}, {1.0f, 0.0f}},
+       {{0.5f, -0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},
+       {{0.5f, 0.5f, -0.5f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f}},
+       {{-0.5f, 0.5f, -0.5f}, {1.0f, 1.0f, 1.0f}, {1.0f, 1.0f}}};
+
+// Both quads use the same indices; each is its own mesh.
+static const std::vector<uint16_t> quadIndices = {0, 1, 2, 2, 3, 0};
+static const uint32_t QUAD_VERTEX_COUNT = 4;
+
+static const uint32_t VIRTUAL_TILE_SIZE = 128;
+// Enough for bilinear filtering, with room to spare for a filter footprint reaching further.
+static const uint32_t VIRTUAL_TILE_BORDER = 4;
+
+static float toLinear(uint32_t srgb) {
+    float value = srgb / 255.0f;
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static uint32_t toSrgb(float linear) {
+    float value = linear <= 0.0031308f ? linear * 12.92f
+                                       : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+    return static_cast<uint32_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+static uint32_t unpackTexel(uint32_t value, uint32_t channel) {
+    return (value >> (8 * channel)) & 0xff;
+}
+
+static uint32_t nextPowerOfTwo(uint32_t value) {
+    uint32_t power = 1;
+    while (power < value) {
+        power *= 2;
+    }
+    return power;
+}
+
+// Bilinearly scales RGBA8 sRGB texels up to power of two dimensions, as virtual textures need.
+static std::vector<uint32_t> resizeToPowerOfTwo(const uint32_t* pixels, uint32_t& width,
+                                                uint32_t& height) {
+    uint32_t newWidth = nextPowerOfTwo(width);
+    uint32_t newHeight = nextPowerOfTwo(height);
+    std::vector<uint32_t> resized(size_t(newWidth) * newHeight);
+
+    for (uint32_t y = 0; y < newHeight; y++) {
+        float sourceY = std::max(0.0f, (y + 0.5f) * height / newHeight - 0.5f);
+        uint32_t y0 = std::min(static_cast<uint32_t>(sourceY), height - 1);
+        uint32_t y1 = std::min(y0 + 1, height - 1);
+        float fy = sourceY - y0;
+        for (uint32_t x = 0; x < newWidth; x++) {
+            float sourceX = std::max(0.0f, (x + 0.5f) * width / newWidth - 0.5f);
+            uint32_t x0 = std::min(static_cast<uint32_t>(sourceX), width - 1);
+            uint32_t x1 = std::min(x0 + 1, width - 1);
+            float fx = sourceX - x0;
+
+            const uint32_t corners[4] = {pixels[size_t(y0) * width + x0],
+                                         pixels[size_t(y0) * width + x1],
+                                         pixels[size_t(y1) * width + x0],
+                                         pixels[size_t(y1) * width + x1]};
+            const float weights[4]
+                = {(1 - fx) * (1 - fy), fx * (1 - fy), (1 - fx) * fy, fx * fy};
+            uint32_t texel = 0;
+            for (uint32_t c = 0; c < 4; c++) {
+                float sum = 0.0f;
+                for (uint32_t corner = 0; corner < 4; corner++) {
+                    uint32_t value = unpackTexel(corners[corner], c);
+                    sum += weights[corner] * (c < 3 ? toLinear(value) : value / 255.0f);
+                }
+                uint32_t channel = c < 3 ? toSrgb(sum) : static_cast<uint32_t>(sum * 255.0f + 0.5f);
+                texel |= channel << (8 * c);
+            }
+            resized[size_t(y) * newWidth + x] = texel;
+        }
+    }
+
+    width = newWidth;
+    height = newHeight;
+    return resized;
+}
+
+// Box filters RGBA8 sRGB levels, averaging in linear space, until a level fits one virtual
+// texture tile.
+static std::vector<std::vector<uint32_t>> buildMipChain(const uint32_t* pixels, uint32_t width,
+                                                        uint32_t height) {
+    std::vector<std::vector<uint32_t>> levels;
+    levels.emplace_back(pixels, pixels + size_t(width) * height);
+
+    while (width > VIRTUAL_TILE_SIZE || height > VIRTUAL_TILE_SIZE) {
+        uint32_t levelWidth = std::max(1u, width / 2);
+        uint32_t levelHeight = std::max(1u, height / 2);
+        const std::vector<uint32_t>& source = levels.back();
+        std::vector<uint32_t> level(size_t(levelWidth) * levelHeight);
+
+        for (uint32_t y = 0; y < levelHeight; y++) {
+            for (uint32_t x = 0; x < levelWidth; x++) {
+                float sum[4] = {};
+                for (uint32_t texel = 0; texel < 4; texel++) {
+                    uint32_t sourceX = std::min(x * 2 + (texel & 1), width - 1);
+                    uint32_t sourceY = std::min(y * 2 + (texel >> 1), height - 1);
+                    uint32_t value = source[size_t(sourceY) * width + sourceX];
+                    for (uint32_t c = 0; c < 3; c++) {
+                        sum[c] += toLinear(unpackTexel(value, c));
+                    }
+                    sum[3] += unpackTexel(value, 3) / 255.0f;
+                }
+
+                uint32_t alpha = static_cast<uint32_t>(sum[3] / 4.0f * 255.0f + 0.5f);
+                level[size_t(y) * levelWidth + x] = toSrgb(sum[0] / 4.0f)
+                                                    | toSrgb(sum[1] / 4.0f) << 8
+                                                    | toSrgb(sum[2] / 4.0f) << 16 | alpha << 24;
+            }
+        }
+
+        levels.push_back(std::move(level));
+        width = levelWidth;
+        height = levelHeight;
+    }
+
+    return levels;
+}
+
+static void packScene(const std::string& output, const std::string& texturePath) {
+    AssetPackWriter writer;
+
+    for (uint32_t first = 0; first < vertices.size(); first += QUAD_VERTEX_COUNT) {
+        std::vector<glm::vec3> positions;
+        for (uint32_t i = first; i < first + QUAD_VERTEX_COUNT; i++) {
+            positions.push_back(vertices[i].pos);
+        }
+        MeshLodChain lods
+            = buildMeshLods(positions.data(), QUAD_VERTEX_COUNT, quadIndices.data(),
+                            static_cast<uint32_t>(quadIndices.size()));
+
+        std::string name = "quad" + std::to_string(first / QUAD_VERTEX_COUNT);
+        writer.addMesh(name, &vertices[first], sizeof(Vertex), QUAD_VERTEX_COUNT,
+                       &positions[0].x, lods.indices.data(), lods.lodIndexCounts.data(),
+                       static_cast<uint32_t>(lods.lodIndexCounts.size()),
+                       &lods.boundingSphere.x);
+        std::cout << name << ": " << lods.lodIndexCounts.size() << " levels of detail"
+                  << std::endl;
+    }
+
+    int texWidth, texHeight, texChannels;
+    stbi_uc* pixels
+        = stbi_load(texturePath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+    if (!pixels) {
+        throw std::runtime_error("failed to load texture image " + texturePath + "!");
+    }
+    uint32_t width = static_cast<uint32_t>(texWidth);
+    uint32_t height = static_cast<uint32_t>(texHeight);
+    std::vector<uint32_t> texels
+        = resizeToPowerOfTwo(reinterpret_cast<const uint32_t*>(pixels), width, height);
+    stbi_image_free(pixels);
+    std::vector<std::vector<uint32_t>> levels = buildMipChain(texels.data(), width, height);
+
+    std::vector<const uint32_t*> levelData;
+    for (const std::vector<uint32_t>& level : levels) {
+        levelData.push_back(level.data());
+    }
+    writer.addVirtualTexture("texture", VK_FORMAT_R8G8B8A8_SRGB, width, height,
+                             VIRTUAL_TILE_SIZE, VIRTUAL_TILE_BORDER, levelData);
+    std::cout << "texture: " << width << "x" << height << ", " << levels.size() << " levels in "
+              << VIRTUAL_TILE_SIZE << "x" << VIRTUAL_TILE_SIZE << " tiles" << std::endl;
+
+    writer.write(output);
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::cerr << "usage: " << argv[0] << " <output.pack> <texture image>" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        packScene(argv[1], argv[2]);
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,331 @@
+// Replays a frame capture recorded with --capture headlessly, on any suitable device including a
+// software implementation, and reports how long its frames take there. The scene is rebuilt from
+// the same asset pack and driven by the captured transforms, resizes, option changes and texture
+// feedback, so its uploads and draws follow the captured session's.
+//
+// By default every frame is rendered and timed. --bisect <ms> instead looks for the first frame
+// whose GPU time exceeds ms, rendering only the frame being probed and replaying the ones before
+// it without drawing; it assumes frames stay slow once they have become slow, as they do when
+// streaming or resource state degrades over a session.
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "DeviceSelection.h"
+#include "FrameCapture.h"
+#include "Log.h"
+#include "OffscreenTarget.h"
+#include "SceneResources.h"
+#include "VulkanDevice.h"
+#include "VulkanInstance.h"
+
+struct ReplayedFrame {
+    uint32_t index = 0;
+    // Replaying the frame's updates and rendering it, including the wait for the GPU.
+    double wallTime = 0.0;
+    // Sum of the render graph's pass times; 0 without timestamps.
+    double gpuTime = 0.0;
+    std::vector<RenderGraphPassTime> passTimes;
+};
+
+// The device, scene and offscreen target a capture is replayed with.
+class CaptureReplayer {
+  public:
+    using FrameCallback = std::function<void(const ReplayedFrame&)>;
+
+    void create(const FrameCapture& capture, const std::string& gpu);
+    void destroy();
+
+    const VulkanDevice& getDevice() const { return device; }
+
+    // Replays the capture from its start up to frame last, rendering the frames from first on
+    // and passing each to onFrame. The scene and target are recreated as they were when the
+    // capture started.
+    void replay(uint32_t first, uint32_t last, const FrameCallback& onFrame);
+
+  private:
+    void createTarget();
+    void destroyTarget();
+
+    const FrameCapture* capture = nullptr;
+    VulkanInstance instance;
+    VulkanDevice device;
+    SceneResources scene;
+    OffscreenTarget target;
+    bool sceneCreated = false;
+    bool targetCreated = false;
+
+    VkExtent2D extent{};
+    RenderTargetOptions options;
+};
+
+void CaptureReplayer::create(const FrameCapture& capture, const std::string& gpu) {
+    this->capture = &capture;
+
+    const CaptureSession& session = capture.getSession();
+    uint64_t packSize = 0;
+    uint64_t packHash = 0;
+    hashAssetPack(SceneResources::ASSET_PACK_PATH, packSize, packHash);
+    if (packSize != session.assetPackSize || packHash != session.assetPackHash) {
+        throw std::runtime_error("failed to match the captured scene, "
+                                 + std::string(SceneResources::ASSET_PACK_PATH)
+                                 + " differs from the captured asset pack!");
+    }
+
+    instance.create({});
+    PhysicalDeviceCandidate selected = selectPhysicalDevice(instance, VK_NULL_HANDLE, gpu);
+    device.createDevice(instance, selected, VK_NULL_HANDLE);
+}
+
+void CaptureReplayer::destroy() {
+    destroyTarget();
+    if (sceneCreated) {
+        scene.destroy();
+        sceneCreated = false;
+    }
+    device.destroy();
+    instance.destroy();
+}
+
+void CaptureReplayer::replay(uint32_t first, uint32_t last, const FrameCallback& onFrame) {
+    const CaptureSession& session = capture->getSession();
+
+    destroyTarget();
+    if (sceneCreated) {
+        scene.destroy();
+    }
+    scene.create(device, session.textureBudget);
+    sceneCreated = true;
+    extent = session.extent;
+    options = fromCaptureOptions(session.options);
+    createTarget();
+
+    uint32_t frameIndex = 0;
+    for (const CaptureEvent& event : capture->getEvents()) {
+        if (frameIndex > last) {
+            break;
+        }
+
+        switch (event.type) {
+            case CaptureRecordType::Options:
+                options = fromCaptureOptions(event.options);
+                destroyTarget();
+                createTarget();
+                break;
+            case CaptureRecordType::Resize:
+                extent = event.extent;
+                destroyTarget();
+                createTarget();
+                break;
+            case CaptureRecordType::Frame: {
+                auto startTime = std::chrono::high_resolution_clock::now();
+                scene.getGraph().setLocalTransform(scene.getRootNode(),
+                                                   glm::make_mat4(event.frame.rootTransform));
+                scene.getGraph().update();
+                scene.updateTextures();
+
+                ReplayedFrame frame;
+                frame.index = frameIndex;
+                if (frameIndex >= first) {
+                    target.renderFrame();
+                    auto endTime = std::chrono::high_resolution_clock::now();
+                    frame.wallTime
+                        = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+                    if (target.getLastFramePassTimes(frame.passTimes)) {
+                        for (const RenderGraphPassTime& pass : frame.passTimes) {
+                            frame.gpuTime += pass.milliseconds;
+                        }
+                    }
+                }
+
+                // The captured frame's feedback is what its views returned after rendering it.
+                scene.getVirtualTexture().addFeedback(event.feedback);
+                if (frameIndex >= first) {
+                    onFrame(frame);
+                }
+                frameIndex++;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
+
+// Presentation options have no offscreen equivalent; the sample count and extent carry over.
+void CaptureReplayer::createTarget() {
+    target.create(device, scene, extent, options);
+    targetCreated = true;
+}
+
+void CaptureReplayer::destroyTarget() {
+    if (targetCreated) {
+        vkDeviceWaitIdle(device.getDevice());
+        target.destroy();
+        targetCreated = false;
+    }
+}
+
+static void printSession(const FrameCapture& capture) {
+    const CaptureSession& session = capture.getSession();
+
+    double cpuTime = 0.0;
+    double gpuTime = 0.0;
+    for (const CaptureEvent& event : capture.getEvents()) {
+        if (event.type == CaptureRecordType::Frame) {
+            cpuTime += event.frame.cpuTime;
+            gpuTime += event.frame.gpuTime;
+        }
+    }
+
+    uint32_t frameCount = std::max(capture.getFrameCount(), 1u);
+    std::cout << "captured on " << session.deviceName << ": " << capture.getFrameCount()
+              << " frames at " << session.extent.width << "x" << session.extent.height
+              << ", msaa " << session.options.msaaSamples << "x, cpu "
+              << cpuTime / frameCount << " ms/frame, gpu " << gpuTime / frameCount
+              << " ms/frame" << std::endl;
+}
+
+static void timeFrames(CaptureReplayer& replayer) {
+    double wallTime = 0.0;
+    double gpuTime = 0.0;
+    ReplayedFrame slowest;
+    // Frames whose passes differ from the first frame's are left out of the pass averages.
+    std::vector<RenderGraphPassTime> passTotals;
+    uint32_t passFrames = 0;
+    uint32_t frameCount = 0;
+
+    replayer.replay(0, UINT32_MAX, [&](const ReplayedFrame& frame) {
+        wallTime += frame.wallTime;
+        gpuTime += frame.gpuTime;
+        if (frameCount == 0 || frame.gpuTime > slowest.gpuTime) {
+            slowest = frame;
+        }
+        if (passFrames == 0) {
+            passTotals = frame.passTimes;
+            passFrames = passTotals.empty() ? 0 : 1;
+        } else if (passTotals.size() == frame.passTimes.size()) {
+            for (size_t pass = 0; pass < passTotals.size(); pass++) {
+                passTotals[pass].milliseconds += frame.passTimes[pass].milliseconds;
+            }
+            passFrames++;
+        }
+        frameCount++;
+    });
+
+    if (frameCount == 0) {
+        std::cout << "no frames captured" << std::endl;
+        return;
+    }
+
+    std::cout << "replayed on " << replayer.getDevice().getProperties().deviceName << ": "
+              << frameCount << " frames, " << wallTime / frameCount << " ms/frame, gpu "
+              << gpuTime / frameCount << " ms/frame" << std::endl;
+    std::cout << "slowest gpu frame: " << slowest.index << ", " << slowest.gpuTime << " ms"
+              << std::endl;
+    for (const RenderGraphPassTime& pass : passTotals) {
+        std::cout << "  " << pass.name << ": " << pass.milliseconds / passFrames << " ms"
+                  << std::endl;
+    }
+}
+
+static void bisectFrames(CaptureReplayer& replayer, const FrameCapture& capture,
+                         double thresholdMs) {
+    // The first slow frame lies in [low, high); high is the frame count when none is slow.
+    uint32_t low = 0;
+    uint32_t high = capture.getFrameCount();
+    while (low < high) {
+        uint32_t probe = low + (high - low) / 2;
+
+        ReplayedFrame probed;
+        replayer.replay(probe, probe, [&probed](const ReplayedFrame& frame) { probed = frame; });
+        bool slow = probed.gpuTime > thresholdMs;
+        std::cout << "frame " << probe << ": gpu " << probed.gpuTime << " ms, "
+                  << (slow ? "slow" : "fast") << std::endl;
+
+        if (slow) {
+            high = probe;
+        } else {
+            low = probe + 1;
+        }
+    }
+
+    if (low == capture.getFrameCount()) {
+        std::cout << "no frame over " << thresholdMs << " ms" << std::endl;
+        return;
+    }
+
+    ReplayedFrame slowFrame;
+    replayer.replay(low, low, [&slowFrame](const ReplayedFrame& frame) { slowFrame = frame; });
+    std::cout << "first frame over " << thresholdMs << " ms: " << low << std::endl;
+    for (const RenderGraphPassTime& pass : slowFrame.passTimes) {
+        std::cout << "  " << pass.name << ": " << pass.milliseconds << " ms" << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string capturePath;
+    std::string gpu;
+    std::string logLevels = "warn";
+    double bisectThreshold = 0.0;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--gpu" && i + 1 < argc) {
+            gpu = argv[++i];
+        } else if (arg == "--bisect" && i + 1 < argc && std::atof(argv[i + 1]) > 0.0) {
+            bisectThreshold = std::atof(argv[++i]);
+        } else if (arg == "--log" && i + 1 < argc) {
+            logLevels = argv[++i];
+        } else if (capturePath.empty() && arg.rfind("--", 0) != 0) {
+            capturePath = arg;
+        } else {
+            capturePath.clear();
+            break;
+        }
+    }
+    if (capturePath.empty()) {
+        std::cerr << "usage: " << argv[0]
+                  << " <capture> [--gpu <index|uuid>] [--bisect <ms>] [--log <levels>]"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        initLogging(logLevels);
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        FrameCapture capture;
+        capture.load(capturePath);
+        printSession(capture);
+
+        CaptureReplayer replayer;
+        replayer.create(capture, gpu);
+        if (bisectThreshold > 0.0) {
+            bisectFrames(replayer, capture, bisectThreshold);
+        } else {
+            timeFrames(replayer);
+        }
+        replayer.destroy();
+    } catch (const std::runtime_error& e) {
+        LOG(App, Error, e.what());
+        shutdownLogging();
+        return EXIT_FAILURE;
+    }
+
+    shutdownLogging();
+    return EXIT_SUCCESS;
+}